@@ -0,0 +1,390 @@
+// Headless microbenchmark of the canvas kernels.
+// Usage: DepthPainterBench [1080p] [4k] [8k] [-i iterations]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "core/Canvas.h"
+#include "core/CanvasCache.h"
+#include "core/CanvasFile.h"
+#include "core/Gallery.h"
+#include "core/Culling.h"
+#include "core/Depth.h"
+#include "core/Export.h"
+#include "core/Pipeline.h"
+#include "core/Pose.h"
+#include "core/Profiler.h"
+#include "core/Raster.h"
+#include "core/Settings.h"
+#include "core/Animator.h"
+#include "core/Audio.h"
+#include "core/Grains.h"
+#include "core/Parallel.h"
+
+struct Resolution {
+    const char * name;
+    int width, height;
+};
+
+static const Resolution resolutions[] = {
+    { "1080p", 1920, 1080 },
+    { "4k",    3840, 2160 },
+    { "8k",    7680, 4320 },
+};
+
+// Synthetic painting: smooth color gradients plus a few depth blobs
+static void synthesize(int width, int height, std::vector<unsigned char> & image, std::vector<unsigned char> & depth)
+{
+    image.resize(width * height * 3);
+    depth.resize(width * height);
+    for ( int y = 0; y < height; ++y )
+    {
+        for ( int x = 0; x < width; ++x )
+        {
+            int pos = x + y * width;
+            float u = x / (float) width, v = y / (float) height;
+            image[pos * 3    ] = 255 * u;
+            image[pos * 3 + 1] = 255 * v;
+            image[pos * 3 + 2] = 127 + 127 * std::sin(20 * u * v);
+            float d = 0.5 + 0.25 * std::sin(6.28f * u * 3) * std::cos(6.28f * v * 2) + 0.25 * std::exp(-20 * ((u-0.5)*(u-0.5) + (v-0.5)*(v-0.5)));
+            depth[pos] = 255 * std::min(std::max(d, 0.f), 1.f);
+        }
+    }
+}
+
+// Median time in ns of several runs of 'kernel'
+static double measure(int iterations, const std::function<void()> & kernel)
+{
+    std::vector<double> times;
+    for ( int i = 0; i < iterations; ++i )
+    {
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static void report(const char * kernel, double ns, size_t pixels)
+{
+    std::printf("  %-22s %10.3f ms %8.3f ns/pixel\n", kernel, ns * 1E-6, ns / pixels);
+}
+
+static void run(const Resolution & resolution, int iterations)
+{
+    std::vector<unsigned char> image, depth;
+    synthesize(resolution.width, resolution.height, image, depth);
+    size_t pixels = (size_t) resolution.width * resolution.height;
+    std::printf("%s (%d x %d)\n", resolution.name, resolution.width, resolution.height);
+    
+    const float focal = 9000, extrusion = -2.6;
+    Canvas canvas;
+    canvas.width = resolution.width;
+    canvas.height = resolution.height;
+    canvas.render = RENDER_FILL;
+    
+    report("topology (triangles)", measure(iterations, [&]{ TopologyCache::clear(); canvas.updateTopology(); }), pixels);
+    canvas.strips = true;
+    report("topology (strips)",    measure(iterations, [&]{ TopologyCache::clear(); canvas.updateTopology(); }), pixels);
+    report("topology (cached)",    measure(iterations, [&]{ canvas.updateTopology(); }), pixels);
+    report("load + project", measure(iterations, [&]{ canvas.load(image.data(), depth.data(), 1, false); canvas.project(focal, extrusion); }), pixels);
+    report("load",            measure(iterations, [&]{ canvas.load(image.data(), depth.data(), 1, false); }), pixels);
+    
+    // Depth preparation: 16 bits of the same size, and a quarter resolution depth upsampled along the colour
+    Buffer<uint16_t> depth16;
+    {
+        const int width = resolution.width, height = resolution.height, quarter_width = width / 4, quarter_height = height / 4;
+        std::vector<float> raw(pixels), quarter((size_t) quarter_width * quarter_height);
+        for ( size_t p = 0; p < pixels; ++p ) raw[p] = depth[p] / 255.f;
+        for ( int y = 0; y < quarter_height; ++y )
+            for ( int x = 0; x < quarter_width; ++x ) quarter[x + y * quarter_width] = raw[4 * x + 4 * y * width];
+        report("depth prepare",   measure(iterations, [&]{ DepthUpsampler::prepare(raw.data(), width, height, image.data(), width, height, depth16); }), pixels);
+        Buffer<uint16_t> upsampled;
+        report("depth upsample x4", measure(iterations, [&]{ DepthUpsampler::prepare(quarter.data(), quarter_width, quarter_height,
+                                                                                  image.data(), width, height, upsampled); }), pixels);
+    }
+    report("load (16 bits)",  measure(iterations, [&]{ canvas.load(image.data(), depth16.data(), false); }), pixels);
+    
+    // Decimated mesh
+    canvas.lod_tolerance = LOD_TOLERANCE;
+    report("load (lod)",      measure(iterations, [&]{ canvas.load(image.data(), depth.data(), 1, false); }), pixels);
+    std::printf("  %-22s %10.3f ms %8.2f %% vertexes, %zu blocks\n", "lod build", canvas.lod.build_time, 100.0 * canvas.size() / pixels, canvas.lod.blocks);
+    report("project (lod)",   measure(iterations, [&]{ canvas.project(focal, extrusion); }), pixels);
+    canvas.lod_tolerance = 0;
+    canvas.load(image.data(), depth.data(), 1, false);
+    
+    // Precomputed canvas file, written next to the binary and read back mapped
+    {
+        const std::string path = std::string("DepthPainterBench_") + resolution.name + ".dpc";
+        report("file write",      measure(iterations, [&]{ CanvasFile::write(path, 1, resolution.width, resolution.height, image.data(), depth16.data()); }), pixels);
+        CanvasFile file;
+        report("file open + load", measure(iterations, [&]{ file.open(path); file.load(canvas, focal, extrusion, false); }), pixels);
+        CanvasFile::write(path, 1, resolution.width, resolution.height, image.data(), depth16.data(), &canvas, focal, extrusion);
+        report("file load (geometry)", measure(iterations, [&]{ file.open(path); file.load(canvas, focal, extrusion, false); }), pixels);
+        file.close();
+        std::remove(path.c_str());
+    }
+    
+    // Video pipeline fed with the synthetic pair as fast as it goes, consumer swapping as a render loop would
+    {
+        FramePipeline pipeline;
+        FramePipeline::Settings settings;
+        settings.focal = focal;
+        settings.extrusion = extrusion;
+        pipeline.configure(settings);
+        size_t index = 0;
+        pipeline.start([&](FramePipeline::Frame & frame) {
+            frame.width = resolution.width;
+            frame.height = resolution.height;
+            frame.image.resize(image.size());
+            frame.depth.resize(depth.size());
+            std::copy(image.begin(), image.end(), frame.image.begin());
+            std::copy(depth.begin(), depth.end(), frame.depth.begin());
+            frame.index = index++;
+            return true;
+        }, 0);
+        Canvas shown;
+        const int frames = 4 * iterations;
+        double latency = 0;
+        auto start = std::chrono::steady_clock::now();
+        for ( int presented = 0; presented < frames; )
+        {
+            if ( pipeline.swap(shown) ) { ++presented; latency += pipeline.stats().latency; }
+            else std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+        pipeline.stop();
+        FramePipeline::Stats stats = pipeline.stats();
+        std::printf("  %-22s %10.3f ms %8.3f ms latency, %zu decoded, %zu dropped\n", "pipeline (per frame)", ms, latency / frames, stats.decoded, stats.dropped);
+    }
+    
+    // Prepared canvas cache: a miss waits for the worker, a hit only swaps canvases
+    {
+        CanvasCache cache;
+        CanvasCache::Settings settings;
+        settings.focal = focal;
+        settings.extrusion = extrusion;
+        cache.configure(settings);
+        cache.start([&](int, const CanvasCache::Settings & s, Canvas & prepared, std::shared_ptr<const void> &) {
+            prepared.width = resolution.width;
+            prepared.height = resolution.height;
+            prepared.load(image.data(), depth.data(), 1, false);
+            prepared.project(s.focal, s.extrusion);
+            prepared.updateTopology();
+            return true;
+        }, (size_t) 1 << 32);
+        Canvas shown;
+        CanvasCache::Origin origin;
+        int key = 0;
+        report("cache miss", measure(iterations, [&]{
+            cache.clear();
+            cache.request(key);
+            while ( cache.state(key) != CanvasCache::READY ) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }), pixels);
+        cache.swap(key, shown, origin, -1);
+        cache.request(1);
+        while ( cache.state(1) != CanvasCache::READY ) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        report("cache hit (swap)", measure(iterations, [&]{ cache.request(1 - key); cache.swap(1 - key, shown, origin, key); key = 1 - key; }), pixels);
+        CanvasCache::Stats stats = cache.stats();
+        std::printf("  %-22s %10zu MB %zu entries, %zu hits, %zu misses\n", "cache", stats.bytes >> 20, stats.entries, stats.hits, stats.misses);
+    }
+    
+    float f = focal;
+    report("project (focal)", measure(iterations, [&]{ canvas.project(f += 500, extrusion); }), pixels);
+    float e = extrusion;
+    report("project",         measure(iterations, [&]{ canvas.project(focal, e += 0.1); }), pixels);
+    canvas.project(focal, extrusion);
+    
+    // Offline rasterization of the canvas into a frame of the same size, initial camera
+    {
+        Rasterizer raster;
+        const char * modes[] = { "raster (points)", "raster (wireframe)", "raster (fill)" };
+        for ( int mode = RENDER_POINTS; mode <= RENDER_FILL; ++mode )
+        {
+            canvas.render = (RenderMode) mode;
+            canvas.updateTopology();
+            double ns = measure(iterations, [&]{ raster.render(canvas, CameraPose::initial(canvas), resolution.width, resolution.height); });
+            std::printf("  %-22s %10.3f ms %8.2f fps\n", modes[mode], ns * 1E-6, 1E9 / ns);
+        }
+        canvas.render = RENDER_FILL;
+        canvas.updateTopology();
+    }
+    
+    // Tiles of the canvas seen from the initial camera and from close to a corner, then within a vertex budget
+    {
+        TileCuller culler;
+        report("tile bounds", measure(iterations, [&]{ culler.bound(canvas); }), pixels);
+        CameraPose pose = CameraPose::initial(canvas);
+        CameraPose corner = pose;
+        corner.position = Vec3(resolution.width * 0.35f, resolution.height * 0.3f, pose.position.z * 0.2f + pose.target.z * 0.8f);
+        corner.target = Vec3(corner.position.x, corner.position.y, pose.target.z);
+        const char * names[] = { "tile cull (initial)", "tile cull (corner)", "tile cull (budget)" };
+        for ( int p = 0; p < 3; ++p )
+        {
+            float m[16];
+            (p == 1 ? corner : pose).matrix(resolution.width, resolution.height, m);
+            double ns = measure(iterations, [&]{ culler.cull(m, p == 2 ? pixels / 4 : 0); });
+            const TileCuller::Stats & stats = culler.stats();
+            std::printf("  %-22s %10.3f us %zu / %zu visible, %zu budgeted, %zu ranges\n", names[p], ns * 1E-3,
+                        stats.visible, stats.tiles, stats.budgeted, culler.ranges().size());
+        }
+    }
+    
+    // Mesh export of the full grid, written next to the binary
+    {
+        MeshExporter::Capture capture;
+        const std::string path = std::string("DepthPainterBench_") + resolution.name;
+        report("export capture", measure(iterations, [&]{ capture.capture(canvas, false); }), pixels);
+        size_t bytes = 0;
+        report("export ply",     measure(iterations, [&]{ bytes = MeshExporter::write(capture, path + ".ply", MeshExporter::FORMAT_PLY); }), pixels);
+        std::printf("  %-22s %10zu MB\n", "ply size", bytes >> 20);
+        report("capture (16 bits)", measure(iterations, [&]{ capture.capture(canvas, true); }), pixels);
+        report("export glb (16 bits)", measure(iterations, [&]{ bytes = MeshExporter::write(capture, path + ".glb", MeshExporter::FORMAT_GLB); }), pixels);
+        std::printf("  %-22s %10zu MB\n", "glb size (16 bits)", bytes >> 20);
+        std::remove((path + ".ply").c_str());
+        std::remove((path + ".glb").c_str());
+    }
+    
+    Animator animator;
+    animator.random.seed(1);
+    double now = 0;
+    
+    animator.fireSynapses(canvas);
+    report("updateSynapses", measure(iterations, [&]{ now += 33; animator.updateSynapses(canvas, now); }), pixels);
+    
+    // A million live synapses, discharged without the global wave
+    SynapsePool pool;
+    for ( int s = 0; s < 1000000; ++s ) pool.fire(Random::hash(7, s) % (pixels - 1), s);
+    double ns = measure(iterations, [&]{ now += 33; pool.restore(canvas); pool.step(canvas); pool.discharge(canvas, now * 1E-3); });
+    std::printf("  %-22s %10.3f ms %8.3f ns/synapse\n", "discharge (1M)", ns * 1E-6, ns / 1E6);
+    
+    animator.fireFlattening();
+    report("updateFlattening", measure(iterations, [&]{ now += 33; animator.updateFlattening(canvas, now); }), pixels);
+    
+    report("depth index", measure(iterations, [&]{ canvas.touch(); canvas.depthIndex(); }), pixels);
+    animator.fireInclusion();
+    report("updateInclusion", measure(iterations, [&]{ now += 33; animator.updateInclusion(canvas, now); }), pixels);
+    
+    animator.fireNoise();
+    report("updateNoise", measure(iterations, [&]{ now += 33; animator.updateNoise(canvas, now, 1.f); }), pixels);
+    
+    // Every effect at once, composed in one pass and one pass each
+    for ( int profile = 0; profile < 2; ++profile )
+    {
+        Animator all;
+        all.random.seed(1);
+        all.bProfile = profile;
+        canvas.restore();
+        all.fireSynapses(canvas);
+        all.fireFlattening();
+        all.fireInclusion();
+        all.fireNoise();
+        double t = now;
+        report(profile ? "update (separate)" : "update (fused)", measure(iterations, [&]{ t += 10; all.update(canvas, t, 1.f); }), pixels);
+    }
+    
+    // Gallery of 6 paintings of this size within the default budgets, one of them animated
+    {
+        Gallery gallery;
+        Gallery::Source source;
+        source.width = resolution.width;
+        source.height = resolution.height;
+        source.image = image.data();
+        source.depth = depth16.data();
+        for ( int p = 0; p < 6; ++p ) gallery.add(p, source);
+        gallery.arrange();
+        double ns = measure(1, [&]{ gallery.fit(); });
+        Gallery::Stats stats = gallery.stats();
+        std::printf("  %-22s %10.3f ms %8.2f %% vertexes, %zu MB, %zu topologies\n", "gallery fit", ns * 1E-6,
+                    100.0 * stats.vertexes / (6 * pixels), stats.bytes >> 20, stats.topologies);
+        float m[16];
+        gallery.overview(16 / 9.f).matrix(resolution.width, resolution.height, m);
+        double t = 0;
+        ns = measure(iterations, [&]{ gallery.update(m, t += 10, 1.f); });
+        std::printf("  %-22s %10.3f us\n", "gallery update (idle)", ns * 1E-3);
+        gallery.fire(0, Gallery::NOISE);
+        report("gallery update (1/6)", measure(iterations, [&]{ gallery.update(m, t += 10, 1.f); }), pixels);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    int iterations = 5;
+    std::vector<Resolution> selected;
+    for ( int a = 1; a < argc; ++a )
+    {
+        if ( ! std::strcmp(argv[a], "-i") && a + 1 < argc ) { iterations = std::max(1, std::atoi(argv[++a])); continue; }
+        bool found = false;
+        for ( const Resolution & r : resolutions )
+            if ( ! std::strcmp(argv[a], r.name) ) { selected.push_back(r); found = true; }
+        if ( found ) continue;
+        std::fprintf(stderr, "Usage: %s [1080p] [4k] [8k] [-i iterations]\n", argv[0]);
+        return 1;
+    }
+    if ( selected.empty() ) selected.assign(std::begin(resolutions), std::end(resolutions));
+    
+    std::printf("Threads: %zu (DEPTHPAINTER_THREADS to override)\n", Parallel::pool().threads());
+    
+    // Frame profiler overhead: a scoped timer per stage, then the percentiles of a full window
+    {
+        FrameProfiler profiler;
+        profiler.setup(std::vector<std::string>(20, "stage"));
+        double ns = measure(iterations, [&]{
+            for ( size_t f = 0; f < FrameProfiler::FRAMES; ++f )
+            {
+                for ( size_t s = 0; s < profiler.stages(); ++s ) FrameProfiler::Scope scope(profiler, s);
+                profiler.endFrame();
+            }
+        });
+        std::printf("  %-22s %10.3f ns/stage\n", "profiler scope", ns / (FrameProfiler::FRAMES * profiler.stages()));
+        ns = measure(iterations, [&]{ for ( size_t s = 0; s < profiler.stages(); ++s ) profiler.summary(s); });
+        std::printf("  %-22s %10.3f ms\n", "profiler summary", ns * 1E-6);
+    }
+    
+    // Spectrum analysis of a minute of synthetic audio: one frame, and the whole envelope
+    {
+        Pcm pcm;
+        pcm.rate = 44100;
+        pcm.samples.resize(60 * pcm.rate);
+        for ( size_t s = 0; s < pcm.samples.size(); ++s ) pcm.samples[s] = 0.3f * std::sin(s * 0.0314f) + 0.2f * Random::hashf(1, s);
+        SpectrumFrame frame;
+        size_t end = 0;
+        double ns = measure(iterations, [&]{ for ( int f = 0; f < 100; ++f ) Spectrum::analyze(pcm, end += Spectrum::HOP, frame); });
+        std::printf("  %-22s %10.3f us/frame\n", "spectrum frame", ns * 1E-5);
+        SpectrumEnvelope envelope;
+        ns = measure(iterations, [&]{ envelope.analyze(pcm); });
+        std::printf("  %-22s %10.3f ms per minute, %zu frames\n", "spectrum envelope", ns * 1E-6, envelope.frames());
+    }
+    
+    // Grains of a 10 s sample, the pool kept full: one 512 frame output buffer
+    {
+        auto sample = std::make_shared<Pcm>();
+        sample->rate = 44100;
+        sample->samples.resize(10 * sample->rate);
+        for ( size_t s = 0; s < sample->samples.size(); ++s ) sample->samples[s] = 0.5f * Random::hashf(2, s);
+        GrainEngine grains;
+        grains.setup(sample, 44100);
+        float out[2 * 512];
+        double now = 0;
+        double ns = measure(iterations, [&]{
+            for ( int b = 0; b < 100; ++b )
+            {
+                grains.trigger(GRAIN_MAX_PER_FRAME, now += 1);
+                grains.mix(out, 512);
+            }
+        });
+        std::printf("  %-22s %10.3f us/buffer, %zu voices\n", "grains mix", ns * 1E-5, grains.stats().active);
+    }
+    
+    for ( const Resolution & r : selected ) run(r, iterations);
+    return 0;
+}
@@ -0,0 +1,179 @@
+// Effect strengths at 0, 0.5 and 1: each effect fired and then at rest, a strength changed at rest, and the noise
+// over a partly flattened canvas
+
+#include <cmath>
+#include <algorithm>
+#include "core/Animator.h"
+#include "Check.h"
+
+static const float strengths[] = { 0, 0.5f, 1 };
+
+// A canvas animated at 30 fps from its rest state
+struct Scene
+{
+    Canvas canvas;
+    Animator animator;
+    double now = 0;
+    
+    Scene()
+    {
+        synthesize(canvas, 160, 90);
+        canvas.restore();
+        animator.reset();
+        animator.random.seed(3);
+    }
+    void run(double ms)
+    {
+        for ( double end = now + ms; now < end; ) { now += 1000 / 30.; animator.update(canvas, now, 2.f); }
+    }
+    // Until every effect is at rest, false if they never get there
+    bool settle()
+    {
+        for ( int frame = 0; frame < 60 * 30 && ! animator.idle(); ++frame ) run(1000 / 30.);
+        return animator.idle();
+    }
+    float middle() const { return (canvas.limits.far.z - canvas.limits.near.z) * 0.5f + canvas.limits.near.z; }
+    // Largest distance of the animated depth from the rest depth flattened by 'amount'
+    float flatteningError(float amount) const
+    {
+        float error = 0;
+        for ( size_t v = 0; v < canvas.size(); ++v )
+        {
+            float z = canvas.vertexes[v].z + (middle() - canvas.vertexes[v].z) * amount;
+            error = std::max(error, std::abs(canvas.animated_vertexes[v].z - z));
+        }
+        return error;
+    }
+    // Vertexes hidden by the inclusion, false when one of them disagrees with the cut of 'strength'
+    bool hidden(float strength, size_t & count) const
+    {
+        const float cut = (canvas.limits.far.z - canvas.limits.near.z + 4) * strength + canvas.limits.near.z - 2;
+        bool agree = true;
+        count = 0;
+        for ( size_t v = 0; v < canvas.size(); ++v )
+        {
+            bool shown = canvas.animated_colors[v].a > 0.5f;
+            agree &= shown == (canvas.vertexes[v].z > cut);
+            count += ! shown;
+        }
+        return agree;
+    }
+    // Sum of the distances of the animated vertexes from their rest
+    double displacement() const
+    {
+        double sum = 0;
+        for ( size_t v = 0; v < canvas.size(); ++v )
+        {
+            Vec3 d = canvas.animated_vertexes[v] - canvas.vertexes[v];
+            sum += std::abs(d.x) + std::abs(d.y) + std::abs(d.z);
+        }
+        return sum;
+    }
+};
+
+CHECK_CASE(strengthFlattening)
+{
+    for ( float strength : strengths )
+    {
+        Scene scene;
+        scene.animator.strengths.flattening = strength;
+        scene.animator.fireFlattening();
+        CHECK(scene.settle());
+        CHECK(scene.animator.flattened() == strength);
+        CHECK(scene.flatteningError(strength) < 1E-3f);
+        
+        // Changed at rest: composed again on the next frame
+        const float changed = strength == 0.5f ? 1 : 0.5f;
+        scene.animator.strengths.flattening = changed;
+        CHECK(! scene.animator.idle());
+        scene.run(1000 / 30.);
+        CHECK(scene.animator.idle());
+        CHECK(scene.flatteningError(changed) < 1E-3f);
+    }
+}
+
+CHECK_CASE(strengthInclusion)
+{
+    size_t counts[3];
+    for ( int s = 0; s < 3; ++s )
+    {
+        Scene scene;
+        scene.animator.strengths.inclusion = strengths[s];
+        scene.animator.fireInclusion();
+        CHECK(scene.settle());
+        CHECK(scene.hidden(strengths[s], counts[s]));
+        
+        // Changed at rest: the cut moves on the next frame
+        const float changed = strengths[s] == 0.5f ? 1 : 0.5f;
+        scene.animator.strengths.inclusion = changed;
+        CHECK(! scene.animator.idle());
+        scene.run(1000 / 30.);
+        size_t count;
+        CHECK(scene.animator.idle() && scene.hidden(changed, count));
+    }
+    // The cut of 0.5 between the ones of 0 and 1
+    CHECK(counts[0] != counts[2]);
+    CHECK(std::min(counts[0], counts[2]) < counts[1] && counts[1] < std::max(counts[0], counts[2]));
+}
+
+CHECK_CASE(strengthNoise)
+{
+    // Over a flattened canvas, whose depth the noise displaces from the middle plane
+    float deviations[3];
+    for ( int s = 0; s < 3; ++s )
+    {
+        Scene scene;
+        scene.animator.fireFlattening();
+        CHECK(scene.settle());
+        scene.animator.strengths.noise = strengths[s];
+        scene.animator.fireNoise();
+        scene.run(8000);
+        deviations[s] = scene.flatteningError(1);
+        
+        // Released, back to the flattened rest
+        scene.animator.fireNoise();
+        CHECK(scene.settle());
+        CHECK(scene.flatteningError(1) < 1E-3f);
+    }
+    CHECK(deviations[0] == 0);
+    CHECK(0 < deviations[1] && deviations[1] < deviations[2]);
+}
+
+CHECK_CASE(strengthSynapses)
+{
+    // Same seed, so the same sparks and wave: only the wave scales with its strength
+    double displacements[3];
+    for ( int s = 0; s < 3; ++s )
+    {
+        Scene scene;
+        scene.animator.strengths.synapses = strengths[s];
+        scene.animator.fireSynapses(scene.canvas);
+        scene.run(300);
+        displacements[s] = scene.displacement();
+        CHECK(scene.settle());
+    }
+    CHECK(displacements[2] > displacements[0]);
+    const double wave = displacements[2] - displacements[0];
+    CHECK(std::abs(displacements[1] - displacements[0] - 0.5 * wave) < 0.01 * wave);
+}
+
+CHECK_CASE(strengthFlatteningWithNoise)
+{
+    // Half flattened, the noise keeps displacing the same flattened depth instead of sinking the canvas frame after frame
+    Scene scene;
+    scene.animator.strengths.flattening = 0.5f;
+    scene.animator.fireFlattening();
+    scene.run(10000);
+    scene.animator.fireNoise();
+    const float reach = 0.25f * std::abs(scene.canvas.limits.far.z - scene.canvas.limits.near.z);
+    const float low = std::min(scene.canvas.limits.near.z, scene.canvas.limits.far.z) - reach;
+    const float high = std::max(scene.canvas.limits.near.z, scene.canvas.limits.far.z) + reach;
+    bool within = true;
+    for ( int second = 0; second < 30; ++second )
+    {
+        scene.run(1000);
+        for ( size_t v = 0; v < scene.canvas.size(); ++v )
+            within &= scene.canvas.animated_vertexes[v].z >= low && scene.canvas.animated_vertexes[v].z <= high;
+    }
+    CHECK(within);
+}
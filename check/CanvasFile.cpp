@@ -0,0 +1,56 @@
+// Precomputed canvas files: concurrent writers of one path, and files cut or grown after writing
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "core/CanvasFile.h"
+#include "Check.h"
+
+static const char * path = "DepthPainterCheck.dpc";
+
+// Copy of the file at 'path' with its size changed by 'delta' bytes
+static bool resize(const std::string & copy, long delta)
+{
+    std::vector<char> bytes;
+    FILE * f = std::fopen(path, "rb");
+    if ( ! f ) return false;
+    char chunk[4096];
+    for ( size_t n; (n = std::fread(chunk, 1, sizeof(chunk), f)) > 0; ) bytes.insert(bytes.end(), chunk, chunk + n);
+    std::fclose(f);
+    bytes.resize(bytes.size() + delta);
+    f = std::fopen(copy.c_str(), "wb");
+    if ( ! f ) return false;
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+CHECK_CASE(canvasFileWriters)
+{
+    const int width = 64, height = 48, n = width * height;
+    std::vector<unsigned char> image(n * 3, 200);
+    std::vector<uint16_t> depth(n, 30000);
+    
+    // Same path from several threads, each through its own temporary file
+    std::vector<std::thread> threads;
+    std::vector<char> written(4, 0);
+    for ( int t = 0; t < 4; ++t )
+        threads.emplace_back([&, t] {
+            for ( int k = 0; k < 10 && (written[t] = CanvasFile::write(path, 7, width, height, image.data(), depth.data())); ++k ) {}
+        });
+    for ( std::thread & thread : threads ) thread.join();
+    for ( char ok : written ) CHECK(ok);
+    
+    CanvasFile file;
+    CHECK(file.open(path));
+    CHECK(file.isOpen() && file.getStamp() == 7 && file.width() == width && file.height() == height);
+    CHECK(file.isOpen() && file.depth()[n - 1] == 30000);
+    file.close();
+    
+    // A cut or grown file does not match the length of its header
+    const std::string cut = std::string(path) + ".cut", grown = std::string(path) + ".grown";
+    CHECK(resize(cut, -1) && ! file.open(cut));
+    CHECK(resize(grown, 64) && ! file.open(grown));
+    std::remove(cut.c_str());
+    std::remove(grown.c_str());
+    std::remove(path);
+}
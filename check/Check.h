@@ -0,0 +1,32 @@
+// Minimal headless checks: every CHECK_CASE registers itself, Main.cpp runs them all and counts the CHECKs that fail.
+
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+class Canvas;
+
+struct CheckCase
+{
+    const char * name;
+    void (*run)();
+};
+std::vector<CheckCase> & checkCases();
+extern int check_failures;
+
+struct CheckRegistrar
+{
+    CheckRegistrar(const char * name, void (*run)()) { checkCases().push_back(CheckCase{ name, run }); }
+};
+
+#define CHECK_CASE(name) \
+    static void name(); \
+    static CheckRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { if ( ! (condition) ) { ++check_failures; std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while ( 0 )
+
+// Gradient image over a wavy depth, loaded and projected as the app does
+void synthesize(Canvas & canvas, int width, int height);
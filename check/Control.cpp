@@ -0,0 +1,50 @@
+// Control server on loopback: a bundle and a burst of one parameter, as a frame drains them
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "core/Control.h"
+#include "Check.h"
+
+CHECK_CASE(controlDrain)
+{
+    ControlServer server;
+    CHECK(server.start(0));
+    CHECK(server.getPort() > 0);
+    ControlClient client;
+    CHECK(client.open(server.getPort()));
+    
+    // A key and the extrusion in one bundle, 50 focal values, then another key
+    std::vector<ControlCommand> bundle(2);
+    std::strcpy(bundle[0].address, "/key");
+    bundle[0].argument = ControlCommand::STRING;
+    std::strcpy(bundle[0].text, "s");
+    std::strcpy(bundle[1].address, "/extrusion");
+    bundle[1].argument = ControlCommand::FLOAT;
+    bundle[1].value = 1.5f;
+    CHECK(client.send(bundle));
+    for ( int f = 1; f <= 50; ++f ) CHECK(client.send("/focal", f * 100.f));
+    CHECK(client.send("/key", "e"));
+    
+    const size_t sent = 2 + 50 + 1;
+    for ( int wait = 0; wait < 1000 && server.stats().received < sent; ++wait ) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::vector<ControlCommand> commands;
+    server.drain(commands);
+    CHECK(commands.size() == 4);
+    if ( commands.size() == 4 )
+    {
+        CHECK(commands[0].is("/key") && commands[0].argument == ControlCommand::STRING && ! std::strcmp(commands[0].text, "s"));
+        CHECK(commands[1].is("/extrusion") && commands[1].parameter() && commands[1].value == 1.5f);
+        CHECK(commands[2].is("/focal") && commands[2].parameter() && commands[2].value == 5000.f);
+        CHECK(commands[3].is("/key") && ! std::strcmp(commands[3].text, "e"));
+    }
+    ControlServer::Stats stats = server.stats();
+    CHECK(stats.received == sent && stats.coalesced == 49 && stats.dropped == 0 && stats.malformed == 0);
+    
+    // Nothing new since
+    server.drain(commands);
+    CHECK(commands.empty());
+    server.stop();
+    CHECK(! server.running());
+}
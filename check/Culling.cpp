@@ -0,0 +1,142 @@
+// Tile culling against known camera poses: the whole canvas, nothing, the frustum edge across it and the budget
+
+#include <cmath>
+#include <algorithm>
+#include "core/Canvas.h"
+#include "core/Culling.h"
+#include "core/Pose.h"
+#include "Check.h"
+
+static const int viewport_width = 1280, viewport_height = 720;
+
+struct Culled
+{
+    TileCuller culler;
+    std::vector<bool> drawn;            // per tile, from the ranges
+    bool ranges_valid = true;           // sorted, merged, and on tile boundaries
+};
+
+// Culls 'canvas' seen from 'pose' and reads back which tiles the ranges draw
+static void cull(const Canvas & canvas, const CameraPose & pose, size_t budget, Culled & culled)
+{
+    float m[16];
+    pose.matrix(viewport_width, viewport_height, m);
+    culled.culler.bound(canvas);
+    culled.culler.cull(m, budget);
+    
+    const Topology & topology = *canvas.topology;
+    const size_t tiles = (size_t) topology.tiles_x * topology.tiles_y;
+    const uint32_t * starts = topology.tile_starts.data();
+    culled.drawn.assign(tiles, false);
+    culled.ranges_valid = true;
+    uint32_t end = 0;
+    for ( const TileCuller::Range & range : culled.culler.ranges() )
+    {
+        // Adjacent ranges would have been merged
+        culled.ranges_valid &= range.count && (end == 0 || range.first > end);
+        end = range.first + range.count;
+        const uint32_t * first = std::lower_bound(starts, starts + tiles + 1, range.first);
+        const uint32_t * last = std::lower_bound(starts, starts + tiles + 1, end);
+        culled.ranges_valid &= first != starts + tiles + 1 && *first == range.first && last != starts + tiles + 1 && *last == end;
+        for ( const uint32_t * t = first; t < last; ++t ) culled.drawn[t - starts] = true;
+    }
+}
+static size_t count(const std::vector<bool> & drawn) { return std::count(drawn.begin(), drawn.end(), true); }
+
+// Tiles with at least one vertex inside the frustum, and with vertexes on both sides of its planes
+static void insideTiles(const Canvas & canvas, const CameraPose & pose, std::vector<bool> & inside, size_t & straddling)
+{
+    float m[16];
+    pose.matrix(viewport_width, viewport_height, m);
+    const Frustum frustum(m);
+    const Topology & topology = *canvas.topology;
+    inside.assign((size_t) topology.tiles_x * topology.tiles_y, false);
+    std::vector<bool> outside(inside.size(), false);
+    for ( int y = 0; y < canvas.height; ++y )
+        for ( int x = 0; x < canvas.width; ++x )
+        {
+            const Vec3 & v = canvas.animated_vertexes[(size_t) y * canvas.width + x];
+            size_t t = (size_t) std::min(y / Topology::tile, topology.tiles_y - 1) * topology.tiles_x
+                     + std::min(x / Topology::tile, topology.tiles_x - 1);
+            (frustum.intersects(v, v) ? inside : outside)[t] = true;
+        }
+    straddling = 0;
+    for ( size_t t = 0; t < inside.size(); ++t ) straddling += inside[t] && outside[t];
+}
+
+CHECK_CASE(cullingPoses)
+{
+    Canvas canvas;
+    synthesize(canvas, 640, 360);
+    canvas.restore();
+    const size_t tiles = 10 * 6;
+    CHECK(canvas.topology->tiles_x == 10 && canvas.topology->tiles_y == 6);
+    
+    // Fully inside: backed away from the canvas, every tile is drawn as one range
+    CameraPose pose = CameraPose::initial(canvas);
+    CameraPose away = pose;
+    away.position = pose.target + (pose.position - pose.target) * 3.f;
+    Culled culled;
+    cull(canvas, away, 0, culled);
+    CHECK(culled.culler.stats().tiles == tiles && culled.culler.stats().visible == tiles && culled.culler.stats().culled == 0);
+    CHECK(culled.culler.stats().vertexes == canvas.size());
+    CHECK(culled.culler.ranges().size() == 1 && culled.ranges_valid && count(culled.drawn) == tiles);
+    
+    // Fully outside: looking the other way
+    CameraPose behind = pose;
+    behind.target = pose.position + (pose.position - pose.target);
+    cull(canvas, behind, 0, culled);
+    CHECK(culled.culler.stats().visible == 0 && culled.culler.stats().culled == tiles);
+    CHECK(culled.culler.ranges().empty() && culled.culler.stats().vertexes == 0);
+    
+    // Edge across the canvas: moved sideways by half the view width at the target, a side of the view runs down
+    // the canvas. The tiles beyond it go, those across the plane stay.
+    const Vec3 view = pose.target - pose.position;
+    const float distance = std::sqrt(view.x * view.x + view.y * view.y + view.z * view.z);
+    const Vec3 side(distance * std::tan(pose.fov * 0.5f * M_PI / 180) * viewport_width / viewport_height, 0, 0);
+    CameraPose shifted = pose;
+    shifted.position = pose.position + side;
+    shifted.target = pose.target + side;
+    std::vector<bool> inside;
+    size_t straddling;
+    insideTiles(canvas, shifted, inside, straddling);
+    cull(canvas, shifted, 0, culled);
+    const TileCuller::Stats & stats = culled.culler.stats();
+    CHECK(stats.visible >= count(inside) && stats.culled > 0 && stats.visible + stats.culled == tiles);
+    CHECK(straddling > 0);
+    CHECK(culled.ranges_valid && count(culled.drawn) == stats.visible);
+    bool kept = true;
+    for ( size_t t = 0; t < tiles; ++t ) kept &= ! inside[t] || culled.drawn[t];
+    CHECK(kept);
+    
+    // Budget: the nearest tiles up to a quarter of the vertexes, the others dropped
+    const size_t budget = canvas.size() / 4;
+    cull(canvas, away, budget, culled);
+    CHECK(culled.culler.stats().visible == tiles && culled.culler.stats().budgeted > 0);
+    CHECK(culled.culler.stats().vertexes <= budget && culled.culler.stats().vertexes > 0);
+    CHECK(culled.ranges_valid && count(culled.drawn) == tiles - culled.culler.stats().budgeted);
+}
+
+CHECK_CASE(cullingPoints)
+{
+    // Points of strips are drawn without indices: the ranges are rows of vertexes, as many as the drawn tiles have
+    Canvas canvas;
+    synthesize(canvas, 640, 360);
+    canvas.render = RENDER_POINTS;
+    canvas.strips = true;
+    canvas.updateTopology();
+    canvas.restore();
+    CameraPose pose = CameraPose::initial(canvas);
+    pose.position = pose.target + (pose.position - pose.target) * 3.f;
+    float m[16];
+    pose.matrix(viewport_width, viewport_height, m);
+    CHECK(canvas.topology->tile_starts.empty());
+    TileCuller culler;
+    culler.bound(canvas);
+    culler.cull(m, canvas.size() / 4);
+    size_t drawn = 0;
+    for ( const TileCuller::Range & range : culler.ranges() ) drawn += range.count;
+    CHECK(culler.stats().budgeted > 0 && drawn == culler.stats().vertexes);
+    culler.cull(m);
+    CHECK(culler.ranges().size() == 1 && culler.ranges()[0].first == 0 && culler.ranges()[0].count == canvas.size());
+}
@@ -0,0 +1,51 @@
+// Headless checks of the core: runs every CHECK_CASE and exits with 1 if any CHECK failed.
+// Usage: DepthPainterCheck [case ...]
+
+#include <cmath>
+#include <cstring>
+#include "core/Canvas.h"
+#include "core/Settings.h"
+#include "Check.h"
+
+std::vector<CheckCase> & checkCases()
+{
+    static std::vector<CheckCase> cases;
+    return cases;
+}
+int check_failures = 0;
+
+void synthesize(Canvas & canvas, int width, int height)
+{
+    std::vector<unsigned char> image((size_t) width * height * 3), depth((size_t) width * height);
+    for ( int y = 0; y < height; ++y )
+        for ( int x = 0; x < width; ++x )
+        {
+            size_t pos = (size_t) y * width + x;
+            image[pos * 3] = 255 * x / width;
+            image[pos * 3 + 1] = 255 * y / height;
+            image[pos * 3 + 2] = 128;
+            depth[pos] = (unsigned char) (128 + 100 * std::sin(x * 0.02) * std::cos(y * 0.03));
+        }
+    canvas.width = width;
+    canvas.height = height;
+    canvas.load(image.data(), depth.data(), 1, false);
+    canvas.project(CAMERA_INIT_FOCAL, CANVAS_INIT_EXTRUSION);
+    canvas.updateTopology();
+}
+
+int main(int argc, char ** argv)
+{
+    size_t ran = 0;
+    for ( const CheckCase & c : checkCases() )
+    {
+        bool selected = argc < 2;
+        for ( int a = 1; a < argc; ++a ) selected |= std::strcmp(argv[a], c.name) == 0;
+        if ( ! selected ) continue;
+        int failures = check_failures;
+        c.run();
+        std::printf("%-32s %s\n", c.name, check_failures == failures ? "ok" : "FAILED");
+        ++ran;
+    }
+    std::printf("%zu cases, %d failed checks\n", ran, check_failures);
+    return check_failures ? 1 : 0;
+}
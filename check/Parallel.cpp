@@ -0,0 +1,41 @@
+// Worker pool: every chunk runs once, also with several threads submitting jobs at the same time
+
+#include <thread>
+#include <vector>
+#include "core/Parallel.h"
+#include "Check.h"
+
+static bool sums(size_t count)
+{
+    size_t sum = parallelReduce(count, (size_t) 0, [](size_t begin, size_t end) {
+        size_t s = 0;
+        for ( size_t i = begin; i < end; ++i ) s += i;
+        return s;
+    }, [](size_t a, size_t b) { return a + b; }, 64);
+    return sum == count * (count - 1) / 2;
+}
+
+CHECK_CASE(parallelChunks)
+{
+    CHECK(sums(1));
+    CHECK(sums(100000));
+    std::vector<int> seen(10000, 0);
+    parallelFor(seen.size(), [&](size_t begin, size_t end) { for ( size_t i = begin; i < end; ++i ) ++seen[i]; }, 7);
+    bool once = true;
+    for ( int s : seen ) once &= s == 1;
+    CHECK(once);
+}
+
+CHECK_CASE(parallelConcurrentCallers)
+{
+    // Other threads keep the pool busy while this one submits its own jobs
+    std::vector<std::thread> callers;
+    std::vector<int> ok(4, 1);
+    for ( size_t t = 0; t < ok.size(); ++t )
+        callers.emplace_back([&, t]{ for ( int n = 0; n < 200; ++n ) ok[t] &= sums(20000 + n); });
+    bool mine = true;
+    for ( int n = 0; n < 200; ++n ) mine &= sums(30000 + n);
+    for ( auto & caller : callers ) caller.join();
+    CHECK(mine);
+    for ( int o : ok ) CHECK(o);
+}
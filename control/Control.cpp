@@ -0,0 +1,85 @@
+// Show control client: sends OSC messages to the app control server (see core/Control.h) on the loopback interface.
+// A value after an address is sent as a float when it is a number, else as a string. With -l it is a server instead,
+// printing the commands it drains every frame, to check a controller without the app.
+// Usage: DepthPainterControl [-p port] [-n times] /address [value] [/address [value] ...]
+//        DepthPainterControl -l [-p port]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/Control.h"
+
+static int usage(const char * name)
+{
+    std::fprintf(stderr, "Usage: %s [-p port] [-n times] /address [value] [/address [value] ...]\n       %s -l [-p port]\n", name, name);
+    return 1;
+}
+
+static int listen(int port)
+{
+    ControlServer server;
+    if ( ! server.start(port) ) { std::fprintf(stderr, "%s\n", server.error.c_str()); return 1; }
+    std::printf("Listening on port %d\n", server.getPort());
+    std::vector<ControlCommand> commands;
+    for ( size_t frame = 0; ; ++frame )
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(33));
+        server.drain(commands);
+        for ( const ControlCommand & command : commands )
+        {
+            std::printf("%8zu  %s", frame, command.address);
+            if ( command.argument == ControlCommand::STRING ) std::printf(" %s", command.text);
+            else if ( command.argument != ControlCommand::NONE ) std::printf(" %g", command.value);
+            std::printf("\n");
+        }
+        if ( commands.size() )
+        {
+            ControlServer::Stats stats = server.stats();
+            std::printf("          %zu received, %zu coalesced, %zu dropped, %zu malformed\n", stats.received, stats.coalesced, stats.dropped, stats.malformed);
+            std::fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    int port = CONTROL_PORT, times = 1;
+    bool bListen = false;
+    std::vector<ControlCommand> commands;
+    for ( int a = 1; a < argc; ++a )
+    {
+        std::string arg = argv[a];
+        bool value = a + 1 < argc;
+        if ( arg == "-p" && value ) port = std::atoi(argv[++a]);
+        else if ( arg == "-n" && value ) times = std::max(1, std::atoi(argv[++a]));
+        else if ( arg == "-l" ) bListen = true;
+        else if ( arg[0] == '/' && arg.size() < ControlCommand::length )
+        {
+            ControlCommand command;
+            arg.copy(command.address, arg.size());
+            if ( value && argv[a + 1][0] != '/' )
+            {
+                std::string text = argv[++a];
+                char * end;
+                command.value = std::strtof(text.c_str(), &end);
+                command.argument = *end || text.empty() ? ControlCommand::STRING : ControlCommand::FLOAT;
+                if ( command.argument == ControlCommand::STRING ) text.copy(command.text, ControlCommand::length - 1);
+            }
+            commands.push_back(command);
+        }
+        else return usage(argv[0]);
+    }
+    if ( bListen ) return listen(port);
+    if ( commands.empty() ) return usage(argv[0]);
+    
+    ControlClient client;
+    if ( ! client.open(port) ) { std::fprintf(stderr, "Could not open a UDP socket\n"); return 1; }
+    for ( int t = 0; t < times; ++t )
+        for ( const ControlCommand & command : commands )
+            if ( ! client.send(command) ) { std::fprintf(stderr, "Could not send %s\n", command.address); return 1; }
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Offline renderer: the camera orbit of the app over a precomputed canvas (.dpc, see DepthPainter --convert),
+// rasterized on the CPU into a PPM image sequence.
+// Usage: DepthPainterRender canvas.dpc [-o prefix] [-n frames] [-s WIDTHxHEIGHT] [-m points|wireframe|fill] [--lod] [--strips]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "core/Canvas.h"
+#include "core/CanvasFile.h"
+#include "core/Parallel.h"
+#include "core/Pose.h"
+#include "core/Raster.h"
+#include "core/Settings.h"
+
+static bool writePpm(const std::string & path, const Rasterizer & raster)
+{
+    FILE * file = std::fopen(path.c_str(), "wb");
+    if ( ! file ) return false;
+    std::fprintf(file, "P6\n%d %d\n255\n", raster.getWidth(), raster.getHeight());
+    size_t size = (size_t) raster.getWidth() * raster.getHeight() * 3;
+    bool ok = std::fwrite(raster.pixels(), 1, size, file) == size;
+    return std::fclose(file) == 0 && ok;
+}
+
+// Background colours of the app: the colour in the middle of the painting, dimmed
+static void backgroundOf(const CanvasFile & file, Color & center, Color & edge)
+{
+    size_t pixel = file.width() * (1 + file.height() / 2);
+    const unsigned char * rgb = file.image() + pixel * 3;
+    float h, s, v;
+    Color::fromBytes(rgb[0], rgb[1], rgb[2]).getHsb(h, s, v);
+    center.setHsb(h, s, 55 / 255.f);
+    edge.setHsb(h, s, 15 / 255.f);
+}
+
+static int usage(const char * name)
+{
+    std::fprintf(stderr, "Usage: %s canvas.dpc [-o prefix] [-n frames] [-s WIDTHxHEIGHT] [-m points|wireframe|fill] [--lod] [--strips]\n", name);
+    return 1;
+}
+
+int main(int argc, char ** argv)
+{
+    std::string input, prefix;
+    int frames = 100, width = 1920, height = 1080;
+    Canvas canvas;
+    canvas.render = RENDER_FILL;
+    for ( int a = 1; a < argc; ++a )
+    {
+        std::string arg = argv[a];
+        bool value = a + 1 < argc;
+        if      ( arg == "-o" && value ) prefix = argv[++a];
+        else if ( arg == "-n" && value ) frames = std::max(1, std::atoi(argv[++a]));
+        else if ( arg == "-s" && value ) { if ( std::sscanf(argv[++a], "%dx%d", &width, &height) != 2 || width < 1 || height < 1 ) return usage(argv[0]); }
+        else if ( arg == "-m" && value )
+        {
+            std::string mode = argv[++a];
+            if      ( mode == "points" )    canvas.render = RENDER_POINTS;
+            else if ( mode == "wireframe" ) canvas.render = RENDER_WIREFRAME;
+            else if ( mode == "fill" )      canvas.render = RENDER_FILL;
+            else return usage(argv[0]);
+        }
+        else if ( arg == "--lod" )    canvas.lod_tolerance = LOD_TOLERANCE;
+        else if ( arg == "--strips" ) canvas.strips = true;
+        else if ( input.empty() && arg[0] != '-' ) input = arg;
+        else return usage(argv[0]);
+    }
+    if ( input.empty() ) return usage(argv[0]);
+    
+    CanvasFile file;
+    if ( ! file.open(input) ) { std::fprintf(stderr, "Could not open %s\n", input.c_str()); return 1; }
+    file.load(canvas, CAMERA_INIT_FOCAL, CANVAS_INIT_EXTRUSION, false);
+    canvas.updateTopology();
+    
+    Rasterizer raster;
+    backgroundOf(file, raster.center, raster.edge);
+    
+    std::printf("%s: %d x %d canvas, %zu vertexes, %d x %d frames, %zu threads\n", input.c_str(), canvas.width, canvas.height,
+                canvas.size(), width, height, Parallel::pool().threads());
+    double rendering = 0;
+    auto start = std::chrono::steady_clock::now();
+    for ( int f = 0; f < frames; ++f )
+    {
+        raster.render(canvas, CameraPose::orbit(canvas, 0, f), width, height);
+        rendering += raster.timing.total();
+        if ( prefix.empty() ) continue;
+        char name[32];
+        std::snprintf(name, sizeof(name), "_%05d.ppm", f);
+        if ( ! writePpm(prefix + name, raster) ) { std::fprintf(stderr, "Could not write %s%s\n", prefix.c_str(), name); return 1; }
+    }
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu primitives, last frame: transform %.2f ms, bin %.2f ms, raster %.2f ms\n", raster.primitives,
+                raster.timing.transform, raster.timing.bin, raster.timing.raster);
+    std::printf("%.2f fps rendering, %.2f fps with output\n", frames * 1E3 / rendering, frames * 1E3 / total);
+    return 0;
+}
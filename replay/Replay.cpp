@@ -0,0 +1,114 @@
+// Deterministic replay: runs a timeline script (see core/Replay.h) over precomputed canvases on a fixed-step
+// virtual clock, as fast as it goes, then reports the frame times and a checksum of the final canvas buffers.
+// With a grain sample, the grains of the effects are mixed offline, and written with -w.
+// Usage: DepthPainterReplay script.txt [-d directory] [-r WIDTHxHEIGHT] [-c frames.csv] [-g grain.wav [-w mix.wav]]
+
+#include <chrono>
+#include <cmath>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "core/Parallel.h"
+#include "core/Replay.h"
+
+static int usage(const char * name)
+{
+    std::fprintf(stderr, "Usage: %s script.txt [-d directory] [-r WIDTHxHEIGHT] [-c frames.csv] [-g grain.wav [-w mix.wav]]\n", name);
+    return 1;
+}
+
+// Nearest rank percentiles of one of the frame times
+static void report(const char * stage, const std::vector<Replay::Frame> & frames, double Replay::Frame::* time)
+{
+    std::vector<double> sorted;
+    for ( const Replay::Frame & frame : frames ) sorted.push_back(frame.*time);
+    if ( sorted.empty() ) return;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) { return sorted[std::min(sorted.size() - 1, (size_t) std::max(0., std::ceil(p * sorted.size()) - 1))]; };
+    std::printf("  %-8s p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f ms\n", stage, percentile(0.5), percentile(0.95), percentile(0.99), sorted.back());
+}
+
+int main(int argc, char ** argv)
+{
+    std::string script_path, directory, csv, grain_path, mix_path;
+    Replay replay;
+    for ( int a = 1; a < argc; ++a )
+    {
+        std::string arg = argv[a];
+        bool value = a + 1 < argc;
+        if      ( arg == "-d" && value ) directory = argv[++a];
+        else if ( arg == "-c" && value ) csv = argv[++a];
+        else if ( arg == "-g" && value ) grain_path = argv[++a];
+        else if ( arg == "-w" && value ) mix_path = argv[++a];
+        else if ( arg == "-r" && value )
+        {
+            if ( std::sscanf(argv[++a], "%dx%d", &replay.raster_width, &replay.raster_height) != 2 || replay.raster_width < 1 || replay.raster_height < 1 )
+                return usage(argv[0]);
+        }
+        else if ( script_path.empty() && arg[0] != '-' ) script_path = arg;
+        else return usage(argv[0]);
+    }
+    if ( script_path.empty() || ( grain_path.empty() && ! mix_path.empty() ) ) return usage(argv[0]);
+    if ( ! grain_path.empty() )
+    {
+        auto grain = std::make_shared<Pcm>();
+        if ( ! grain->loadWav(grain_path) ) { std::fprintf(stderr, "Could not decode %s\n", grain_path.c_str()); return 1; }
+        replay.grain_sample = grain;
+    }
+    
+    // Sources are relative to the script by default
+    if ( directory.empty() )
+    {
+        size_t slash = script_path.find_last_of('/');
+        directory = slash == std::string::npos ? "." : script_path.substr(0, slash);
+    }
+    
+    ReplayScript script;
+    if ( ! script.load(script_path) ) { std::fprintf(stderr, "%s\n", script.error.c_str()); return 1; }
+    std::printf("%s: %zu events, %zu frames of %.3f ms, seed %" PRIu64 ", %zu threads\n", script_path.c_str(), script.events.size(),
+                script.frames(), script.step, script.seed, Parallel::pool().threads());
+    
+    auto start = std::chrono::steady_clock::now();
+    if ( ! replay.run(script, directory) ) { std::fprintf(stderr, "%s\n", replay.error.c_str()); return 1; }
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    std::printf("%.1f ms, %.2f fps\n", total, replay.frames.size() * 1E3 / total);
+    report("events", replay.frames, &Replay::Frame::events);
+    report("update", replay.frames, &Replay::Frame::update);
+    if ( replay.raster_width > 0 ) report("cull", replay.frames, &Replay::Frame::cull);
+    if ( replay.raster_width > 0 ) report("raster", replay.frames, &Replay::Frame::raster);
+    if ( replay.grain_sample ) report("mix", replay.frames, &Replay::Frame::mix);
+    report("frame", replay.frames, &Replay::Frame::total);
+    std::printf("Canvas %d x %d, %zu vertexes, checksum %016" PRIx64 "\n", replay.canvas.width, replay.canvas.height,
+                replay.canvas.size(), Replay::checksum(replay.canvas));
+    if ( replay.raster_width > 0 )
+        std::printf("Last frame checksum %016" PRIx64 "\n", Replay::checksum(replay.raster.pixels(), (size_t) replay.raster_width * replay.raster_height * 3));
+    if ( replay.grain_sample )
+    {
+        GrainEngine::Stats grained = replay.grains.stats();
+        std::printf("Grains %zu requested, %zu started, %zu limited, %zu stolen, mix checksum %016" PRIx64 "\n", grained.requested, grained.started,
+                    grained.limited, grained.stolen, Replay::checksum(replay.mixdown.data(), replay.mixdown.size() * sizeof(float)));
+        if ( ! mix_path.empty() && ! Pcm::writeWav(mix_path, replay.mixdown.data(), replay.mixdown.size() / 2, 2, replay.grain_rate) )
+        {
+            std::fprintf(stderr, "Could not write %s\n", mix_path.c_str());
+            return 1;
+        }
+    }
+    
+    if ( csv.empty() ) return 0;
+    FILE * file = std::fopen(csv.c_str(), "w");
+    if ( ! file ) { std::fprintf(stderr, "Could not write %s\n", csv.c_str()); return 1; }
+    std::fprintf(file, "frame,time,events,update,cull,raster,mix,total,firings,grains,visible,culled\n");
+    for ( size_t f = 0; f < replay.frames.size(); ++f )
+    {
+        const Replay::Frame & frame = replay.frames[f];
+        std::fprintf(file, "%zu,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%zu,%zu,%zu,%zu\n", f, frame.time, frame.events, frame.update, frame.cull,
+                     frame.raster, frame.mix, frame.total, frame.firings, frame.grains, frame.visible, frame.culled);
+    }
+    return std::fclose(file) == 0 ? 0 : 1;
+}
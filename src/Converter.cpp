@@ -0,0 +1,89 @@
+#include <atomic>
+#include "Converter.h"
+#include "ofApp.h"
+#include "core/Audio.h"
+#include "core/CanvasFile.h"
+#include "core/Depth.h"
+#include "core/Parallel.h"
+
+//--------------------------------------------------------------
+bool decodeExample(const string & image_path, const string & depth_path, ofPixels & image, Buffer<uint16_t> & depth)
+{
+    // Float pixels keep 16-bit and float depth maps, normalized to [0,1]
+    ofFloatPixels raw;
+    if ( ! ofLoadImage(image, image_path) || ! ofLoadImage(raw, depth_path) ) return false;
+    raw.setImageType(OF_IMAGE_GRAYSCALE);
+    image.setImageType(OF_IMAGE_COLOR);
+    DepthUpsampler::prepare(raw.getData(), raw.getWidth(), raw.getHeight(), image.getData(), image.getWidth(), image.getHeight(), depth);
+    return true;
+}
+string canvasPath(const string & image_path)
+{
+    return ofFilePath::removeExt(image_path) + ".dpc";
+}
+bool convertExample(const string & image_path, const string & depth_path, bool geometry)
+{
+    ofPixels image;
+    Buffer<uint16_t> depth;
+    if ( ! decodeExample(image_path, depth_path, image, depth) ) return false;
+    
+    int width = image.getWidth(), height = image.getHeight();
+    uint64_t stamp = CanvasFile::stamp(image_path, depth_path);
+    std::unique_lock<std::mutex> converting = CanvasFile::lock(canvasPath(image_path));
+    if ( ! geometry ) return CanvasFile::write(canvasPath(image_path), stamp, width, height, image.getData(), depth.data());
+    
+    Canvas canvas;
+    canvas.width = width;
+    canvas.height = height;
+    canvas.load(image.getData(), depth.data(), false);
+    canvas.project(CAMERA_INIT_FOCAL, CANVAS_INIT_EXTRUSION);
+    return CanvasFile::write(canvasPath(image_path), stamp, width, height, image.getData(), depth.data(),
+                             &canvas, CAMERA_INIT_FOCAL, CANVAS_INIT_EXTRUSION);
+}
+size_t convertDirectory(const string & directory, bool geometry)
+{
+    ofDirectory dir(directory);
+    dir.allowExt("png");
+    dir.allowExt("jpg");
+    dir.allowExt("jpeg");
+    dir.listDir();
+    
+    // '<name>_depth.<ext>' next to '<name>.<ext>', any of the extensions
+    vector<pair<string, string>> pairs;
+    for ( size_t f = 0; f < dir.size(); ++f )
+    {
+        string depth_path = dir.getPath(f);
+        string name = ofFilePath::removeExt(depth_path);
+        if ( name.size() < 6 || name.compare(name.size() - 6, 6, "_depth") ) continue;
+        name.erase(name.size() - 6);
+        for ( const string & ext : { ".png", ".jpg", ".jpeg" } )
+            if ( ofFile::doesFileExist(name + ext, false) ) { pairs.push_back(make_pair(name + ext, depth_path)); break; }
+    }
+    
+    std::atomic<size_t> converted(0);
+    parallelFor(pairs.size(), [&](size_t begin, size_t end) {
+        for ( size_t p = begin; p < end; ++p )
+        {
+            bool ok = convertExample(pairs[p].first, pairs[p].second, geometry);
+            if ( ok ) ++converted;
+            else ofLogError() << "Could not convert " << pairs[p].first;
+        }
+    }, 1);
+    ofLogNotice() << converted << " of " << pairs.size() << " examples converted in " << directory;
+    return converted;
+}
+//--------------------------------------------------------------
+string envelopePath(const string & track_path)
+{
+    return ofFilePath::removeExt(track_path) + ".dpe";
+}
+bool convertSoundtrack(const string & track_path)
+{
+    Pcm pcm;
+    SpectrumEnvelope envelope;
+    if ( ! pcm.loadWav(track_path) ) { ofLogError() << "Could not decode " << track_path; return false; }
+    envelope.analyze(pcm);
+    if ( ! envelope.write(envelopePath(track_path)) ) { ofLogError() << "Could not write " << envelopePath(track_path); return false; }
+    ofLogNotice() << envelope.frames() << " spectrum frames of " << track_path << " written to " << envelopePath(track_path);
+    return true;
+}
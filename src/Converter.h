@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ofMain.h"
+#include "core/Buffer.h"
+
+// Precomputed canvases (.dpc, see core/CanvasFile.h) of the examples, made on their first load or in batch:
+//   DepthPainter --convert [directory] [--geometry]
+// converts every '<name>' / '<name>_depth' image pair of the directory (bin/data by default) in parallel.
+// Likewise the spectrum envelope (.dpe, see core/Audio.h) of the soundtrack, or of another WAV:
+//   DepthPainter --envelope [track.wav]
+
+// Decodes an example pair: RGB pixels, and the depth (8 or 16 bits, float) as 16 bits upsampled to the colour image
+bool decodeExample(const string & image_path, const string & depth_path, ofPixels & image, Buffer<uint16_t> & depth);
+// Precomputed canvas of an example pair, with the geometry of the initial camera if asked
+bool convertExample(const string & image_path, const string & depth_path, bool geometry);
+size_t convertDirectory(const string & directory, bool geometry);
+string canvasPath(const string & image_path);
+bool convertSoundtrack(const string & track_path);
+string envelopePath(const string & track_path);
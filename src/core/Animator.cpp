@@ -0,0 +1,316 @@
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include "Animator.h"
+#include "Parallel.h"
+#include "Settings.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// ms since 'start', which moves to now
+static double lap(Clock::time_point & start)
+{
+    Clock::time_point now = Clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - start).count();
+    start = now;
+    return ms;
+}
+
+//--------------------------------------------------------------
+void Animator::reset()
+{
+    wave_effect.reset();
+    flattening_effect.reset();
+    inclusion_effect.reset();
+    noise_effect.reset();
+    flattening = 0;
+    bNoiseDisplaced = false;
+    synapses.clear();
+    inclusion.revision = 0;
+    timing = Timing();
+}
+bool Animator::idle() const
+{
+    return wave_effect.idle() && flattening_effect.idle() && inclusion_effect.idle() && noise_effect.idle() && synapses.empty()
+        && ! restrengthened();
+}
+int Animator::restrengthened() const
+{
+    // The wave and the noise read their strength on every frame they run, and leave nothing at rest
+    int effects = 0;
+    if ( strengths.flattening != applied.flattening && flattening > 0 )            effects |= EFFECT_FLATTENING;
+    if ( strengths.inclusion != applied.inclusion && inclusion_effect.level > 0 )  effects |= EFFECT_INCLUSION;
+    return effects;
+}
+void Animator::simulate(const Canvas & canvas, double now)
+{
+    Effect * effects[] = { &wave_effect, &flattening_effect, &inclusion_effect, &noise_effect };
+    const int bits[] = { EFFECT_WAVE, EFFECT_FLATTENING, EFFECT_INCLUSION, EFFECT_NOISE };
+    running = 0;
+    for ( int e = 0; e < 4; ++e ) if ( ! effects[e]->idle() ) running |= bits[e];
+    
+    steps = clock.advance(now);
+    for ( size_t s = 0; s < steps; ++s )
+    {
+        for ( Effect * effect : effects ) effect->advance(SIMULATION_STEP);
+        grains += synapses.step(canvas);
+        if ( ! inclusion_effect.idle() && random.uf() < INCLUSION_SOUND_DENSITY ) ++grains;
+    }
+    for ( int e = 0; e < 4; ++e ) if ( ! effects[e]->idle() ) running |= bits[e];
+    flattening = flattening_effect.level * flattening_effect.level;
+    running |= restrengthened();
+    applied = strengths;
+}
+void Animator::update(Canvas & canvas, double now, float intensity)
+{
+    Clock::time_point start = Clock::now();
+    synapses.restore(canvas);
+    simulate(canvas, now);
+    timing.synapses = lap(start);
+    
+    int effects = 0;
+    if ( prepareWave(canvas) )                       effects |= EFFECT_WAVE;
+    if ( bProfile ) compose(canvas, effects & EFFECT_WAVE);
+    timing.wave = lap(start);
+    if ( prepareFlattening(canvas) )                 effects |= EFFECT_FLATTENING;
+    if ( bProfile ) compose(canvas, effects & EFFECT_FLATTENING);
+    timing.flattening = lap(start);
+    if ( prepareInclusion(canvas) )                  effects |= EFFECT_INCLUSION;
+    if ( bProfile ) compose(canvas, effects & EFFECT_INCLUSION);
+    timing.inclusion = lap(start);
+    if ( prepareNoise(canvas, now, intensity) )      effects |= EFFECT_NOISE;
+    if ( bProfile ) compose(canvas, effects & EFFECT_NOISE);
+    timing.noise = lap(start);
+    if ( ! bProfile ) compose(canvas, effects);
+    timing.compose = lap(start);
+    
+    // Synapses light up the composed canvas
+    synapses.discharge(canvas, now * 1E-3);
+    timing.synapses += lap(start);
+}
+//--------------------------------------------------------------
+// Per vertex, the effects are applied in the order of the original update: the global discharge wave jitters the
+// rest vertex, flattening pulls its depth towards the middle plane, noise displaces that depth and inclusion cuts
+// the alpha by rest depth. Instantiated for every set of effects, so idle ones are compiled out of the loop.
+template<int effects>
+void Animator::composeRows(Canvas & canvas, size_t begin, size_t end) const
+{
+    const bool bWave = effects & EFFECT_WAVE;
+    const bool bFlattening = effects & EFFECT_FLATTENING;
+    const bool bInclusion = effects & EFFECT_INCLUSION;
+    const bool bNoise = effects & EFFECT_NOISE;
+    
+    static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must be packed");
+    const bool sparse = canvas.decimated();
+    const uint4 wave_key(wave.key), lanes(0, 1, 2, 3);
+    for ( size_t y = begin; y < end; ++y )
+    {
+        // Vertexes of the pixel row: all of them on the full grid, a subset once decimated
+        const size_t row = y * canvas.width;
+        const size_t first = canvas.rowBegin(y), count = canvas.rowBegin(y + 1) - first;
+        const float * rest = &(canvas.vertexes.data() + first)->x;
+        float * animated = &(canvas.animated_vertexes.data() + first)->x;
+        Color * colors = canvas.animated_colors.data() + first;
+        const uint32_t * pixels = sparse ? canvas.lod.pixels.data() + first : nullptr;
+        const float * N = bNoise ? displacement.row(y) : nullptr;
+        
+        // 4 vertexes (12 floats) at a time
+        size_t i = 0;
+        for ( ; i + 4 <= count; i += 4 )
+        {
+            const float * r = rest + 3 * i;
+            float * a = animated + 3 * i;
+            const float4 rest_z(r[2], r[5], r[8], r[11]);
+            if ( bWave )
+            {
+                // Jitter growing away from the travelling plane; component c of vertex v draws hashf(key, 3 v + c)
+                float4 phase = float4(1.5f) - abs(rest_z - float4(wave.z)) * float4(wave.inv_thickness);
+                float4 phase2 = phase * phase;
+                float s[4];
+                ((float4(1.f) - phase2 * phase2 * phase2) * float4(wave.strength)).store(s);
+                uint4 counter = uint4((uint32_t) (3 * (first + i))) + lanes;
+                (float4::load(r)     + float4(s[0], s[0], s[0], s[1]) * Random::hashf(wave_key, counter)).store(a);
+                (float4::load(r + 4) + float4(s[1], s[1], s[2], s[2]) * Random::hashf(wave_key, counter + uint4(4))).store(a + 4);
+                (float4::load(r + 8) + float4(s[2], s[3], s[3], s[3]) * Random::hashf(wave_key, counter + uint4(8))).store(a + 8);
+            }
+            if ( bFlattening || bNoise )
+            {
+                // From the rest depth, or from the wave of this frame: never from an earlier frame
+                const float4 from = bFlattening || ! bWave ? rest_z : float4(a[2], a[5], a[8], a[11]);
+                float4 z = float4(flat.amount) * float4(flat.middle) + float4(1 - flat.amount) * from;
+                if ( bNoise )
+                {
+                    size_t x = row + i;
+                    uint4 p = sparse ? uint4(pixels[i], pixels[i + 1], pixels[i + 2], pixels[i + 3]) : uint4((uint32_t) x) + lanes;
+                    float4 n = sparse ? float4(displacement.at(N, pixels[i] - row),     displacement.at(N, pixels[i + 1] - row),
+                                               displacement.at(N, pixels[i + 2] - row), displacement.at(N, pixels[i + 3] - row))
+                                      : float4(displacement.at(N, i),     displacement.at(N, i + 1),
+                                               displacement.at(N, i + 2), displacement.at(N, i + 3));
+                    z = displacement.displace(n, p, rest_z, z);
+                }
+                float zs[4];
+                z.store(zs);
+                a[2] = zs[0]; a[5] = zs[1]; a[8] = zs[2]; a[11] = zs[3];
+            }
+            if ( bInclusion )
+                for ( int k = 0; k < 4; ++k ) colors[i + k].a = r[3 * k + 2] > inclusion.cut ? 1.f : 0.f;
+        }
+        for ( ; i < count; ++i )
+        {
+            const float * r = rest + 3 * i;
+            float * a = animated + 3 * i;
+            if ( bWave )
+            {
+                float phase = 1.5f - std::abs(r[2] - wave.z) * wave.inv_thickness;
+                float phase2 = phase * phase;
+                float s = (1 - phase2 * phase2 * phase2) * wave.strength;
+                uint32_t counter = 3 * (first + i);
+                for ( int c = 0; c < 3; ++c ) a[c] = r[c] + s * Random::hashf(wave.key, counter + c);
+            }
+            if ( bFlattening || bNoise ) a[2] = flat.amount * flat.middle + (1 - flat.amount) * (bFlattening || ! bWave ? r[2] : a[2]);
+            if ( bNoise )
+            {
+                size_t p = sparse ? pixels[i] : row + i;
+                a[2] = displacement.displace(displacement.at(N, p - row), p, r[2], a[2]);
+            }
+            if ( bInclusion )  colors[i].a = r[2] > inclusion.cut ? 1.f : 0.f;
+        }
+    }
+}
+void Animator::compose(Canvas & canvas, int effects) const
+{
+    if ( ! effects || ! canvas.size() ) return;
+    
+    typedef void (Animator::*Kernel)(Canvas &, size_t, size_t) const;
+    static const Kernel kernels[16] = {
+        &Animator::composeRows<0>,  &Animator::composeRows<1>,  &Animator::composeRows<2>,  &Animator::composeRows<3>,
+        &Animator::composeRows<4>,  &Animator::composeRows<5>,  &Animator::composeRows<6>,  &Animator::composeRows<7>,
+        &Animator::composeRows<8>,  &Animator::composeRows<9>,  &Animator::composeRows<10>, &Animator::composeRows<11>,
+        &Animator::composeRows<12>, &Animator::composeRows<13>, &Animator::composeRows<14>, &Animator::composeRows<15>
+    };
+    Kernel kernel = kernels[effects];
+    parallelFor(canvas.height, [&](size_t begin, size_t end) { (this->*kernel)(canvas, begin, end); });
+}
+//--------------------------------------------------------------
+void Animator::fireSynapses(const Canvas & canvas)
+{
+    float mFirings = canvas.width * canvas.height * SYNAP_DISCHARGE_DENSITY;
+    nFirings = random.range(mFirings * 0.3, mFirings * 2.f);
+    for (size_t n = 0; n < nFirings; ++n)
+    {
+        int pos = canvas.pixelOf( std::round( random.range(canvas.size() - 1) ) );
+        size_t nLocalFirings = std::round(random.range(SYNAP_LOCAL_MIN_NUMBER-0.5, SYNAP_LOCAL_MAX_NUMBER+0.5));
+        for (size_t t = 0; t < nLocalFirings; ++t)
+            synapses.fire(pos, random.next());
+    }
+    global_discharge_strengh = random.range(0.01, SYNAP_DISCHARGE_STRENGH);
+    wave_effect.fire();
+    nFirings = synapses.size();
+}
+// Canvas: global perturbation, a wave travelling from the back to the front plane
+bool Animator::prepareWave(const Canvas & canvas)
+{
+    if ( ! (running & EFFECT_WAVE) ) return false;
+    float thickness = canvas.limits.far.z - canvas.limits.near.z;
+    wave.z = canvas.limits.far.z - thickness * wave_effect.level;
+    wave.inv_thickness = 1.f / thickness;
+    wave.strength = global_discharge_strengh * strengths.synapses;
+    wave.key = random.next();
+    return true;
+}
+void Animator::updateSynapses(Canvas & canvas, double now)
+{
+    synapses.restore(canvas);
+    simulate(canvas, now);
+    if ( prepareWave(canvas) ) compose(canvas, EFFECT_WAVE);
+    synapses.discharge(canvas, now * 1E-3);
+}
+//--------------------------------------------------------------
+void Animator::fireFlattening()
+{
+    flattening_effect.fire();
+}
+bool Animator::prepareFlattening(const Canvas & canvas)
+{
+    if ( ! (running & EFFECT_FLATTENING) ) return false;
+    flat.amount = flattened();
+    flat.middle = (canvas.limits.far.z - canvas.limits.near.z) * 0.5 + canvas.limits.near.z;
+    return true;
+}
+void Animator::updateFlattening(Canvas & canvas, double now)
+{
+    simulate(canvas, now);
+    if ( prepareFlattening(canvas) ) compose(canvas, EFFECT_FLATTENING);
+}
+//--------------------------------------------------------------
+void Animator::fireInclusion()
+{
+    inclusion_effect.fire();
+    inclusion.revision = 0;
+}
+bool Animator::prepareInclusion(Canvas & canvas)
+{
+    if ( ! (running & EFFECT_INCLUSION) ) return false;
+    inclusion.cut = (canvas.limits.far.z - canvas.limits.near.z + 4) * inclusion_effect.level * strengths.inclusion + canvas.limits.near.z - 2;
+    
+    bool full = inclusion.revision != canvas.revision;
+    if ( ! full )
+    {
+        // Only vertexes between both cuts change side
+        const Canvas::DepthIndex & index = canvas.depthIndex();
+        size_t first = index.first(std::min(inclusion.applied_cut, inclusion.cut));
+        size_t last  = index.last(std::max(inclusion.applied_cut, inclusion.cut));
+        const uint32_t * order = index.order.data() + first;
+        const float cut = inclusion.cut;
+        parallelFor(last - first, [&](size_t begin, size_t end) {
+            for ( size_t i = begin; i < end; ++i )
+            {
+                uint32_t pos = order[i];
+                canvas.animated_colors[pos].a = canvas.vertexes[pos].z > cut ? 1.f : 0.f;
+            }
+        });
+    }
+    inclusion.applied_cut = inclusion.cut;
+    inclusion.revision = canvas.revision;
+    return full;
+}
+void Animator::updateInclusion(Canvas & canvas, double now)
+{
+    simulate(canvas, now);
+    if ( prepareInclusion(canvas) ) compose(canvas, EFFECT_INCLUSION);
+}
+//--------------------------------------------------------------
+void Animator::fireNoise()
+{
+    noise_effect.fire();
+}
+bool Animator::prepareNoise(const Canvas & canvas, double now, float intensity)
+{
+    if ( ! (running & EFFECT_NOISE) ) { bNoiseDisplaced = false; return false; }
+    
+    NoiseDisplacement::Params params;
+    params.time = now * 1E-3;
+    params.speed = NOISE_SPEED;
+    params.intensity = intensity;
+    params.amount = noise_effect.level * strengths.noise;
+    params.flattening = flattened();
+    params.sampling = NOISE_SAMPLING;
+    params.key = random.next();
+    
+    // Without flattening the noise moves nothing: idle, after one frame back at rest if it displaced the last one
+    bool displaced = NoiseDisplacement::depthScale(params) > 0;
+    bool settle = bNoiseDisplaced && ! displaced;
+    bNoiseDisplaced = displaced;
+    if ( ! displaced && ! settle ) return false;
+    
+    // Displaced from the flattened rest depth, also with the flattening at rest
+    flat.amount = flattened();
+    flat.middle = (canvas.limits.far.z - canvas.limits.near.z) * 0.5 + canvas.limits.near.z;
+    displacement.prepare(canvas, params);
+    return true;
+}
+void Animator::updateNoise(Canvas & canvas, double now, float intensity)
+{
+    simulate(canvas, now);
+    if ( prepareNoise(canvas, now, intensity) ) compose(canvas, EFFECT_NOISE);
+}
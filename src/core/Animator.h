@@ -0,0 +1,128 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include "Canvas.h"
+#include "Displacement.h"
+#include "Effect.h"
+#include "Synapse.h"
+#include "Random.h"
+#include "Settings.h"
+
+// Canvas animations (synapses, flattening, inclusion and noise), driven by an external clock in ms.
+// Sound is left to the caller: each effect only counts the grains it would like to play.
+// The effects live on a fixed-step simulation clock: every update first runs the steps due (effect levels,
+// synapse moves), then update() composes every effect running in them in a single parallel pass over the canvas,
+// while the update*() methods run one effect on its own. Idle effects cost nothing.
+
+class Animator
+{
+public:
+    
+    void reset();
+    void update(Canvas & canvas, double now, float intensity);
+    
+    void fireSynapses(const Canvas & canvas);
+    void fireFlattening();
+    void fireInclusion();
+    void fireNoise();
+    void updateSynapses(Canvas & canvas, double now);
+    void updateFlattening(Canvas & canvas, double now);
+    void updateInclusion(Canvas & canvas, double now);
+    void updateNoise(Canvas & canvas, double now, float intensity);
+    
+    size_t takeGrains() { size_t g = grains; grains = 0; return g; }
+    // No effect running, no synapse alive and no strength changed: update() would leave the canvas as it is
+    bool idle() const;
+    // Depth flattening of the composed canvas, its strength included
+    float flattened() const { return flattening * strengths.flattening; }
+    
+    // Last update() cost per effect, in ms. Fused updates only split the setup of each effect from
+    // the shared pass ('compose'); with bProfile every effect runs and is timed as a pass of its own.
+    struct Timing {
+        double synapses = 0, wave = 0, flattening = 0, inclusion = 0, noise = 0, compose = 0;
+        double total() const { return synapses + wave + flattening + inclusion + noise + compose; }
+    } timing;
+    bool bProfile = false;
+    
+    // Show control of every effect, [0,1], 1 as designed: scales the synapse discharge wave, the flattening, how far
+    // the inclusion cut goes and the noise displacement. Kept by reset(); a change lands on the next update() even
+    // with its effect at rest.
+    struct Strengths {
+        float synapses = 1, flattening = 1, inclusion = 1, noise = 1;
+    } strengths;
+    
+    Random random;
+    SynapsePool synapses;
+    NoiseDisplacement displacement;
+    bool bNoiseDisplaced = false;   // last composed frame moved vertexes by the noise
+    float global_discharge_strengh = 0;
+    float flattening = 0;           // level of the flattening effect, before its strength
+    size_t nFirings = 0;
+    
+    SimulationClock clock;
+    Effect wave_effect { Effect::PULSE, SYNAP_DISCHARGE_TIME };
+    Effect flattening_effect { Effect::TOGGLE, FLATTENING_TIME };
+    Effect inclusion_effect { Effect::TOGGLE, INCLUSION_TIME, true };
+    Effect noise_effect { Effect::SUSTAIN, NOISE_INCREASE_TIME };
+    size_t steps = 0;               // of the last update
+    
+private:
+    
+    // Runs the steps due by 'now', and notes in 'running' the effects that were not idle at some point of them
+    void simulate(const Canvas & canvas, double now);
+    // Effects at rest to compose again, their strength changed since the last update
+    int restrengthened() const;
+    bool prepareWave(const Canvas & canvas);
+    bool prepareFlattening(const Canvas & canvas);
+    // Incremental while the canvas is unchanged (only vertexes between last and current cut), true when a full pass is needed
+    bool prepareInclusion(Canvas & canvas);
+    bool prepareNoise(const Canvas & canvas, double now, float intensity);
+    // One row-parallel pass applying the EFFECT_* set in 'effects'
+    void compose(Canvas & canvas, int effects) const;
+    template<int effects> void composeRows(Canvas & canvas, size_t begin, size_t end) const;
+    
+    // Per-frame state of the dense effects, set by the prepare*() methods
+    struct Wave {
+        float z = 0, inv_thickness = 0, strength = 0;
+        uint32_t key = 0;
+    };
+    struct Flattening {
+        float amount = 0, middle = 0;
+    };
+    struct Inclusion {
+        float cut = 0;
+        float applied_cut = 0;
+        size_t revision = 0;        // canvas revision 'applied_cut' was swept on, 0 for none
+    };
+    enum { EFFECT_WAVE = 1, EFFECT_FLATTENING = 2, EFFECT_INCLUSION = 4, EFFECT_NOISE = 8 };
+    
+    Wave wave;
+    Flattening flat;
+    Inclusion inclusion;
+    Strengths applied;              // of the last update
+    size_t grains = 0;
+    int running = 0;                // EFFECT_* set
+};
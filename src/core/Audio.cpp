@@ -0,0 +1,383 @@
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include "Audio.h"
+#include "Parallel.h"
+
+//--------------------------------------------------------------
+static uint32_t readLe(const unsigned char * p, int bytes)
+{
+    uint32_t v = 0;
+    for ( int b = bytes - 1; b >= 0; --b ) v = (v << 8) | p[b];
+    return v;
+}
+bool Pcm::loadWav(const std::string & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if ( ! file ) return false;
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if ( bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) || std::memcmp(bytes.data() + 8, "WAVE", 4) ) return false;
+    
+    // Chunks: the format, then the samples
+    int format = 0, channels = 0, bits = 0;
+    for ( size_t at = 12; at + 8 <= bytes.size(); )
+    {
+        const unsigned char * chunk = bytes.data() + at;
+        size_t size = std::min((size_t) readLe(chunk + 4, 4), bytes.size() - at - 8);
+        if ( ! std::memcmp(chunk, "fmt ", 4) && size >= 16 )
+        {
+            format = readLe(chunk + 8, 2);
+            channels = readLe(chunk + 10, 2);
+            rate = readLe(chunk + 12, 4);
+            bits = readLe(chunk + 22, 2);
+            if ( format == 0xFFFE && size >= 40 ) format = readLe(chunk + 32, 2);     // extensible: the subformat
+        }
+        else if ( ! std::memcmp(chunk, "data", 4) )
+        {
+            bool integer = format == 1 && (bits == 16 || bits == 24 || bits == 32);
+            bool floating = format == 3 && bits == 32;
+            if ( ! channels || ! rate || ( ! integer && ! floating ) ) return false;
+            
+            const unsigned char * data = chunk + 8;
+            size_t width = bits / 8, count = size / (width * channels);
+            samples.resize(count);
+            const float scale = 1.f / (channels * (float) (1u << (bits - 1)));
+            parallelFor(count, [&](size_t begin, size_t end) {
+                for ( size_t s = begin; s < end; ++s )
+                {
+                    float sum = 0;
+                    for ( int c = 0; c < channels; ++c )
+                    {
+                        const unsigned char * p = data + (s * channels + c) * width;
+                        if ( floating ) { float f; std::memcpy(&f, p, 4); sum += f; continue; }
+                        int32_t v = (int32_t) (readLe(p, width) << (32 - bits)) >> (32 - bits);
+                        sum += v;
+                    }
+                    samples[s] = floating ? sum / channels : sum * scale;
+                }
+            });
+            return true;
+        }
+        at += 8 + size + (size & 1);
+    }
+    return false;
+}
+static void writeLe(unsigned char * p, uint32_t v, int bytes)
+{
+    for ( int b = 0; b < bytes; ++b, v >>= 8 ) p[b] = v & 0xFF;
+}
+bool Pcm::writeWav(const std::string & path, const float * samples, size_t frames, int channels, int rate)
+{
+    FILE * file = std::fopen(path.c_str(), "wb");
+    if ( ! file ) return false;
+    size_t count = frames * channels;
+    unsigned char header[44];
+    std::memcpy(header, "RIFF", 4);
+    writeLe(header + 4, 36 + count * 2, 4);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    writeLe(header + 16, 16, 4);
+    writeLe(header + 20, 1, 2);
+    writeLe(header + 22, channels, 2);
+    writeLe(header + 24, rate, 4);
+    writeLe(header + 28, rate * channels * 2, 4);
+    writeLe(header + 32, channels * 2, 2);
+    writeLe(header + 34, 16, 2);
+    std::memcpy(header + 36, "data", 4);
+    writeLe(header + 40, count * 2, 4);
+    std::vector<unsigned char> data(count * 2);
+    parallelFor(count, [&](size_t begin, size_t end) {
+        for ( size_t s = begin; s < end; ++s )
+        {
+            float v = std::min(std::max(samples[s], -1.f), 1.f);
+            writeLe(&data[2 * s], (uint16_t) (int16_t) std::lrint(v * 32767), 2);
+        }
+    });
+    bool ok = std::fwrite(header, sizeof(header), 1, file) == 1 && std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
+//--------------------------------------------------------------
+// Hann window, twiddles and bit reversal of the radix-2 FFT
+struct FftTables {
+    float window[Spectrum::SIZE];
+    float normalization;
+    std::complex<float> twiddles[Spectrum::SIZE / 2];
+    uint32_t reversed[Spectrum::SIZE];
+    
+    FftTables()
+    {
+        const size_t n = Spectrum::SIZE;
+        double sum = 0;
+        for ( size_t i = 0; i < n; ++i )
+        {
+            window[i] = 0.5 - 0.5 * std::cos(2 * M_PI * i / n);
+            sum += window[i];
+        }
+        normalization = 2 / sum;
+        for ( size_t i = 0; i < n / 2; ++i ) twiddles[i] = std::polar(1.0, -2 * M_PI * i / n);
+        int bits = 0;
+        while ( ((size_t) 1 << bits) < n ) ++bits;
+        for ( size_t i = 0; i < n; ++i )
+        {
+            uint32_t r = 0;
+            for ( int b = 0; b < bits; ++b ) r |= ((i >> b) & 1) << (bits - 1 - b);
+            reversed[i] = r;
+        }
+    }
+};
+static const FftTables & fftTables()
+{
+    static const FftTables tables;
+    return tables;
+}
+void Spectrum::analyze(const Pcm & pcm, size_t end, SpectrumFrame & frame)
+{
+    const FftTables & t = fftTables();
+    std::complex<float> x[SIZE];
+    for ( size_t i = 0; i < SIZE; ++i )
+    {
+        size_t s = end + i;             // 'end' - SIZE + i, shifted to stay unsigned
+        float v = s >= SIZE && s - SIZE < pcm.samples.size() ? pcm.samples[s - SIZE] : 0;
+        x[t.reversed[i]] = v * t.window[i];
+    }
+    for ( size_t length = 2; length <= SIZE; length <<= 1 )
+    {
+        size_t half = length / 2, stride = SIZE / length;
+        for ( size_t start = 0; start < SIZE; start += length )
+        {
+            for ( size_t k = 0; k < half; ++k )
+            {
+                std::complex<float> odd = t.twiddles[k * stride] * x[start + k + half];
+                x[start + k + half] = x[start + k] - odd;
+                x[start + k] += odd;
+            }
+        }
+    }
+    
+    // Linear bands over the bins up to the Nyquist frequency, the peak of each: what a coarser FFT would get
+    const size_t bins = SIZE / 2 / SPECTRUM_BANDS;
+    frame.energy = 0;
+    for ( size_t b = 0; b < SPECTRUM_BANDS; ++b )
+    {
+        float peak = 0;
+        for ( size_t k = b * bins; k < (b + 1) * bins; ++k ) peak = std::max(peak, std::norm(x[k]));
+        frame.bands[b] = std::sqrt(peak) * t.normalization;
+        frame.energy += frame.bands[b];
+    }
+    frame.time = pcm.rate ? end / (double) pcm.rate : 0;
+}
+//--------------------------------------------------------------
+void OnsetDetector::detect(SpectrumFrame & frame)
+{
+    float flux = 0;
+    if ( bPrevious )
+        for ( size_t b = 0; b < SPECTRUM_BANDS; ++b ) flux += std::max(0.f, frame.bands[b] - previous[b]);
+    std::copy(frame.bands, frame.bands + SPECTRUM_BANDS, previous);
+    bPrevious = true;
+    
+    frame.flux = flux;
+    frame.onset = history.size() == ONSET_HISTORY && quiet >= WINDOW && flux > 1E-4f && flux > ONSET_RATIO * sum / history.size();
+    quiet = frame.onset ? 0 : quiet + 1;
+    history.push_back(flux);
+    sum += flux;
+    if ( history.size() > ONSET_HISTORY )
+    {
+        sum -= history.front();
+        history.pop_front();
+    }
+}
+//--------------------------------------------------------------
+void SpectrumEnvelope::analyze(const Pcm & pcm)
+{
+    // Frames are independent, onsets follow them in order
+    size_t count = pcm.samples.size() / Spectrum::HOP + 1;
+    rate = pcm.rate / (double) Spectrum::HOP;
+    energies.resize(count);
+    fluxes.resize(count);
+    onset_flags.resize(count);
+    bands.resize(count * SPECTRUM_BANDS);
+    parallelFor(count, [&](size_t begin, size_t end) {
+        SpectrumFrame frame;
+        for ( size_t f = begin; f < end; ++f )
+        {
+            Spectrum::analyze(pcm, f * Spectrum::HOP, frame);
+            std::copy(frame.bands, frame.bands + SPECTRUM_BANDS, bands.data() + f * SPECTRUM_BANDS);
+            energies[f] = frame.energy;
+        }
+    }, 64);
+    OnsetDetector detector;
+    SpectrumFrame frame;
+    for ( size_t f = 0; f < count; ++f )
+    {
+        std::copy(bands.data() + f * SPECTRUM_BANDS, bands.data() + (f + 1) * SPECTRUM_BANDS, frame.bands);
+        detector.detect(frame);
+        fluxes[f] = frame.flux;
+        onset_flags[f] = frame.onset;
+    }
+    accumulate();
+}
+void SpectrumEnvelope::accumulate()
+{
+    sums.resize(frames() + 1);
+    onset_counts.resize(frames() + 1);
+    sums[0] = 0;
+    onset_counts[0] = 0;
+    for ( size_t f = 0; f < frames(); ++f )
+    {
+        sums[f + 1] = sums[f] + energies[f];
+        onset_counts[f + 1] = onset_counts[f] + onset_flags[f];
+    }
+}
+bool SpectrumEnvelope::write(const std::string & path) const
+{
+    FILE * file = std::fopen(path.c_str(), "wb");
+    if ( ! file ) return false;
+    Header header;
+    std::memcpy(header.magic, "DPSE", 4);
+    header.version = VERSION;
+    header.bands = SPECTRUM_BANDS;
+    header.frames = frames();
+    header.rate = rate;
+    const uint32_t padding = 0;
+    size_t padded = (4 - frames() % 4) % 4;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+           && std::fwrite(energies.data(), 4, frames(), file) == frames()
+           && std::fwrite(fluxes.data(), 4, frames(), file) == frames()
+           && std::fwrite(onset_flags.data(), 1, frames(), file) == frames()
+           && std::fwrite(&padding, 1, padded, file) == padded
+           && std::fwrite(bands.data(), 4, bands.size(), file) == bands.size();
+    return std::fclose(file) == 0 && ok;
+}
+bool SpectrumEnvelope::read(const std::string & path)
+{
+    FILE * file = std::fopen(path.c_str(), "rb");
+    if ( ! file ) return false;
+    Header header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && ! std::memcmp(header.magic, "DPSE", 4)
+           && header.version == VERSION && header.bands == SPECTRUM_BANDS && header.rate > 0;
+    if ( ok )
+    {
+        size_t count = header.frames, padded = (4 - count % 4) % 4;
+        uint32_t padding;
+        energies.resize(count);
+        fluxes.resize(count);
+        onset_flags.resize(count);
+        bands.resize(count * SPECTRUM_BANDS);
+        ok = std::fread(energies.data(), 4, count, file) == count
+          && std::fread(fluxes.data(), 4, count, file) == count
+          && std::fread(onset_flags.data(), 1, count, file) == count
+          && std::fread(&padding, 1, padded, file) == padded
+          && std::fread(bands.data(), 4, bands.size(), file) == bands.size();
+        rate = header.rate;
+    }
+    std::fclose(file);
+    if ( ! ok ) { energies.clear(); fluxes.clear(); onset_flags.clear(); bands.clear(); rate = 0; }
+    accumulate();
+    return ok;
+}
+bool SpectrumEnvelope::load(const std::string & path)
+{
+    std::string extension = path.size() > 4 ? path.substr(path.size() - 4) : "";
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if ( extension != ".wav" ) return read(path);
+    Pcm pcm;
+    if ( ! pcm.loadWav(path) ) return false;
+    analyze(pcm);
+    return true;
+}
+float SpectrumEnvelope::energy(double t) const
+{
+    double f = std::floor(t * rate);
+    return f >= 0 && f < frames() ? energies[(size_t) f] : 0;
+}
+float SpectrumEnvelope::smoothed(double t, double window) const
+{
+    // Frames in (t - window, t], none past the end
+    double last = std::min(std::floor(t * rate), frames() - 1.), first = std::max(std::floor((t - window) * rate), -1.);
+    if ( last <= first ) return 0;
+    return (sums[(size_t) last + 1] - sums[(size_t) (first + 1)]) / (last - first);
+}
+size_t SpectrumEnvelope::onsets(double t0, double t1) const
+{
+    auto index = [&](double t) { return (size_t) std::min(std::max(std::floor(t * rate) + 1, 0.), (double) frames()); };
+    size_t i0 = index(t0), i1 = index(t1);
+    return i1 > i0 ? onset_counts[i1] - onset_counts[i0] : 0;
+}
+//--------------------------------------------------------------
+void AudioAnalyzer::start(std::shared_ptr<const Pcm> track)
+{
+    stop();
+    pcm = track;
+    if ( ! pcm || ! pcm->rate ) return;
+    ring.clear();
+    recent.clear();
+    recent_sum = 0;
+    last = SpectrumFrame();
+    bStop = false;
+    worker = std::thread(&AudioAnalyzer::analyze, this);
+}
+void AudioAnalyzer::stop()
+{
+    bStop = true;
+    if ( worker.joinable() ) worker.join();
+}
+void AudioAnalyzer::sync(double seconds, bool playing)
+{
+    position = seconds;
+    synced = Clock::now().time_since_epoch().count();
+    bPlaying = playing;
+}
+bool AudioAnalyzer::poll()
+{
+    onsets = 0;
+    bool taken = false;
+    SpectrumFrame frame;
+    while ( ring.pop(frame) )
+    {
+        // A seek or a loop starts over
+        if ( ! recent.empty() && frame.time < recent.back().first ) { recent.clear(); recent_sum = 0; }
+        recent.emplace_back(frame.time, frame.energy);
+        recent_sum += frame.energy;
+        onsets += frame.onset;
+        last = frame;
+        taken = true;
+    }
+    while ( ! recent.empty() && recent.front().first <= last.time - SPECTRUM_DECAY )
+    {
+        recent_sum -= recent.front().second;
+        recent.pop_front();
+    }
+    return taken;
+}
+// Analysis thread: every frame up to the playback position, at half the hop period
+void AudioAnalyzer::analyze()
+{
+    const double hop = Spectrum::HOP / (double) pcm->rate;
+    const size_t catch_up = 8 * Spectrum::HOP;
+    OnsetDetector detector;
+    size_t next = 0;                    // end sample of the next frame
+    while ( ! bStop )
+    {
+        double seconds = position;
+        if ( bPlaying ) seconds += std::chrono::duration<double>(Clock::now().time_since_epoch() - Clock::duration(synced.load())).count();
+        size_t current = (size_t) std::max(0., seconds * pcm->rate);
+        
+        // Seeks restart the frames, and a late thread skips to the last ones rather than bursting
+        if ( current + 2 * Spectrum::HOP < next || current > next + catch_up )
+        {
+            next = (current > catch_up ? current - catch_up / 2 : 0) / Spectrum::HOP * Spectrum::HOP;
+            detector.reset();
+        }
+        for ( ; next <= current && next <= pcm->samples.size(); next += Spectrum::HOP )
+        {
+            SpectrumFrame frame;
+            Spectrum::analyze(*pcm, next, frame);
+            detector.detect(frame);
+            if ( ! ring.push(frame) ) ++lost;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(hop / 2));
+    }
+}
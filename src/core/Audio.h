@@ -0,0 +1,175 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include "Buffer.h"
+#include "Ring.h"
+#include "Settings.h"
+
+// Audio analysis of the soundtrack, decoded here rather than read back from the sound output: windowed FFT into
+// SPECTRUM_BANDS band magnitudes (the amplitude of a full scale sinusoid is 1), their sum as the energy, and onsets
+// where the spectral flux rises over its recent mean. AudioAnalyzer follows the playback live on a thread of its own;
+// SpectrumEnvelope analyzes a whole track at once, and keeps it in a file to be read back by deterministic runs.
+
+// Mono PCM, channels averaged
+struct Pcm
+{
+    int rate = 0;
+    Buffer<float> samples;
+    double duration() const { return rate ? samples.size() / (double) rate : 0; }
+    
+    // 16, 24 or 32 bit integer, or 32 bit float WAV
+    bool loadWav(const std::string & path);
+    
+    // 16 bit WAV of 'frames' interleaved samples, clamped to [-1,1]
+    static bool writeWav(const std::string & path, const float * samples, size_t frames, int channels, int rate);
+};
+
+struct SpectrumFrame
+{
+    double time = 0;                    // s in the track, end of the window
+    float bands[SPECTRUM_BANDS];
+    float energy = 0;                   // sum of the bands
+    float flux = 0;
+    bool onset = false;
+};
+
+class Spectrum
+{
+public:
+    
+    static const size_t SIZE = 2048;    // samples of the Hann window
+    static const size_t HOP = 512;      // between frames
+    
+    // Bands of the window ending at sample 'end' (silence before the track). Thread safe.
+    static void analyze(const Pcm & pcm, size_t end, SpectrumFrame & frame);
+};
+
+// Spectral flux: summed band increases, an onset when over ONSET_RATIO times their mean over ONSET_HISTORY frames,
+// and at least a window away from the previous one
+class OnsetDetector
+{
+public:
+    
+    void detect(SpectrumFrame & frame);
+    void reset() { bPrevious = false; history.clear(); sum = 0; quiet = WINDOW; }
+    
+private:
+    
+    static const size_t WINDOW = Spectrum::SIZE / Spectrum::HOP;
+    float previous[SPECTRUM_BANDS];
+    bool bPrevious = false;
+    size_t quiet = WINDOW;              // frames since the last onset
+    std::deque<float> history;
+    double sum = 0;
+};
+
+// Whole track, one frame every HOP samples
+//
+//  header      SpectrumEnvelope::Header
+//  energies    frames floats
+//  fluxes      frames floats
+//  onsets      frames bytes, 1 at an onset, padded to 4
+//  bands       frames x bands floats
+
+class SpectrumEnvelope
+{
+public:
+    
+    struct Header {
+        char magic[4];                  // "DPSE"
+        uint32_t version;
+        uint32_t bands, frames;
+        double rate;                    // frames per second
+    };
+    enum { VERSION = 1 };
+    
+    void analyze(const Pcm & pcm);
+    bool write(const std::string & path) const;
+    bool read(const std::string & path);
+    // An envelope file, or a WAV analyzed on the spot
+    bool load(const std::string & path);
+    
+    size_t frames() const { return energies.size(); }
+    double rate = 0;
+    // At a time of the track, in s: last frame energy, mean energy over the last 'window', onsets in (t0, t1]
+    float energy(double t) const;
+    float smoothed(double t, double window = SPECTRUM_DECAY) const;
+    size_t onsets(double t0, double t1) const;
+    
+    Buffer<float> energies, fluxes, bands;
+    Buffer<unsigned char> onset_flags;
+    
+private:
+    
+    void accumulate();
+    Buffer<double> sums;                // prefix sums of the energies
+    Buffer<uint32_t> onset_counts;      // prefix counts of the onsets
+};
+
+// Live analysis: a thread analyzes the frames of the playback position every hop, whatever the render frame rate,
+// and publishes them through a lock-free ring. The render thread only syncs the position and takes the frames.
+class AudioAnalyzer
+{
+public:
+    
+    ~AudioAnalyzer() { stop(); }
+    
+    void start(std::shared_ptr<const Pcm> pcm);
+    void stop();
+    bool running() const { return worker.joinable(); }
+    
+    // Render thread: playback position in s, extrapolated by the analysis thread in between
+    void sync(double seconds, bool playing);
+    // Render thread: takes the frames published since the last poll, false when there was none
+    bool poll();
+    const SpectrumFrame & latest() const { return last; }
+    size_t onsets = 0;                  // in the frames taken by the last poll
+    float smoothed() const { return recent.empty() ? 0 : recent_sum / recent.size(); }    // over SPECTRUM_DECAY s
+    size_t dropped() const { return lost; }
+    
+private:
+    
+    typedef std::chrono::steady_clock Clock;
+    
+    void analyze();
+    
+    std::shared_ptr<const Pcm> pcm;
+    SpscRing<SpectrumFrame> ring { 64 };
+    std::thread worker;
+    std::atomic<bool> bStop { false }, bPlaying { false };
+    std::atomic<double> position { 0 };
+    std::atomic<Clock::rep> synced { 0 };
+    std::atomic<size_t> lost { 0 };
+    
+    SpectrumFrame last;
+    std::deque<std::pair<double, float>> recent;
+    double recent_sum = 0;
+};
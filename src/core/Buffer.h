@@ -0,0 +1,108 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Flat array of plain values for the canvas storage.
+// Cache-line aligned, never value-initialized and never shrinks: resizing to a size that
+// fits the capacity costs nothing, so switching between examples of the same size reuses the memory.
+
+template<typename T>
+class Buffer
+{
+public:
+    
+    static_assert(std::is_trivially_copyable<T>::value, "Buffer only holds plain values");
+    
+    static const size_t alignment = 64;
+    
+    Buffer() {}
+    Buffer(const Buffer & b) { *this = b; }
+    Buffer & operator=(const Buffer & b)
+    {
+        if ( this == &b ) return *this;
+        resize(b.count);
+        if ( count ) std::memcpy(items, b.items, count * sizeof(T));
+        return *this;
+    }
+    Buffer(Buffer && b) { swap(b); }
+    Buffer & operator=(Buffer && b) { swap(b); return *this; }
+    ~Buffer() { std::free(block); }
+    
+    void swap(Buffer & b)
+    {
+        std::swap(block, b.block);
+        std::swap(items, b.items);
+        std::swap(count, b.count);
+        std::swap(reserved, b.reserved);
+    }
+    
+    void resize(size_t n)
+    {
+        if ( n > reserved ) reserve(n);
+        count = n;
+    }
+    void reserve(size_t n)
+    {
+        if ( n <= reserved ) return;
+        void * b = std::malloc(n * sizeof(T) + alignment);
+        if ( ! b ) throw std::bad_alloc();
+        T * aligned = (T *) (((uintptr_t) b + alignment - 1) & ~(uintptr_t) (alignment - 1));
+        if ( count ) std::memcpy(aligned, items, count * sizeof(T));
+        std::free(block);
+        block = b;
+        items = aligned;
+        reserved = n;
+    }
+    void clear() { count = 0; }
+    void release() { std::free(block); block = nullptr; items = nullptr; count = reserved = 0; }
+    
+    size_t size() const { return count; }
+    size_t capacity() const { return reserved; }
+    size_t bytes() const { return reserved * sizeof(T); }
+    bool empty() const { return ! count; }
+    
+    T * data() { return items; }
+    const T * data() const { return items; }
+    T & operator[](size_t i) { return items[i]; }
+    const T & operator[](size_t i) const { return items[i]; }
+    T * begin() { return items; }
+    T * end() { return items + count; }
+    const T * begin() const { return items; }
+    const T * end() const { return items + count; }
+    
+private:
+    
+    void * block = nullptr;
+    T * items = nullptr;
+    size_t count = 0, reserved = 0;
+};
@@ -0,0 +1,273 @@
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include "Canvas.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+// Depth range of a block of rows
+struct Range {
+    Vec3 far, near;
+    Range() : far(0, 0, -INFINITY), near(0, 0, INFINITY) {}
+    Range & operator+=(const Vec3 & v)
+    {
+        if ( v.z > far.z )  far = v;
+        if ( v.z < near.z ) near = v;
+        return *this;
+    }
+    Range & operator+=(const Range & r) { *this += r.far; *this += r.near; return *this; }
+};
+
+// Revisions are unique across canvases, so a swapped canvas is never mistaken for another one
+static std::atomic<size_t> revisions(1);
+
+//--------------------------------------------------------------
+void Canvas::touch()
+{
+    revision = ++revisions;
+}
+void Canvas::load(const unsigned char * image, const unsigned char * depth, int depth_channels, bool show_depth)
+{
+    loadDepth(image, [=](size_t pos) { return (float) depth[pos * depth_channels]; }, show_depth);
+}
+void Canvas::load(const unsigned char * image, const uint16_t * depth, bool show_depth)
+{
+    loadDepth(image, [=](size_t pos) { return depth[pos] * (1.f / 257); }, show_depth);
+}
+template<typename Raw>
+void Canvas::loadDepth(const unsigned char * image, const Raw & raw, bool show_depth)
+{
+    // Only a bigger canvas than any seen before reallocates
+    size_t n = (size_t) width * height;
+    depths.resize(n);
+    bDecimated = lod_tolerance > 0;
+    if ( bDecimated )
+    {
+        // Depth first, it decides which pixels become vertexes
+        parallelFor(n, [&](size_t begin, size_t end) {
+            for ( size_t pos = begin; pos < end; ++pos ) depths[pos] = 255 - raw(pos);
+        });
+        lod.build(depths.data(), width, height, lod_tolerance);
+        topology = lod.topology;
+        n = lod.size();
+    }
+    vertexes.resize(n);
+    colors.resize(n);
+    animated_vertexes.resize(n);
+    animated_colors.resize(n);
+    
+    parallelFor(n, [&](size_t begin, size_t end) {
+        for ( size_t v = begin; v < end; ++v )
+        {
+            size_t pos = pixelOf(v);
+            const unsigned char * rgb = image + pos * 3;
+            float d = raw(pos);
+            if ( ! bDecimated ) depths[pos] = 255 - d;
+            unsigned char grey = d + 0.5f;
+            Color8 c = show_depth ? Color8{ grey, grey, grey, 255 } : Color8{ rgb[0], rgb[1], rgb[2], 255 };
+            colors[v] = c;
+            animated_colors[v] = c;
+        }
+    });
+    touch();
+}
+void Canvas::buildRays(float focal)
+{
+    size_t n = (size_t) width * height;
+    ray_inverses.resize(n);
+    ray_offsets.resize(n);
+    
+    const double cx = width * 0.5, cy = height * 0.5, f = focal;
+    parallelFor(height, [&](size_t begin, size_t end) {
+        for ( size_t y = begin; y < end; ++y )
+        {
+            double h = y - cy;
+            for ( int x = 0; x < width; ++x )
+            {
+                double w = x - cx;
+                double inv = 1 / std::sqrt(w * w + h * h + f * f);
+                ray_inverses[x + y * width] = inv;
+                ray_offsets[x + y * width] = f * (f * inv - 1);
+            }
+        }
+    });
+    
+    ray_width = width;
+    ray_height = height;
+    ray_focal = focal;
+}
+//--------------------------------------------------------------
+// Extrudes one row along its rays, into the rest and animated buffers.
+// With t = depth / norm and k = 1 + t * extrusion, the vertex is (w k, h k, offset - focal t extrusion).
+static void projectRow(Canvas & canvas, int y, float focal, float extrusion, Range & range)
+{
+    const int width = canvas.width;
+    const float cx = width * 0.5;
+    const size_t row = (size_t) y * width;
+    const float * depths = canvas.depths.data() + row;
+    const float * inverses = canvas.ray_inverses.data() + row;
+    const float * offsets = canvas.ray_offsets.data() + row;
+    Vec3 * vertexes = canvas.vertexes.data() + row;
+    Vec3 * animated_vertexes = canvas.animated_vertexes.data() + row;
+    
+    // 4 pixels at a time
+    const float h = y - canvas.height * 0.5;
+    const float fe = focal * extrusion;
+    const float4 ve(extrusion), vfe(fe), vh(h), one(1), lanes(0, 1, 2, 3);
+    int x = 0;
+    for ( ; x + 4 <= width; x += 4 )
+    {
+        float4 t = float4::load(depths + x) * float4::load(inverses + x);
+        float4 k = one + t * ve;
+        float px[4], py[4], pz[4];
+        ((float4(x - cx) + lanes) * k).store(px);
+        (vh * k).store(py);
+        (float4::load(offsets + x) - vfe * t).store(pz);
+        for ( int i = 0; i < 4; ++i )
+        {
+            Vec3 v(px[i], py[i], pz[i]);
+            vertexes[x + i] = animated_vertexes[x + i] = v;
+            range += v;
+        }
+    }
+    for ( ; x < width; ++x )
+    {
+        float t = depths[x] * inverses[x];
+        float k = 1 + t * extrusion;
+        Vec3 v((x - cx) * k, h * k, offsets[x] - fe * t);
+        vertexes[x] = animated_vertexes[x] = v;
+        range += v;
+    }
+}
+// Same for the vertexes of a decimated canvas on one pixel row
+static void projectSparseRow(Canvas & canvas, int y, float focal, float extrusion, Range & range)
+{
+    const float cx = canvas.width * 0.5;
+    const size_t row = (size_t) y * canvas.width;
+    const float h = y - canvas.height * 0.5;
+    const float fe = focal * extrusion;
+    for ( size_t v = canvas.rowBegin(y); v < canvas.rowBegin(y + 1); ++v )
+    {
+        size_t pos = canvas.lod.pixels[v];
+        float t = canvas.depths[pos] * canvas.ray_inverses[pos];
+        float k = 1 + t * extrusion;
+        Vec3 p((pos - row - cx) * k, h * k, canvas.ray_offsets[pos] - fe * t);
+        canvas.vertexes[v] = canvas.animated_vertexes[v] = p;
+        range += p;
+    }
+}
+void Canvas::project(float focal, float extrusion)
+{
+    size_t n = (size_t) width * height;
+    if ( ! n || depths.size() != n ) { limits = Limits(); return; }
+    if ( ray_width != width || ray_height != height || ray_focal != focal ) buildRays(focal);
+    
+    Range range = parallelReduce(height, Range(),
+        [&](size_t begin, size_t end) {
+            Range r;
+            for ( size_t y = begin; y < end; ++y )
+            {
+                if ( bDecimated ) projectSparseRow(*this, y, focal, extrusion, r);
+                else              projectRow(*this, y, focal, extrusion, r);
+            }
+            return r;
+        },
+        [](Range a, const Range & b) { return a += b; });
+    
+    limits.far  = range.far;
+    limits.near = range.near;
+    touch();
+}
+void Canvas::setGeometry(const Vec3 * rest, const Limits & l)
+{
+    parallelFor(size(), [&](size_t begin, size_t end) {
+        for ( size_t pos = begin; pos < end; ++pos ) vertexes[pos] = animated_vertexes[pos] = rest[pos];
+    });
+    limits = l;
+    touch();
+}
+//--------------------------------------------------------------
+void Canvas::updateTopology()
+{
+    topology = bDecimated ? lod.topology : TopologyCache::get(width, height, render, strips);
+}
+void Canvas::restore()
+{
+    parallelFor(size(), [&](size_t begin, size_t end) {
+        for ( size_t pos = begin; pos < end; ++pos )
+        {
+            animated_vertexes[pos] = vertexes[pos];
+            animated_colors[pos] = colors[pos];
+        }
+    });
+    touch();
+}
+void Canvas::clear()
+{
+    vertexes.clear();
+    colors.clear();
+    animated_vertexes.clear();
+    animated_colors.clear();
+    topology.reset();
+    depths.clear();
+    depth_index.order.clear();
+    depth_buckets.clear();
+    lod.clear();
+    bDecimated = false;
+    touch();
+}
+size_t Canvas::bytes() const
+{
+    return vertexes.bytes() + colors.bytes() + animated_vertexes.bytes() + animated_colors.bytes()
+         + (topology ? topology->indices.bytes() : 0) + depths.bytes() + ray_inverses.bytes() + ray_offsets.bytes()
+         + depth_index.starts.bytes() + depth_index.order.bytes() + depth_buckets.bytes() + lod.bytes();
+}
+//--------------------------------------------------------------
+// Parallel counting sort of the rest vertexes by depth bucket: every chunk counts its buckets, then scatters
+// its vertexes in its own slice of each bucket, so the order inside a bucket is the memory order.
+const Canvas::DepthIndex & Canvas::depthIndex()
+{
+    DepthIndex & index = depth_index;
+    if ( index.revision == revision ) return index;
+    
+    const size_t n = size(), buckets = DepthIndex::buckets;
+    const float thickness = limits.far.z - limits.near.z;
+    index.near = limits.near.z;
+    index.scale = thickness > 0 ? buckets / thickness : 0;
+    index.starts.resize(buckets + 1);
+    index.order.resize(n);
+    depth_buckets.resize(n);
+    
+    Parallel & pool = Parallel::pool();
+    const size_t grain = pool.grain(n), chunks = pool.chunks(n, grain);
+    std::vector<uint32_t> counts(chunks * buckets, 0);
+    pool.run(n, grain, [&](size_t chunk, size_t begin, size_t end) {
+        uint32_t * count = counts.data() + chunk * buckets;
+        for ( size_t pos = begin; pos < end; ++pos )
+        {
+            size_t b = index.bucket(vertexes[pos].z);
+            depth_buckets[pos] = b;
+            ++count[b];
+        }
+    });
+    uint32_t offset = 0;
+    for ( size_t b = 0; b < buckets; ++b )
+    {
+        index.starts[b] = offset;
+        for ( size_t chunk = 0; chunk < chunks; ++chunk )
+        {
+            uint32_t & count = counts[chunk * buckets + b];
+            uint32_t c = count;
+            count = offset;
+            offset += c;
+        }
+    }
+    index.starts[buckets] = offset;
+    pool.run(n, grain, [&](size_t chunk, size_t begin, size_t end) {
+        uint32_t * cursor = counts.data() + chunk * buckets;
+        for ( size_t pos = begin; pos < end; ++pos ) index.order[cursor[depth_buckets[pos]]++] = pos;
+    });
+    
+    index.revision = revision;
+    return index;
+}
@@ -0,0 +1,120 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include "Buffer.h"
+#include "Lod.h"
+#include "Topology.h"
+#include "Vec.h"
+
+// Depth canvas: one vertex per source pixel, projected from the camera focal point.
+// 'vertexes' and 'colors' keep the rest state once (colours packed in 8 bits), the animated_* buffers
+// are what gets drawn. All buffers keep their capacity across loads.
+// load() decodes a new image/depth pair, project() only extrudes the cached depth along the cached rays.
+// With a level of detail tolerance, load() decimates the grid: vertexes are then a subset of the pixels, in raster order.
+
+class Canvas
+{
+public:
+    
+    void load(const unsigned char * image, const unsigned char * depth, int depth_channels, bool show_depth);
+    // 16-bit raw depth, as prepared by DepthUpsampler
+    void load(const unsigned char * image, const uint16_t * depth, bool show_depth);
+    void project(float focal, float extrusion);
+    void updateTopology();
+    void restore();
+    void clear();
+    size_t bytes() const;
+    size_t size() const { return vertexes.size(); }
+    
+    int width = 0, height = 0;
+    RenderMode render = RENDER_WIREFRAME;
+    bool strips = false;
+    float lod_tolerance = 0;        // depth variance merged into a single block, 0 for the full grid
+    struct Limits {
+        Vec3 far, near;
+    } limits;
+    // Takes rest vertexes projected beforehand (full grid only) instead of projecting
+    void setGeometry(const Vec3 * rest, const Limits & limits);
+    
+    // Vertex <-> pixel mapping
+    bool decimated() const { return bDecimated; }
+    size_t rowBegin(int y) const { return bDecimated ? lod.rows[y] : (size_t) y * width; }
+    size_t pixelOf(size_t vertex) const { return bDecimated ? lod.pixels[vertex] : vertex; }
+    int vertexAt(size_t pixel) const { return bDecimated ? lod.vertexAt(pixel) : (int) pixel; }
+    
+    Buffer<Vec3> vertexes;
+    Buffer<Color8> colors;
+    Buffer<Vec3> animated_vertexes;
+    Buffer<Color> animated_colors;
+    std::shared_ptr<const Topology> topology;
+    LodMesh lod;
+    
+    // Decoded depth (255 - raw value)
+    Buffer<float> depths;
+    
+    // Rest vertexes bucketed by depth, for the effects sweeping a depth plane. Built on demand, once per projection.
+    struct DepthIndex {
+        static const size_t buckets = 4096;
+        float near = 0, scale = 0;          // bucket of z: (z - near) * scale
+        Buffer<uint32_t> starts;            // first entry of every bucket in 'order', plus the end
+        Buffer<uint32_t> order;             // vertex indexes, bucket after bucket
+        size_t revision = 0;
+        
+        size_t bucket(float z) const
+        {
+            float b = (z - near) * scale;
+            if ( ! (b > 0) ) return 0;
+            return b < buckets - 1 ? (size_t) b : buckets - 1;
+        }
+        // Range of 'order' holding every vertex with a depth in [z0, z1]
+        size_t first(float z0) const { return starts[bucket(z0)]; }
+        size_t last(float z1) const  { return starts[bucket(z1) + 1]; }
+    };
+    const DepthIndex & depthIndex();
+    
+    // Renewed whenever the rest vertexes change or the animated buffers are reset
+    size_t revision = 1;
+    void touch();
+    
+    // Per-pixel ray table for the current size and focal. The unit ray of pixel (w,h) is (w, h, -focal) / norm,
+    // so only 1/norm and the z offset focal * (focal / norm - 1) need to be kept.
+    Buffer<float> ray_inverses, ray_offsets;
+    
+private:
+    
+    void buildRays(float focal);
+    // 'raw(pixel)' is the raw depth in 8-bit levels
+    template<typename Raw> void loadDepth(const unsigned char * image, const Raw & raw, bool show_depth);
+    
+    int ray_width = 0, ray_height = 0;
+    float ray_focal = 0;
+    
+    bool bDecimated = false;
+    DepthIndex depth_index;
+    Buffer<uint16_t> depth_buckets;
+};
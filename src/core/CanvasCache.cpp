@@ -0,0 +1,181 @@
+#include <algorithm>
+#include "CanvasCache.h"
+
+//--------------------------------------------------------------
+void CanvasCache::start(const Loader & l, size_t budget)
+{
+    stop();
+    loader = l;
+    counters.budget = budget;
+    bStop = false;
+    worker = std::thread(&CanvasCache::work, this);
+}
+void CanvasCache::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bStop = true;
+        queue.clear();
+    }
+    changed.notify_all();
+    if ( worker.joinable() ) worker.join();
+}
+void CanvasCache::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        failures.clear();
+        counters.entries = counters.bytes = 0;
+        ++generation;
+        // Keys waiting to be shown are prepared again, the one in flight included
+        for ( int key : requested )
+            if ( std::find(queue.begin(), queue.end(), key) == queue.end() ) queue.push_front(key);
+    }
+    changed.notify_all();
+}
+void CanvasCache::configure(const Settings & s)
+{
+    bool stale;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stale = s.lod_tolerance != settings.lod_tolerance || s.strips != settings.strips;
+        settings = s;
+    }
+    if ( stale ) clear();
+}
+//--------------------------------------------------------------
+std::list<CanvasCache::Entry>::iterator CanvasCache::find(int key)
+{
+    return std::find_if(entries.begin(), entries.end(), [key](const Entry & e) { return e.key == key; });
+}
+std::list<CanvasCache::Entry>::const_iterator CanvasCache::find(int key) const
+{
+    return std::find_if(entries.begin(), entries.end(), [key](const Entry & e) { return e.key == key; });
+}
+CanvasCache::State CanvasCache::lookup(int key) const
+{
+    if ( find(key) != entries.end() ) return READY;
+    if ( loading == key || std::find(queue.begin(), queue.end(), key) != queue.end() ) return QUEUED;
+    return failures.count(key) ? FAILED : ABSENT;
+}
+CanvasCache::State CanvasCache::state(int key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup(key);
+}
+CanvasCache::State CanvasCache::request(int key)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        State s = lookup(key);
+        if ( s == READY ) { ++counters.hits; return s; }
+        ++counters.misses;
+        if ( s == FAILED ) return s;
+        requested.insert(key);
+        if ( loading != key )
+        {
+            queue.erase(std::remove(queue.begin(), queue.end(), key), queue.end());
+            queue.push_front(key);
+        }
+    }
+    changed.notify_all();
+    return QUEUED;
+}
+void CanvasCache::prefetch(int key)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( lookup(key) != ABSENT ) return;
+        queue.push_back(key);
+    }
+    changed.notify_all();
+}
+//--------------------------------------------------------------
+bool CanvasCache::swap(int key, Canvas & canvas, Origin & origin, int previous)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto e = find(key);
+    if ( e == entries.end() ) return false;
+    
+    Entry entry = std::move(*e);
+    entries.erase(e);
+    counters.bytes -= entry.bytes;
+    --counters.entries;
+    requested.erase(key);
+    std::swap(canvas, entry.canvas);
+    std::swap(origin, entry.origin);
+    if ( previous < 0 || previous == key ) return true;
+    
+    // The canvas swapped out replaces any older entry of its key
+    auto old = find(previous);
+    if ( old != entries.end() )
+    {
+        counters.bytes -= old->bytes;
+        entries.erase(old);
+        --counters.entries;
+    }
+    entry.key = previous;
+    entry.bytes = entry.canvas.bytes();
+    insert(std::move(entry), true);
+    return true;
+}
+// Adds an entry, as the most or the least recent one, and evicts from the least recent end down to the budget.
+// The most recent entry is kept whatever its size.
+void CanvasCache::insert(Entry && entry, bool recent)
+{
+    counters.bytes += entry.bytes;
+    ++counters.entries;
+    if ( recent ) entries.push_front(std::move(entry));
+    else entries.push_back(std::move(entry));
+    while ( counters.bytes > counters.budget && entries.size() > 1 )
+    {
+        counters.bytes -= entries.back().bytes;
+        entries.pop_back();
+        --counters.entries;
+        ++counters.evicted;
+    }
+}
+CanvasCache::Stats CanvasCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+//--------------------------------------------------------------
+// Worker thread: prepares queued keys one at a time, outside the lock
+void CanvasCache::work()
+{
+    while ( true )
+    {
+        int key;
+        Settings s;
+        size_t g;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return bStop || ! queue.empty(); });
+            if ( bStop ) return;
+            key = queue.front();
+            queue.pop_front();
+            if ( find(key) != entries.end() ) continue;
+            loading = key;
+            s = settings;
+            g = generation;
+        }
+        
+        Entry entry;
+        entry.key = key;
+        entry.canvas.strips = s.strips;
+        entry.canvas.render = s.render;
+        entry.canvas.lod_tolerance = s.lod_tolerance;
+        bool ok = loader(key, s, entry.canvas, entry.origin.source);
+        entry.origin.settings = s;
+        entry.bytes = entry.canvas.bytes();
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        loading = -1;
+        if ( g != generation ) continue;
+        if ( ! ok ) { failures.insert(key); continue; }
+        // Prefetched entries are the first to go, requested ones the last
+        insert(std::move(entry), requested.count(key) > 0);
+    }
+}
@@ -0,0 +1,116 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <list>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Canvas.h"
+
+// Prepared canvases by key (decoded, depth-aligned, projected, with topology), kept in least recently used order
+// within a memory budget. A worker thread prepares the requested and prefetched keys, so the render thread only
+// swaps canvases in and out. The canvas swapped out can be kept too, so going back to it is a hit.
+
+class CanvasCache
+{
+public:
+    
+    // Canvas settings the entries are prepared with. Entries made with another level of detail or strips are dropped.
+    struct Settings {
+        float focal = 0, extrusion = 0;
+        bool strips = false;
+        RenderMode render = RENDER_WIREFRAME;
+        float lod_tolerance = 0;
+    };
+    // What a canvas was made from and with: its sources (opaque here, kept alive along the canvas), the settings it is
+    // projected with, and whether its animated buffers may have moved away from the rest ones
+    struct Origin {
+        std::shared_ptr<const void> source;
+        Settings settings;
+        bool bAnimated = false;
+    };
+    // Called from the worker thread: loads, projects and builds the topology of the canvas of 'key', false on failure.
+    // 'source' keeps what the canvas was loaded from, for the render thread to reload it (e.g. showing the depth).
+    typedef std::function<bool(int key, const Settings & settings, Canvas & canvas, std::shared_ptr<const void> & source)> Loader;
+    
+    enum State { ABSENT, QUEUED, READY, FAILED };
+    
+    struct Stats {
+        size_t hits = 0, misses = 0, evicted = 0;
+        size_t entries = 0, bytes = 0, budget = 0;
+    };
+    
+    ~CanvasCache() { stop(); }
+    
+    void start(const Loader & loader, size_t budget);
+    void stop();
+    void clear();
+    void configure(const Settings & settings);
+    
+    // A key about to be shown: counts a hit when ready, otherwise a miss, and queues it before any prefetch
+    State request(int key);
+    // A key likely to be shown soon, queued after the others unless cached
+    void prefetch(int key);
+    State state(int key) const;
+    // Swaps the ready canvas of 'key' and its origin into 'canvas' and 'origin', whose previous content is kept
+    // as 'previous' (dropped if < 0)
+    bool swap(int key, Canvas & canvas, Origin & origin, int previous);
+    Stats stats() const;
+    
+private:
+    
+    struct Entry {
+        int key;
+        Canvas canvas;
+        Origin origin;
+        size_t bytes;
+    };
+    
+    void work();
+    State lookup(int key) const;
+    void insert(Entry && entry, bool recent);
+    std::list<Entry>::iterator find(int key);
+    std::list<Entry>::const_iterator find(int key) const;
+    
+    Loader loader;
+    Settings settings;
+    Stats counters;
+    
+    std::list<Entry> entries;               // most recently used first
+    std::deque<int> queue;
+    std::set<int> failures;
+    std::set<int> requested;                // waiting to be shown
+    int loading = -1;
+    size_t generation = 0;                  // renewed when the entries are dropped, so a load in flight is too
+    
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    bool bStop = false;
+};
@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <sys/stat.h>
+#include "CanvasFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+static const size_t alignment = 64;
+static size_t align(size_t offset) { return (offset + alignment - 1) / alignment * alignment; }
+
+//--------------------------------------------------------------
+bool MappedFile::open(const std::string & path)
+{
+    close();
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if ( file == INVALID_HANDLE_VALUE ) { file = nullptr; return false; }
+    LARGE_INTEGER size;
+    if ( ! GetFileSizeEx(file, &size) || ! size.QuadPart ) { close(); return false; }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if ( ! mapping ) { close(); return false; }
+    bytes = (const unsigned char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    length = bytes ? size.QuadPart : 0;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if ( fd < 0 ) return false;
+    struct stat info;
+    if ( fstat(fd, &info) == 0 && info.st_size > 0 )
+    {
+        void * p = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( p != MAP_FAILED ) { bytes = (const unsigned char *) p; length = info.st_size; }
+    }
+    ::close(fd);
+#endif
+    return bytes != nullptr;
+}
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if ( bytes ) UnmapViewOfFile(bytes);
+    if ( mapping ) CloseHandle(mapping);
+    if ( file ) CloseHandle(file);
+    mapping = file = nullptr;
+#else
+    if ( bytes ) munmap((void *) bytes, length);
+#endif
+    bytes = nullptr;
+    length = 0;
+}
+//--------------------------------------------------------------
+uint64_t CanvasFile::stamp(const std::string & image_path, const std::string & depth_path)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for ( const std::string * path : { &image_path, &depth_path } )
+    {
+        struct stat info;
+        if ( stat(path->c_str(), &info) != 0 ) return 0;
+        uint64_t values[2] = { (uint64_t) info.st_size, (uint64_t) info.st_mtime };
+        for ( uint64_t v : values )
+            for ( int b = 0; b < 8; ++b ) h = (h ^ ((v >> (8 * b)) & 0xFF)) * 0x100000001B3ULL;    // FNV-1a
+    }
+    return h ? h : 1;
+}
+bool CanvasFile::write(const std::string & path, uint64_t stamp, int width, int height,
+                       const unsigned char * image, const uint16_t * depth,
+                       const Canvas * projected, float focal, float extrusion)
+{
+    const size_t n = (size_t) width * height;
+    bool geometry = projected && ! projected->decimated() && projected->width == width && projected->height == height
+                 && projected->size() == n;
+    
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "DPCF", 4);
+    header.version = VERSION;
+    header.width = width;
+    header.height = height;
+    header.stamp = stamp;
+    header.image_offset = align(sizeof(Header));
+    header.depth_offset = align(header.image_offset + n * 3);
+    size_t end = header.depth_offset + n * 2;
+    if ( geometry )
+    {
+        header.flags |= FLAG_GEOMETRY;
+        header.focal = focal;
+        header.extrusion = extrusion;
+        const Canvas::Limits & l = projected->limits;
+        float limits[6] = { l.far.x, l.far.y, l.far.z, l.near.x, l.near.y, l.near.z };
+        std::memcpy(header.limits, limits, sizeof(limits));
+        header.geometry_offset = align(end);
+        end = header.geometry_offset + n * sizeof(Vec3);
+    }
+    header.length = end;
+    
+    // Unique per process and call, so concurrent writers never share a temporary file
+    static std::atomic<unsigned> writes(0);
+    std::string temporary = path + "." + std::to_string(getpid()) + "." + std::to_string(writes++) + ".tmp";
+    FILE * f = std::fopen(temporary.c_str(), "wb");
+    if ( ! f ) return false;
+    static const unsigned char padding[alignment] = {};
+    size_t written = 0;
+    auto put = [&](const void * data, size_t bytes, size_t offset) {
+        if ( offset > written ) written += std::fwrite(padding, 1, offset - written, f);
+        written += std::fwrite(data, 1, bytes, f);
+    };
+    put(&header, sizeof(header), 0);
+    put(image, n * 3, header.image_offset);
+    put(depth, n * 2, header.depth_offset);
+    if ( geometry ) put(projected->vertexes.data(), n * sizeof(Vec3), header.geometry_offset);
+    bool ok = std::fclose(f) == 0 && written == end;
+    
+    std::remove(path.c_str());
+    ok = ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+    if ( ! ok ) std::remove(temporary.c_str());
+    return ok;
+}
+//--------------------------------------------------------------
+std::unique_lock<std::mutex> CanvasFile::lock(const std::string & path)
+{
+    // One mutex per path ever made, they are few
+    static std::mutex paths_mutex;
+    static std::map<std::string, std::unique_ptr<std::mutex>> paths;
+    std::mutex * m;
+    {
+        std::lock_guard<std::mutex> guard(paths_mutex);
+        std::unique_ptr<std::mutex> & slot = paths[path];
+        if ( ! slot ) slot.reset(new std::mutex);
+        m = slot.get();
+    }
+    return std::unique_lock<std::mutex>(*m);
+}
+bool CanvasFile::open(const std::string & path)
+{
+    close();
+    if ( ! file.open(path) || file.size() < sizeof(Header) ) { file.close(); return false; }
+    
+    const Header * h = (const Header *) file.data();
+    const size_t n = (size_t) h->width * h->height;
+    bool valid = ! std::memcmp(h->magic, "DPCF", 4) && h->version == VERSION && n && h->length == file.size()
+              && h->image_offset + n * 3 <= file.size() && h->depth_offset + n * 2 <= file.size()
+              && ( ! (h->flags & FLAG_GEOMETRY) || h->geometry_offset + n * sizeof(Vec3) <= file.size() );
+    if ( ! valid ) { file.close(); return false; }
+    header = h;
+    return true;
+}
+bool CanvasFile::hasGeometry(float focal, float extrusion) const
+{
+    return (header->flags & FLAG_GEOMETRY) && header->focal == focal && header->extrusion == extrusion;
+}
+void CanvasFile::load(Canvas & canvas, float focal, float extrusion, bool show_depth) const
+{
+    canvas.width = width();
+    canvas.height = height();
+    canvas.load(image(), depth(), show_depth);
+    if ( ! canvas.decimated() && hasGeometry(focal, extrusion) )
+    {
+        const float * l = header->limits;
+        Canvas::Limits limits;
+        limits.far = Vec3(l[0], l[1], l[2]);
+        limits.near = Vec3(l[3], l[4], l[5]);
+        canvas.setGeometry((const Vec3 *) (file.data() + header->geometry_offset), limits);
+    }
+    else canvas.project(focal, extrusion);
+}
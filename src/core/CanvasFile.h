@@ -0,0 +1,113 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include "Canvas.h"
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    
+    bool open(const std::string & path);
+    void close();
+    bool isOpen() const { return bytes != nullptr; }
+    const unsigned char * data() const { return bytes; }
+    size_t size() const { return length; }
+    
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+    
+private:
+    
+    const unsigned char * bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void * file = nullptr, * mapping = nullptr;
+#endif
+};
+
+// Precomputed canvas source (.dpc): the colour image and the depth aligned to it, optionally with the geometry
+// projected for one focal and extrusion. Sections are raw and 64-byte aligned, so an opened file is only mapped,
+// and loading a canvas from it costs the page-in of what is actually read.
+//
+//  header      CanvasFile::Header
+//  image       width x height RGB bytes
+//  depth       width x height 16-bit raw depth (before the 255 - d inversion, 65535 for 255), prepared by DepthUpsampler
+//  geometry    width x height Vec3 rest vertexes, optional
+
+class CanvasFile
+{
+public:
+    
+    struct Header {
+        char magic[4];                  // "DPCF"
+        uint32_t version;
+        uint32_t width, height;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t stamp;                 // of the sources the file was made from
+        float focal, extrusion;         // of the geometry
+        float limits[6];                // far, near
+        uint64_t image_offset, depth_offset, geometry_offset;
+        uint64_t length;                // of the whole file, a shorter or longer one is not opened
+    };
+    enum { VERSION = 3, FLAG_GEOMETRY = 1 };
+    
+    // Identifies a pair of source files by their size and modification time, 0 when missing
+    static uint64_t stamp(const std::string & image_path, const std::string & depth_path);
+    
+    // Writes (through a temporary file of its own, renamed at the end) an image and its depth.
+    // With a projected full grid canvas its rest geometry is stored too.
+    static bool write(const std::string & path, uint64_t stamp, int width, int height,
+                      const unsigned char * image, const uint16_t * depth,
+                      const Canvas * projected = nullptr, float focal = 0, float extrusion = 0);
+    
+    // Held by whoever checks, makes and opens the file at 'path', so two threads never convert the same sources
+    static std::unique_lock<std::mutex> lock(const std::string & path);
+    
+    bool open(const std::string & path);
+    void close() { file.close(); header = nullptr; }
+    bool isOpen() const { return header != nullptr; }
+    
+    int width() const { return header->width; }
+    int height() const { return header->height; }
+    uint64_t getStamp() const { return header->stamp; }
+    const unsigned char * image() const { return file.data() + header->image_offset; }
+    const uint16_t * depth() const { return (const uint16_t *) (file.data() + header->depth_offset); }
+    bool hasGeometry(float focal, float extrusion) const;
+    
+    // Loads the canvas (size, colours, depth) and projects it, from the stored geometry when it matches
+    void load(Canvas & canvas, float focal, float extrusion, bool show_depth) const;
+    
+private:
+    
+    MappedFile file;
+    const Header * header = nullptr;
+};
@@ -0,0 +1,325 @@
+#include <cstring>
+#include <algorithm>
+#include "Control.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    typedef SOCKET Handle;
+#else
+    typedef int Handle;
+#endif
+    const int receive_timeout = 100;            // ms, how long stop() may wait for the thread
+    const int receive_buffer = 1 << 20;         // bytes the system keeps for bursts, capped by its own limit
+    
+    bool openSocket(intptr_t & socket, std::string & error)
+    {
+#ifdef _WIN32
+        static bool bStarted = false;
+        WSADATA data;
+        if ( ! bStarted && WSAStartup(MAKEWORD(2, 2), &data) != 0 ) { error = "Could not start Winsock"; return false; }
+        bStarted = true;
+        SOCKET s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if ( s == INVALID_SOCKET ) { error = "Could not open a UDP socket"; return false; }
+        socket = (intptr_t) s;
+#else
+        socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if ( socket < 0 ) { error = "Could not open a UDP socket"; return false; }
+#endif
+        return true;
+    }
+    void closeSocket(intptr_t & socket)
+    {
+        if ( socket == -1 ) return;
+#ifdef _WIN32
+        closesocket((SOCKET) socket);
+#else
+        ::close((Handle) socket);
+#endif
+        socket = -1;
+    }
+    
+    // OSC strings are null-terminated and padded to 4 bytes
+    size_t padded(size_t size) { return (size + 3) & ~(size_t) 3; }
+    bool readString(const unsigned char * data, size_t size, size_t & at, const char * & text)
+    {
+        const void * end = at < size ? std::memchr(data + at, 0, size - at) : nullptr;
+        if ( ! end ) return false;
+        text = (const char *) data + at;
+        at += padded((const unsigned char *) end - (data + at) + 1);
+        return at <= size;
+    }
+    bool readWord(const unsigned char * data, size_t size, size_t & at, uint32_t & word)
+    {
+        if ( at + 4 > size ) return false;
+        word = (uint32_t) data[at] << 24 | (uint32_t) data[at + 1] << 16 | (uint32_t) data[at + 2] << 8 | data[at + 3];
+        at += 4;
+        return true;
+    }
+    bool writeString(unsigned char * data, size_t size, size_t & at, const char * text)
+    {
+        size_t length = std::strlen(text), end = at + padded(length + 1);
+        if ( end > size ) return false;
+        std::memcpy(data + at, text, length);
+        std::memset(data + at + length, 0, end - at - length);
+        at = end;
+        return true;
+    }
+    bool writeWord(unsigned char * data, size_t size, size_t & at, uint32_t word)
+    {
+        if ( at + 4 > size ) return false;
+        for ( int b = 0; b < 4; ++b ) data[at + b] = (unsigned char) (word >> (24 - 8 * b));
+        at += 4;
+        return true;
+    }
+    
+    bool parseMessage(const unsigned char * data, size_t size, std::vector<ControlCommand> & commands)
+    {
+        size_t at = 0;
+        const char * address, * tags;
+        if ( ! readString(data, size, at, address) || address[0] != '/' || std::strlen(address) >= ControlCommand::length ) return false;
+        ControlCommand command;
+        std::strcpy(command.address, address);
+        // Without a type tag string (older senders) there are no arguments. Only the first argument is taken.
+        if ( at < size && readString(data, size, at, tags) && tags[0] == ',' && tags[1] )
+        {
+            uint32_t word;
+            const char * text;
+            switch ( tags[1] )
+            {
+                case 'i':
+                    if ( ! readWord(data, size, at, word) ) return false;
+                    command.argument = ControlCommand::INT;
+                    command.value = (float) (int32_t) word;
+                    break;
+                case 'f':
+                    if ( ! readWord(data, size, at, word) ) return false;
+                    command.argument = ControlCommand::FLOAT;
+                    std::memcpy(&command.value, &word, 4);
+                    break;
+                case 's':
+                    if ( ! readString(data, size, at, text) || std::strlen(text) >= ControlCommand::length ) return false;
+                    command.argument = ControlCommand::STRING;
+                    std::strcpy(command.text, text);
+                    break;
+                default:
+                    break;
+            }
+        }
+        commands.push_back(command);
+        return true;
+    }
+}
+//--------------------------------------------------------------
+bool ControlCommand::is(const char * name) const
+{
+    return std::strcmp(address, name) == 0;
+}
+//--------------------------------------------------------------
+bool ControlServer::start(int port, bool bLocal)
+{
+    stop();
+    error.clear();
+    if ( ! openSocket(socket, error) ) return false;
+
+#ifdef _WIN32
+    DWORD timeout = receive_timeout;
+#else
+    timeval timeout = { 0, receive_timeout * 1000 };
+#endif
+    setsockopt((Handle) socket, SOL_SOCKET, SO_RCVTIMEO, (const char *) &timeout, sizeof(timeout));
+    setsockopt((Handle) socket, SOL_SOCKET, SO_RCVBUF, (const char *) &receive_buffer, sizeof(receive_buffer));
+    
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    address.sin_addr.s_addr = htonl(bLocal ? INADDR_LOOPBACK : INADDR_ANY);
+    if ( bind((Handle) socket, (const sockaddr *) &address, sizeof(address)) != 0 )
+    {
+        error = "Could not listen on port " + std::to_string(port);
+        closeSocket(socket);
+        return false;
+    }
+    // Port 0 takes any free one
+    socklen_t length = sizeof(address);
+    getsockname((Handle) socket, (sockaddr *) &address, &length);
+    this->port = ntohs(address.sin_port);
+    
+    bRunning = true;
+    thread = std::thread(&ControlServer::receive, this);
+    return true;
+}
+void ControlServer::stop()
+{
+    bRunning = false;
+    if ( thread.joinable() ) thread.join();
+    closeSocket(socket);
+}
+void ControlServer::receive()
+{
+    std::vector<unsigned char> packet(65536);
+    std::vector<ControlCommand> commands;
+    while ( bRunning )
+    {
+        // Times out to see a stop
+        int size = (int) recvfrom((Handle) socket, (char *) packet.data(), (int) packet.size(), 0, nullptr, nullptr);
+        if ( size <= 0 ) continue;
+        commands.clear();
+        if ( ! parse(packet.data(), size, commands) ) ++malformed;
+        for ( const ControlCommand & command : commands )
+        {
+            if ( ring.push(command) ) ++received;
+            else ++dropped;
+        }
+    }
+}
+//--------------------------------------------------------------
+void ControlServer::drain(std::vector<ControlCommand> & commands)
+{
+    commands.clear();
+    pending.clear();
+    ControlCommand command;
+    while ( ring.pop(command) ) pending.push_back(command);
+    
+    // From the newest: a parameter already seen is overridden
+    for ( size_t c = pending.size(); c-- > 0; )
+    {
+        const ControlCommand & next = pending[c];
+        bool bOverridden = next.parameter() && std::any_of(commands.begin(), commands.end(), [&](const ControlCommand & later) {
+            return later.parameter() && later.is(next.address);
+        });
+        if ( bOverridden ) ++coalesced;
+        else commands.push_back(next);
+    }
+    std::reverse(commands.begin(), commands.end());
+}
+ControlServer::Stats ControlServer::stats() const
+{
+    Stats stats;
+    stats.received = received;
+    stats.malformed = malformed;
+    stats.dropped = dropped;
+    stats.coalesced = coalesced;
+    return stats;
+}
+//--------------------------------------------------------------
+bool ControlServer::parse(const unsigned char * data, size_t size, std::vector<ControlCommand> & commands)
+{
+    if ( size < 4 || size % 4 ) return false;
+    if ( size < 16 || std::memcmp(data, "#bundle", 8) != 0 ) return parseMessage(data, size, commands);
+    
+    // Time tag ignored: commands apply on the next frame. Elements are messages or bundles, each after its size.
+    size_t at = 16;
+    while ( at < size )
+    {
+        uint32_t element;
+        if ( ! readWord(data, size, at, element) || element > size - at || ! parse(data + at, element, commands) ) return false;
+        at += element;
+    }
+    return at == size;
+}
+size_t ControlServer::encode(const ControlCommand & command, unsigned char * data, size_t size)
+{
+    static const char * tags[] = { ",", ",i", ",f", ",s" };
+    size_t at = 0;
+    if ( ! writeString(data, size, at, command.address) || ! writeString(data, size, at, tags[command.argument]) ) return 0;
+    uint32_t word = 0;
+    switch ( command.argument )
+    {
+        case ControlCommand::NONE:
+            break;
+        case ControlCommand::INT:
+            if ( ! writeWord(data, size, at, (uint32_t) (int32_t) command.value) ) return 0;
+            break;
+        case ControlCommand::FLOAT:
+            std::memcpy(&word, &command.value, 4);
+            if ( ! writeWord(data, size, at, word) ) return 0;
+            break;
+        case ControlCommand::STRING:
+            if ( ! writeString(data, size, at, command.text) ) return 0;
+            break;
+    }
+    return at;
+}
+//--------------------------------------------------------------
+bool ControlClient::open(int port, const std::string & host)
+{
+    close();
+    in_addr address;
+    std::string error;
+    if ( inet_pton(AF_INET, host.c_str(), &address) != 1 || ! openSocket(socket, error) ) return false;
+    this->host = address.s_addr;
+    this->port = htons((uint16_t) port);
+    return true;
+}
+void ControlClient::close()
+{
+    closeSocket(socket);
+}
+bool ControlClient::send(const ControlCommand & command)
+{
+    unsigned char packet[4 * ControlCommand::length];
+    size_t size = ControlServer::encode(command, packet, sizeof(packet));
+    return size && sendPacket(packet, size);
+}
+bool ControlClient::send(const std::vector<ControlCommand> & commands)
+{
+    // "#bundle", the immediate time tag, then every message after its size
+    std::vector<unsigned char> packet(16 + commands.size() * (4 + 4 * ControlCommand::length));
+    size_t at = 0;
+    writeString(packet.data(), packet.size(), at, "#bundle");
+    writeWord(packet.data(), packet.size(), at, 0);
+    writeWord(packet.data(), packet.size(), at, 1);
+    for ( const ControlCommand & command : commands )
+    {
+        size_t size = ControlServer::encode(command, packet.data() + at + 4, packet.size() - at - 4);
+        if ( ! size ) return false;
+        writeWord(packet.data(), packet.size(), at, (uint32_t) size);
+        at += size;
+    }
+    return sendPacket(packet.data(), at);
+}
+bool ControlClient::sendPacket(const unsigned char * packet, size_t size)
+{
+    if ( socket == -1 ) return false;
+    sockaddr_in target = {};
+    target.sin_family = AF_INET;
+    target.sin_port = port;
+    target.sin_addr.s_addr = host;
+    return sendto((Handle) socket, (const char *) packet, (int) size, 0, (const sockaddr *) &target, sizeof(target)) == (int) size;
+}
+bool ControlClient::send(const char * address)
+{
+    ControlCommand command;
+    std::strncpy(command.address, address, ControlCommand::length - 1);
+    return send(command);
+}
+bool ControlClient::send(const char * address, float value)
+{
+    ControlCommand command;
+    std::strncpy(command.address, address, ControlCommand::length - 1);
+    command.argument = ControlCommand::FLOAT;
+    command.value = value;
+    return send(command);
+}
+bool ControlClient::send(const char * address, const char * text)
+{
+    ControlCommand command;
+    std::strncpy(command.address, address, ControlCommand::length - 1);
+    command.argument = ControlCommand::STRING;
+    std::strncpy(command.text, text, ControlCommand::length - 1);
+    return send(command);
+}
@@ -0,0 +1,136 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Ring.h"
+
+// Show control over local UDP: OSC 1.0 messages (or bundles of them) received on a thread of its own and handed to
+// the frame loop through a lock-free ring, so a controller never waits on a frame and a frame never waits on the
+// network. Messages with a float argument set continuous parameters: between two drains only the latest value of
+// each address is kept. Any other message (no argument, an int or a string) is an action, kept in order.
+//
+//  /key s|i            a key stroke, as typed
+//  /extrusion f        camera extrusion, absolute
+//  /focal f            camera focal, absolute
+//  /intensity f        of the effects, in place of the audio spectrum (a negative value gives it back)
+//  /strength/synapses f, /strength/flattening f, /strength/inclusion f, /strength/noise f
+//                      of each effect, [0,1], 1 as designed (see Animator::Strengths)
+
+#define CONTROL_PORT    9100            // UDP, of the app and of the client by default
+
+struct ControlCommand
+{
+    enum Argument { NONE, INT, FLOAT, STRING };
+    static const size_t length = 32;            // of the address and the string, terminator included
+    
+    char address[length] = {};
+    Argument argument = NONE;
+    float value = 0;                            // of INT and FLOAT
+    char text[length] = {};                     // of STRING
+    
+    bool parameter() const { return argument == FLOAT; }
+    bool is(const char * name) const;
+};
+
+class ControlServer
+{
+public:
+    
+    static const size_t capacity = 1024;        // commands waiting for a drain
+    
+    struct Stats {
+        size_t received = 0;                    // commands
+        size_t malformed = 0;                   // packets
+        size_t dropped = 0;                     // commands, with the ring full
+        size_t coalesced = 0;                   // parameter updates overridden by a later one before a drain
+    };
+    
+    // Listens on 'port' of the loopback interface, or of every interface with bLocal false
+    bool start(int port, bool bLocal = true);
+    void stop();
+    bool running() const { return bRunning; }
+    int getPort() const { return port; }
+    
+    // Frame loop: the commands received since the last drain, each parameter at the place of its latest value
+    void drain(std::vector<ControlCommand> & commands);
+    Stats stats() const;
+    
+    // Commands of an OSC packet, false when it is malformed (the commands decoded before are kept)
+    static bool parse(const unsigned char * data, size_t size, std::vector<ControlCommand> & commands);
+    // One OSC message, for clients: 'argument' of 'value' or 'text'. Returns its size, 0 if it does not fit.
+    static size_t encode(const ControlCommand & command, unsigned char * data, size_t size);
+    
+    ControlServer() {}
+    ControlServer(const ControlServer &) = delete;
+    ControlServer & operator=(const ControlServer &) = delete;
+    ~ControlServer() { stop(); }
+    
+    std::string error;                          // of the last failed start
+    
+private:
+    
+    void receive();
+    
+    SpscRing<ControlCommand> ring { capacity };
+    std::thread thread;
+    std::atomic<bool> bRunning { false };
+    intptr_t socket = -1;
+    int port = 0;
+    std::atomic<size_t> received { 0 }, malformed { 0 }, dropped { 0 };
+    size_t coalesced = 0;
+    std::vector<ControlCommand> pending;
+};
+
+// Sends OSC messages to a control server, e.g. from a show controller or a test
+class ControlClient
+{
+public:
+    
+    bool open(int port, const std::string & host = "127.0.0.1");
+    void close();
+    bool send(const ControlCommand & command);
+    bool send(const char * address);
+    bool send(const char * address, float value);
+    bool send(const char * address, const char * text);
+    // One bundle of 'commands', received together
+    bool send(const std::vector<ControlCommand> & commands);
+    
+    ControlClient() {}
+    ControlClient(const ControlClient &) = delete;
+    ControlClient & operator=(const ControlClient &) = delete;
+    ~ControlClient() { close(); }
+    
+private:
+    
+    bool sendPacket(const unsigned char * packet, size_t size);
+    
+    intptr_t socket = -1;
+    uint32_t host = 0;                          // IPv4, network order
+    uint16_t port = 0;                          // network order
+};
@@ -0,0 +1,146 @@
+#include <cmath>
+#include <algorithm>
+#include "Culling.h"
+#include "Parallel.h"
+
+//--------------------------------------------------------------
+Frustum::Frustum(const float m[16])
+{
+    // Row r of the matrix is (m[r], m[4 + r], m[8 + r], m[12 + r]): left, right, bottom, top, near and far are
+    // row 3 plus or minus rows 0, 1 and 2
+    for ( int p = 0; p < 6; ++p )
+    {
+        const int row = p / 2;
+        const float sign = p % 2 ? -1 : 1;
+        for ( int c = 0; c < 4; ++c ) planes[p][c] = m[c * 4 + 3] + sign * m[c * 4 + row];
+    }
+}
+bool Frustum::intersects(const Vec3 & low, const Vec3 & high) const
+{
+    // The box corner furthest along each plane normal
+    for ( const float * plane : planes )
+    {
+        float x = plane[0] >= 0 ? high.x : low.x;
+        float y = plane[1] >= 0 ? high.y : low.y;
+        float z = plane[2] >= 0 ? high.z : low.z;
+        if ( plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0 ) return false;
+    }
+    return true;
+}
+//--------------------------------------------------------------
+void TileCuller::tileVertexes(size_t t, int & x0, int & x1, int & y0, int & y1) const
+{
+    const int tx = t % topology->tiles_x, ty = t / topology->tiles_x;
+    x0 = tx * Topology::tile;
+    y0 = ty * Topology::tile;
+    x1 = tx + 1 == topology->tiles_x ? topology->width : x0 + Topology::tile;
+    y1 = ty + 1 == topology->tiles_y ? topology->height : y0 + Topology::tile;
+}
+void TileCuller::bound(const Canvas & canvas)
+{
+    topology.reset();
+    drawn.clear();
+    counters = Stats();
+    if ( canvas.decimated() || ! canvas.topology || ! canvas.topology->tiles_x || ! canvas.size() ) return;
+    topology = canvas.topology;
+    
+    const size_t tiles = (size_t) topology->tiles_x * topology->tiles_y;
+    const int width = topology->width;
+    lows.resize(tiles);
+    highs.resize(tiles);
+    parallelFor(tiles, [&](size_t begin, size_t end) {
+        for ( size_t t = begin; t < end; ++t )
+        {
+            // The cells of a tile reach the first column and row of the next one
+            int x0, x1, y0, y1;
+            tileVertexes(t, x0, x1, y0, y1);
+            x1 = std::min(x1 + 1, width);
+            y1 = std::min(y1 + 1, topology->height);
+            Vec3 low(INFINITY, INFINITY, INFINITY), high(-INFINITY, -INFINITY, -INFINITY);
+            for ( int y = y0; y < y1; ++y )
+            {
+                const Vec3 * v = canvas.animated_vertexes.data() + (size_t) y * width;
+                for ( int x = x0; x < x1; ++x )
+                {
+                    low.x = std::min(low.x, v[x].x);    high.x = std::max(high.x, v[x].x);
+                    low.y = std::min(low.y, v[x].y);    high.y = std::max(high.y, v[x].y);
+                    low.z = std::min(low.z, v[x].z);    high.z = std::max(high.z, v[x].z);
+                }
+            }
+            lows[t] = low;
+            highs[t] = high;
+        }
+    });
+    counters.tiles = tiles;
+}
+void TileCuller::cull(const float matrix[16], size_t budget)
+{
+    drawn.clear();
+    if ( ! topology ) return;
+    const size_t tiles = counters.tiles;
+    counters = Stats();
+    counters.tiles = tiles;
+    
+    const Frustum frustum(matrix);
+    selected.resize(tiles);
+    nearest.clear();
+    size_t vertexes = 0;
+    for ( size_t t = 0; t < tiles; ++t )
+    {
+        selected[t] = frustum.intersects(lows[t], highs[t]);
+        if ( ! selected[t] ) continue;
+        ++counters.visible;
+        int x0, x1, y0, y1;
+        tileVertexes(t, x0, x1, y0, y1);
+        vertexes += (size_t) (x1 - x0) * (y1 - y0);
+        if ( ! budget ) continue;
+        // Clip w of the tile centre: its depth along the view direction
+        Vec3 c = (lows[t] + highs[t]) * 0.5f;
+        nearest.push_back(std::make_pair(matrix[3] * c.x + matrix[7] * c.y + matrix[11] * c.z + matrix[15], (uint32_t) t));
+    }
+    counters.culled = tiles - counters.visible;
+    
+    if ( budget && vertexes > budget )
+    {
+        // Nearest tiles first, the first one whatever its size
+        std::sort(nearest.begin(), nearest.end());
+        vertexes = 0;
+        for ( const auto & tile : nearest )
+        {
+            int x0, x1, y0, y1;
+            tileVertexes(tile.second, x0, x1, y0, y1);
+            size_t n = (size_t) (x1 - x0) * (y1 - y0);
+            if ( vertexes && vertexes + n > budget ) { selected[tile.second] = 0; ++counters.budgeted; }
+            else vertexes += n;
+        }
+    }
+    counters.vertexes = vertexes;
+    
+    // Consecutive tiles are contiguous in the index buffer. Without indices (points), vertexes are in rows:
+    // every row of a tile is a range, merged with the next tile of the row and with the next row when whole.
+    auto add = [&](uint32_t first, uint32_t count) {
+        if ( ! count ) return;
+        if ( drawn.size() && drawn.back().first + drawn.back().count == first ) drawn.back().count += count;
+        else drawn.push_back(Range{ first, count });
+    };
+    if ( topology->tile_starts.size() )
+    {
+        for ( size_t t = 0; t < tiles; ++t )
+            if ( selected[t] ) add(topology->tile_starts[t], topology->tile_starts[t + 1] - topology->tile_starts[t]);
+        return;
+    }
+    for ( int ty = 0; ty < topology->tiles_y; ++ty )
+    {
+        int x0, x1, y0, y1;
+        tileVertexes((size_t) ty * topology->tiles_x, x0, x1, y0, y1);
+        for ( int y = y0; y < y1; ++y )
+            for ( int tx = 0; tx < topology->tiles_x; ++tx )
+            {
+                size_t t = (size_t) ty * topology->tiles_x + tx;
+                if ( ! selected[t] ) continue;
+                int column, column_end, row, row_end;
+                tileVertexes(t, column, column_end, row, row_end);
+                add((uint32_t) y * topology->width + column, column_end - column);
+            }
+    }
+}
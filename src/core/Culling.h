@@ -0,0 +1,83 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Buffer.h"
+#include "Canvas.h"
+
+// Clip planes of a projection * view (* model) matrix, column-major as glm (Gribb & Hartmann): a point p is inside
+// when every plane gives dot(plane, (p, 1)) >= 0.
+
+struct Frustum
+{
+    explicit Frustum(const float m[16]);
+    // False only when the box lies entirely behind one plane, so a box across a frustum corner may be kept
+    bool intersects(const Vec3 & low, const Vec3 & high) const;
+    
+    float planes[6][4];
+};
+
+// CPU visibility of a canvas by the tiles of its topology (Topology::tile cells a side): the bounds of every tile
+// are taken from the animated vertexes, culled against a camera matrix, and the visible tiles are drawn as a few
+// ranges of indices, or of vertexes for points. With a vertex budget, the tiles nearest to the camera go first
+// and the rest are dropped. Canvases without tiles (level of detail) are drawn whole.
+
+class TileCuller
+{
+public:
+    
+    struct Range {
+        uint32_t first, count;          // indices, or vertexes without them
+    };
+    struct Stats {
+        size_t tiles = 0, visible = 0, culled = 0;
+        size_t budgeted = 0;            // visible but dropped by the budget
+        size_t vertexes = 0;            // of the drawn tiles
+    };
+    
+    // Tile bounds from the animated vertexes, in parallel
+    void bound(const Canvas & canvas);
+    // Tiles of the last bounds seen through 'matrix' (projection * view * model), at most 'budget' vertexes when not 0
+    void cull(const float matrix[16], size_t budget = 0);
+    
+    // Nothing to cull: the canvas is drawn whole
+    bool whole() const { return ! topology; }
+    const std::vector<Range> & ranges() const { return drawn; }
+    const Stats & stats() const { return counters; }
+    size_t bytes() const { return lows.bytes() + highs.bytes() + selected.bytes(); }
+    
+private:
+    
+    // Vertexes of tile t, the last row and column of the grid going to the last tiles
+    void tileVertexes(size_t t, int & x0, int & x1, int & y0, int & y1) const;
+    
+    std::shared_ptr<const Topology> topology;
+    Buffer<Vec3> lows, highs;
+    Buffer<uint8_t> selected;
+    std::vector<std::pair<float, uint32_t>> nearest;    // view depth and tile
+    std::vector<Range> drawn;
+    Stats counters;
+};
@@ -0,0 +1,146 @@
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "Depth.h"
+#include "Parallel.h"
+#include "Settings.h"
+#include "Simd.h"
+
+//--------------------------------------------------------------
+static uint16_t quantize(float d)
+{
+    return (uint16_t) std::lrint(std::min(std::max(d, 0.f), 1.f) * 65535);
+}
+
+// Nearest depth samples of every output column (or row), the first one unclamped, and their spatial weights
+struct Taps {
+    int first;
+    int depth[DepthUpsampler::TAPS];
+    float weight[DepthUpsampler::TAPS];
+};
+static std::vector<Taps> taps(int size, int depth_size)
+{
+    std::vector<Taps> t(size);
+    const double scale = depth_size / (double) size;
+    for ( int x = 0; x < size; ++x )
+    {
+        double u = (x + 0.5) * scale - 0.5;
+        t[x].first = (int) std::floor(u) - (DepthUpsampler::TAPS / 2 - 1);
+        for ( int k = 0; k < DepthUpsampler::TAPS; ++k )
+        {
+            double d = t[x].first + k - u;
+            t[x].depth[k] = std::min(std::max(t[x].first + k, 0), depth_size - 1);
+            t[x].weight[k] = std::exp(-d * d / (2 * DEPTH_SIGMA_SPATIAL * DEPTH_SIGMA_SPATIAL));
+        }
+    }
+    return t;
+}
+//--------------------------------------------------------------
+void DepthUpsampler::prepare(const float * depth, int depth_width, int depth_height,
+                             const unsigned char * image, int width, int height, Buffer<uint16_t> & out)
+{
+    const size_t n = (size_t) width * height;
+    out.resize(n);
+    if ( depth_width == width && depth_height == height )
+    {
+        parallelFor(n, [&](size_t begin, size_t end) {
+            for ( size_t p = begin; p < end; ++p ) out[p] = quantize(depth[p]);
+        });
+        return;
+    }
+    
+    // Mean colour of the footprint of every depth pixel (a single pixel when the depth is larger)
+    const size_t depth_n = (size_t) depth_width * depth_height;
+    std::vector<unsigned char> guide(depth_n * 3);
+    auto footprint = [](int i, int size, int depth_size, int & begin, int & end) {
+        begin = std::min((int) ((int64_t) i * size / depth_size), size - 1);
+        end = std::max((int) ((int64_t) (i + 1) * size / depth_size), begin + 1);
+    };
+    parallelFor(depth_height, [&](size_t begin, size_t end) {
+        for ( size_t j = begin; j < end; ++j )
+        {
+            int y0, y1;
+            footprint(j, height, depth_height, y0, y1);
+            for ( int i = 0; i < depth_width; ++i )
+            {
+                int x0, x1;
+                footprint(i, width, depth_width, x0, x1);
+                unsigned sum[3] = { 0, 0, 0 };
+                for ( int y = y0; y < y1; ++y )
+                {
+                    const unsigned char * c = image + ((size_t) y * width + x0) * 3;
+                    for ( int x = x0; x < x1; ++x, c += 3 ) { sum[0] += c[0]; sum[1] += c[1]; sum[2] += c[2]; }
+                }
+                unsigned count = (y1 - y0) * (x1 - x0);
+                unsigned char * g = &guide[(j * depth_width + i) * 3];
+                for ( int c = 0; c < 3; ++c ) g[c] = (sum[c] + count / 2) / count;
+            }
+        }
+    });
+    
+    const std::vector<Taps> columns = taps(width, depth_width), rows = taps(height, depth_height);
+    
+    // Range weight exp(-x), x = distance^2 / (2 sigma^2), as (1 - x / 8)^8: 0 from 4 sigma on, and never 0 once
+    // offset, so that a pixel unlike all its samples still gets their mean
+    const float4 range(1 / (16.f * DEPTH_SIGMA_RANGE * DEPTH_SIGMA_RANGE)), one(1), zero(0), floor(1E-6f);
+    
+    // Output pixels of a tile row sharing their nearest depth samples only gather them once, a row of them per vector
+    const int tiles_x = (width + TILE - 1) / TILE, tiles_y = (height + TILE - 1) / TILE;
+    parallelFor((size_t) tiles_x * tiles_y, [&](size_t begin, size_t end) {
+        float4 r[TAPS], g[TAPS], b[TAPS], d[TAPS];
+        for ( size_t t = begin; t < end; ++t )
+        {
+            const int x0 = (t % tiles_x) * TILE, x1 = std::min(x0 + TILE, width);
+            const int y0 = (t / tiles_x) * TILE, y1 = std::min(y0 + TILE, height);
+            for ( int y = y0; y < y1; ++y )
+            {
+                const Taps & row = rows[y];
+                const unsigned char * c = image + ((size_t) y * width + x0) * 3;
+                int gathered = INT_MIN;
+                for ( int x = x0; x < x1; ++x, c += 3 )
+                {
+                    const Taps & column = columns[x];
+                    if ( column.first != gathered )
+                    {
+                        for ( int j = 0; j < TAPS; ++j )
+                        {
+                            const size_t line = (size_t) row.depth[j] * depth_width;
+                            float rs[TAPS], gs[TAPS], bs[TAPS], ds[TAPS];
+                            for ( int i = 0; i < TAPS; ++i )
+                            {
+                                const unsigned char * s = &guide[(line + column.depth[i]) * 3];
+                                rs[i] = s[0];
+                                gs[i] = s[1];
+                                bs[i] = s[2];
+                                ds[i] = depth[line + column.depth[i]];
+                            }
+                            r[j] = float4::load(rs);
+                            g[j] = float4::load(gs);
+                            b[j] = float4::load(bs);
+                            d[j] = float4::load(ds);
+                        }
+                        gathered = column.first;
+                    }
+                    const float4 cr(c[0]), cg(c[1]), cb(c[2]), spatial = float4::load(column.weight);
+                    float4 sum(0), weights(0);
+                    for ( int j = 0; j < TAPS; ++j )
+                    {
+                        float4 distance = abs(r[j] - cr) + abs(g[j] - cg) + abs(b[j] - cb);
+                        float4 w = max(one - distance * distance * range, zero);
+                        w = w * w;
+                        w = w * w;
+                        w = (w * w + floor) * spatial * float4(row.weight[j]);
+                        sum = sum + w * d[j];
+                        weights = weights + w;
+                    }
+                    float s[4], n[4];
+                    sum.store(s);
+                    weights.store(n);
+                    out[(size_t) y * width + x] = quantize((s[0] + s[1] + s[2] + s[3]) / (n[0] + n[1] + n[2] + n[3]));
+                }
+            }
+        }
+    }, 1);
+}
@@ -0,0 +1,44 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <cstdint>
+#include "Buffer.h"
+
+// Load-time depth preparation: a depth map of any size and precision (8 or 16 bit, float), as raw values in [0,1],
+// becomes 16-bit raw depth aligned to the colour image. A depth of another size is resampled with a joint bilateral
+// filter guided by the colour: every pixel averages the TAPS x TAPS nearest depth samples, weighted by their distance
+// (DEPTH_SIGMA_SPATIAL) and by how close the mean colour under them is to its own (DEPTH_SIGMA_RANGE), so depth edges
+// follow the colour edges instead of the coarse grid, and 8-bit steps are smoothed away within surfaces.
+// Tiles of TILE x TILE pixels run in parallel. Precomputed canvases (.dpc) keep the result.
+
+class DepthUpsampler
+{
+public:
+    
+    static const int TAPS = 4, TILE = 64;     // TAPS is the float4 width
+    
+    static void prepare(const float * depth, int depth_width, int depth_height,
+                        const unsigned char * image, int width, int height, Buffer<uint16_t> & out);
+};
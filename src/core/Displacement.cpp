@@ -0,0 +1,43 @@
+#include <cmath>
+#include <algorithm>
+#include "Displacement.h"
+#include "Noise.h"
+#include "Parallel.h"
+
+//--------------------------------------------------------------
+// Noise of every block, at the coordinate of its top-left pixel as in the original effect: speed * time + x + y * width.
+// Every pixel is then pushed towards the camera by its block noise plus a jitter, both weighted by how far it is
+// from the back plane. Fully flattened canvases are displaced from the middle plane, the rest from where the
+// other effects left them, scaled by sqrt(amount * flattening).
+void NoiseDisplacement::prepare(const Canvas & canvas, const Params & params)
+{
+    const int s = sampling = std::max(params.sampling, 1);
+    field_width  = (canvas.width  + s - 1) / s;
+    field_height = (canvas.height + s - 1) / s;
+    field.resize((size_t) field_width * field_height);
+    
+    const float base = params.speed * params.time;
+    const float4 vbase(base), vscale(10 * params.intensity), lanes(0, s, 2 * s, 3 * s);
+    parallelFor(field_height, [&](size_t begin, size_t end) {
+        for ( size_t by = begin; by < end; ++by )
+        {
+            const float Y = by * s * canvas.width;
+            const float4 vY(Y);
+            float * row = field.data() + by * field_width;
+            int bx = 0;
+            for ( ; bx + 4 <= field_width; bx += 4 )
+                (vscale * noise1(vbase + (float4(bx * s) + lanes) + vY)).store(row + bx);
+            for ( ; bx < field_width; ++bx )
+                row[bx] = 10 * params.intensity * noise1(base + bx * s + Y);
+        }
+    }, 1);
+    
+    const float thick = canvas.limits.far.z - canvas.limits.near.z;
+    far = canvas.limits.far.z;
+    inv_thick = 1.f / thick;
+    middle = 0.5f * thick + canvas.limits.near.z;
+    flat = params.flattening >= 1;
+    scale = depthScale(params);
+    intensity = params.intensity;
+    key = params.key;
+}
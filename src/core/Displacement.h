@@ -0,0 +1,91 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include "Buffer.h"
+#include "Canvas.h"
+#include "Random.h"
+#include "Simd.h"
+
+// Block-noise displacement of the canvas depth (the 'n' effect).
+// The canvas is split in sampling x sampling blocks, each one pushed by a simplex noise value evaluated once
+// per frame into 'field', plus a per-pixel random jitter from a counter-based stream.
+// prepare() sets up a frame, displace() is then called by the animation pass for every pixel (4 at a time).
+
+class NoiseDisplacement
+{
+public:
+    
+    struct Params {
+        float time = 0;             // s
+        float speed = 1;
+        float intensity = 1;
+        float amount = 0;           // effect fade in/out, [0,1]
+        float flattening = 0;       // current flattening, [0,1]
+        int sampling = 1;           // block size in pixels
+        uint32_t key = 0;           // random stream of this frame
+    };
+    
+    void prepare(const Canvas & canvas, const Params & params);
+    // Depth displacement factor of a frame, 0 when it moves nothing
+    static float depthScale(const Params & params)
+    {
+        return params.flattening >= 1 ? params.amount : std::sqrt(params.amount * params.flattening);
+    }
+    size_t bytes() const { return field.bytes(); }
+    
+    // Block noise of a canvas row, and of a pixel in it
+    const float * row(int y) const { return field.data() + (y / sampling) * field_width; }
+    float at(const float * N, int x) const { return N[x / sampling]; }
+    
+    // New depth of 4 pixels with block noise n, given their rest and current depth
+    float4 displace(float4 n, uint4 pixels, float4 rest_z, float4 z) const
+    {
+        float4 strength = (float4(far) - rest_z) * float4(inv_thick);
+        strength = strength * strength;
+        float4 jitter = Random::hashuf(uint4(key), pixels);
+        float4 inc = n * strength + jitter * (float4(intensity) * strength + float4(1));
+        return (flat ? float4(middle) : z) - inc * float4(scale);
+    }
+    float displace(float n, uint32_t pixel, float rest_z, float z) const
+    {
+        float strength = (far - rest_z) * inv_thick;
+        strength *= strength;
+        float inc = n * strength + Random::hashuf(key, pixel) * (intensity * strength + 1);
+        return (flat ? middle : z) - inc * scale;
+    }
+    
+private:
+    
+    Buffer<float> field;            // 10 * intensity * noise of every block
+    int field_width = 0, field_height = 0;
+    
+    // Frame constants
+    int sampling = 1;
+    float far = 0, inv_thick = 0, middle = 0, scale = 0, intensity = 0;
+    bool flat = false;
+    uint32_t key = 0;
+};
@@ -0,0 +1,51 @@
+#include <cmath>
+#include <algorithm>
+#include "Effect.h"
+#include "Settings.h"
+
+//--------------------------------------------------------------
+size_t SimulationClock::advance(double now)
+{
+    if ( ! bStarted )
+    {
+        simulated = now;
+        bStarted = true;
+        return 0;
+    }
+    double due = std::floor((now - simulated) / SIMULATION_STEP);
+    if ( due < 1 ) return 0;
+    simulated += due * SIMULATION_STEP;
+    size_t steps = std::min<double>(due, SIMULATION_MAX_STEPS);
+    count += steps;
+    return steps;
+}
+//--------------------------------------------------------------
+void Effect::reset(bool on)
+{
+    bOn = on;
+    level = on ? 1 : 0;
+    state = kind == SUSTAIN && on ? ACTIVE : IDLE;
+}
+void Effect::fire()
+{
+    if ( kind == PULSE ) level = 0;
+    else bOn = ! bOn;
+    state = kind == PULSE || bOn ? ACTIVE : FINISHING;
+}
+void Effect::advance(double ms)
+{
+    if ( state == IDLE ) return;
+    bool up = kind == PULSE || bOn;
+    float delta = ms / duration;
+    level = up ? std::min(level + delta, 1.f) : std::max(level - delta, 0.f);
+    if ( level == (up ? 1 : 0) && ! (kind == SUSTAIN && bOn) ) state = IDLE;
+}
+const char * Effect::name(State state)
+{
+    switch ( state )
+    {
+        case ACTIVE:    return "active";
+        case FINISHING: return "finishing";
+        default:        return "idle";
+    }
+}
@@ -0,0 +1,71 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <cstddef>
+
+// Fixed-step simulation time, apart from the render clock: effects ramp, synapses move and the camera orbits by
+// whole steps of SIMULATION_STEP ms however long frames take. advance() gives the steps due by the render time;
+// past SIMULATION_MAX_STEPS in a frame, the rest of a stall is dropped rather than caught up.
+
+class SimulationClock
+{
+public:
+    
+    void reset() { bStarted = false; count = 0; }
+    size_t advance(double now);
+    
+    double time() const { return simulated; }      // ms, of the last step
+    size_t steps() const { return count; }          // since the reset
+    
+private:
+    
+    double simulated = 0;
+    size_t count = 0;
+    bool bStarted = false;
+};
+
+// Lifecycle of an effect, its level ramping over 'duration' ms of simulation. A PULSE runs once from 0 to 1 when
+// fired; a TOGGLE ramps on (to 1) or off (to 0) on every fire and rests at either end; a SUSTAIN effect also ramps,
+// but keeps running while on. IDLE effects do no work, ACTIVE ones ramp up (or run), FINISHING ones ramp down.
+
+struct Effect
+{
+    enum Kind { PULSE, TOGGLE, SUSTAIN };
+    enum State { IDLE, ACTIVE, FINISHING };
+    
+    Effect(Kind kind, double duration, bool on = false) : kind(kind), duration(duration) { reset(on); }
+    
+    void fire();
+    void advance(double ms);
+    void reset(bool on = false);
+    bool idle() const { return state == IDLE; }
+    static const char * name(State state);
+    
+    Kind kind;
+    double duration;                // ms
+    State state = IDLE;
+    float level = 0;                // [0,1]
+    bool bOn = false;
+};
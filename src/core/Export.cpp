@@ -0,0 +1,307 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include "Export.h"
+#include "Parallel.h"
+
+// Buffered file output, written every 'chunk' bytes
+class ChunkWriter
+{
+public:
+
+    static const size_t chunk = 1 << 20;
+    
+    ChunkWriter(const std::string & path) : file(std::fopen(path.c_str(), "wb")) { buffer.resize(chunk); }
+    ~ChunkWriter() { if ( file ) std::fclose(file); }
+    
+    template<typename T> void put(const T & value) { put(&value, sizeof(T)); }
+    void put(const void * data, size_t n)
+    {
+        if ( used + n > chunk ) flush();
+        std::memcpy(buffer.data() + used, data, n);
+        used += n;
+    }
+    void flush()
+    {
+        if ( used && good ) good = file && std::fwrite(buffer.data(), 1, used, file) == used;
+        written += used;
+        used = 0;
+    }
+    // Bytes written, 0 on failure
+    size_t close()
+    {
+        flush();
+        bool closed = file && std::fclose(file) == 0;
+        file = nullptr;
+        return good && closed ? written : 0;
+    }
+
+private:
+
+    FILE * file;
+    Buffer<unsigned char> buffer;
+    size_t used = 0, written = 0;
+    bool good = true;
+};
+
+struct Bounds {
+    Vec3 min, max;
+    Bounds() : min(INFINITY, INFINITY, INFINITY), max(-INFINITY, -INFINITY, -INFINITY) {}
+    Bounds & operator+=(const Vec3 & v)
+    {
+        min = Vec3(std::min(min.x, v.x), std::min(min.y, v.y), std::min(min.z, v.z));
+        max = Vec3(std::max(max.x, v.x), std::max(max.y, v.y), std::max(max.z, v.z));
+        return *this;
+    }
+    Bounds & operator+=(const Bounds & b) { *this += b.min; *this += b.max; return *this; }
+};
+
+//--------------------------------------------------------------
+void MeshExporter::Capture::capture(const Canvas & canvas, bool quantize)
+{
+    width = canvas.width;
+    height = canvas.height;
+    count = canvas.size();
+    quantized = quantize;
+    topology = canvas.decimated() ? canvas.lod.topology : nullptr;
+    
+    const Vec3 * vertexes = canvas.animated_vertexes.data();
+    const Color * animated = canvas.animated_colors.data();
+    Bounds bounds = parallelReduce(count, Bounds(),
+        [&](size_t begin, size_t end) {
+            Bounds b;
+            for ( size_t v = begin; v < end; ++v ) b += vertexes[v];
+            return b;
+        },
+        [](Bounds a, const Bounds & b) { return a += b; });
+    min = count ? bounds.min : Vec3();
+    max = count ? bounds.max : Vec3();
+    
+    // Only the storage of the chosen precision is kept
+    if ( quantize ) { positions.release(); quantized_positions.resize(count * 3); }
+    else            { quantized_positions.release(); positions.resize(count); }
+    colors.resize(count);
+    Vec3 range = max - min;
+    Vec3 k(range.x > 0 ? 65535 / range.x : 0, range.y > 0 ? 65535 / range.y : 0, range.z > 0 ? 65535 / range.z : 0);
+    parallelFor(count, [&](size_t begin, size_t end) {
+        for ( size_t v = begin; v < end; ++v )
+        {
+            const Vec3 & p = vertexes[v];
+            if ( quantize )
+            {
+                uint16_t * q = quantized_positions.data() + v * 3;
+                q[0] = (uint16_t) ((p.x - min.x) * k.x + 0.5f);
+                q[1] = (uint16_t) ((p.y - min.y) * k.y + 0.5f);
+                q[2] = (uint16_t) ((p.z - min.z) * k.z + 0.5f);
+            }
+            else positions[v] = p;
+            
+            const Color & c = animated[v];
+            Color8 & c8 = colors[v];
+            c8.r = (unsigned char) (std::min(std::max(c.r, 0.f), 1.f) * 255 + 0.5f);
+            c8.g = (unsigned char) (std::min(std::max(c.g, 0.f), 1.f) * 255 + 0.5f);
+            c8.b = (unsigned char) (std::min(std::max(c.b, 0.f), 1.f) * 255 + 0.5f);
+            c8.a = (unsigned char) (std::min(std::max(c.a, 0.f), 1.f) * 255 + 0.5f);
+        }
+    });
+}
+size_t MeshExporter::Capture::faces() const
+{
+    if ( topology ) return topology->indices.size() / 3;
+    return width > 1 && height > 1 ? (size_t) 2 * (width - 1) * (height - 1) : 0;
+}
+// Fill triangles, in the order of the fill topology for full grids
+template<typename F>
+static void forEachFace(const MeshExporter::Capture & capture, F face)
+{
+    if ( capture.topology )
+    {
+        const Buffer<unsigned int> & indices = capture.topology->indices;
+        for ( size_t i = 0; i + 2 < indices.size(); i += 3 ) face(indices[i], indices[i+1], indices[i+2]);
+        return;
+    }
+    const uint32_t width = capture.width;
+    for ( uint32_t y = 0; y + 1 < (uint32_t) capture.height; ++y )
+    {
+        for ( uint32_t x = 0; x + 1 < width; ++x )
+        {
+            face(x + y * width, (x+1) + y * width, x + (y+1) * width);
+            face((x+1) + y * width, (x+1) + (y+1) * width, x + (y+1) * width);
+        }
+    }
+}
+//--------------------------------------------------------------
+static size_t writePly(const MeshExporter::Capture & capture, const std::string & path)
+{
+    ChunkWriter out(path);
+    char header[1024];
+    const char * type = capture.quantized ? "ushort" : "float";
+    int length = std::snprintf(header, sizeof(header),
+        "ply\nformat binary_little_endian 1.0\ncomment DepthPainter canvas %d x %d\n"
+        "comment bounds %.9g %.9g %.9g %.9g %.9g %.9g%s\n"
+        "element vertex %zu\nproperty %s x\nproperty %s y\nproperty %s z\n"
+        "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n"
+        "element face %zu\nproperty list uchar uint vertex_indices\nend_header\n",
+        capture.width, capture.height, capture.min.x, capture.min.y, capture.min.z, capture.max.x, capture.max.y, capture.max.z,
+        capture.quantized ? " (positions are min + (max - min) * value / 65535)" : "",
+        capture.count, type, type, type, capture.faces());
+    out.put(header, length);
+    
+    for ( size_t v = 0; v < capture.count; ++v )
+    {
+        if ( capture.quantized ) out.put(capture.quantized_positions.data() + v * 3, 3 * sizeof(uint16_t));
+        else                     out.put(capture.positions[v]);
+        out.put(capture.colors[v]);
+    }
+    forEachFace(capture, [&](uint32_t a, uint32_t b, uint32_t c) {
+        const unsigned char corners = 3;
+        out.put(corners);
+        out.put(a);
+        out.put(b);
+        out.put(c);
+    });
+    return out.close();
+}
+static size_t writeGlb(const MeshExporter::Capture & capture, const std::string & path)
+{
+    // Binary chunk: positions (quantized ones padded to 8 bytes), colours, indices
+    const size_t stride = capture.quantized ? 8 : 12;
+    const size_t positions_bytes = capture.count * stride, colors_bytes = capture.count * 4, indices_bytes = capture.faces() * 12;
+    const size_t binary_bytes = positions_bytes + colors_bytes + indices_bytes;
+    
+    // Quantized positions are normalized: the node maps [0,1] back to the bounds
+    Vec3 range = capture.max - capture.min;
+    Vec3 lo = capture.min, hi = capture.max;
+    std::string node = "{\"mesh\":0}", extensions;
+    char text[512];
+    if ( capture.quantized )
+    {
+        std::snprintf(text, sizeof(text), "{\"mesh\":0,\"translation\":[%.9g,%.9g,%.9g],\"scale\":[%.9g,%.9g,%.9g]}",
+                      capture.min.x, capture.min.y, capture.min.z, range.x > 0 ? range.x : 1, range.y > 0 ? range.y : 1, range.z > 0 ? range.z : 1);
+        node = text;
+        extensions = "\"extensionsUsed\":[\"KHR_mesh_quantization\"],\"extensionsRequired\":[\"KHR_mesh_quantization\"],";
+        lo = Vec3();
+        hi = Vec3(range.x > 0, range.y > 0, range.z > 0);
+    }
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"DepthPainter\"}," + extensions
+                     + "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[" + node + "],"
+                     + "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"COLOR_0\":1},\"indices\":2,\"mode\":4}]}],";
+    std::snprintf(text, sizeof(text), "\"buffers\":[{\"byteLength\":%zu}],\"bufferViews\":["
+                  "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"byteStride\":%zu,\"target\":34962},"
+                  "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"byteStride\":4,\"target\":34962},"
+                  "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34963}],",
+                  binary_bytes, positions_bytes, stride, positions_bytes, colors_bytes, positions_bytes + colors_bytes, indices_bytes);
+    json += text;
+    std::snprintf(text, sizeof(text), "\"accessors\":["
+                  "{\"bufferView\":0,\"componentType\":%d,%s\"count\":%zu,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+                  "{\"bufferView\":1,\"componentType\":5121,\"normalized\":true,\"count\":%zu,\"type\":\"VEC4\"},"
+                  "{\"bufferView\":2,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+                  capture.quantized ? 5123 : 5126, capture.quantized ? "\"normalized\":true," : "", capture.count,
+                  lo.x, lo.y, lo.z, hi.x, hi.y, hi.z, capture.count, capture.faces() * 3);
+    json += text;
+    json.append((4 - json.size() % 4) % 4, ' ');
+    
+    ChunkWriter out(path);
+    const uint32_t json_type = 0x4E4F534A, binary_type = 0x004E4942;
+    out.put((uint32_t) 0x46546C67);
+    out.put((uint32_t) 2);
+    out.put((uint32_t) (12 + 8 + json.size() + 8 + binary_bytes));
+    out.put((uint32_t) json.size());
+    out.put(json_type);
+    out.put(json.data(), json.size());
+    out.put((uint32_t) binary_bytes);
+    out.put(binary_type);
+    
+    if ( capture.quantized )
+    {
+        const uint16_t pad = 0;
+        for ( size_t v = 0; v < capture.count; ++v )
+        {
+            out.put(capture.quantized_positions.data() + v * 3, 3 * sizeof(uint16_t));
+            out.put(pad);
+        }
+    }
+    else for ( size_t v = 0; v < capture.count; ++v ) out.put(capture.positions[v]);
+    for ( size_t v = 0; v < capture.count; ++v ) out.put(capture.colors[v]);
+    forEachFace(capture, [&](uint32_t a, uint32_t b, uint32_t c) {
+        out.put(a);
+        out.put(b);
+        out.put(c);
+    });
+    return out.close();
+}
+size_t MeshExporter::write(const Capture & capture, const std::string & path, Format format)
+{
+    return format == FORMAT_PLY ? writePly(capture, path) : writeGlb(capture, path);
+}
+//--------------------------------------------------------------
+void MeshExporter::wait()
+{
+    if ( worker.joinable() ) worker.join();
+}
+void MeshExporter::launch(size_t total, const std::function<void()> & job)
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters = Progress();
+        counters.total = total;
+        start = std::chrono::steady_clock::now();
+    }
+    bCancel = false;
+    bBusy = true;
+    worker = std::thread([this, job] { job(); bBusy = false; });
+}
+void MeshExporter::written(size_t bytes, bool ok)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.written += ok;
+    counters.bytes += bytes;
+    counters.failed |= ! ok;
+    counters.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+MeshExporter::Progress MeshExporter::progress() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+bool MeshExporter::exportCanvas(const Canvas & canvas, const std::string & path, Format format, bool quantize)
+{
+    if ( bBusy ) return false;
+    wait();
+    capture.capture(canvas, quantize);
+    launch(1, [this, path, format] {
+        size_t bytes = write(capture, path, format);
+        written(bytes, bytes > 0);
+    });
+    return true;
+}
+bool MeshExporter::exportSequence(const FramePipeline::Decoder & decoder, const FramePipeline::Settings & settings, size_t frames,
+                                  const std::string & prefix, Format format, bool quantize)
+{
+    if ( bBusy ) return false;
+    launch(frames, [this, decoder, settings, frames, prefix, format, quantize] {
+        Canvas canvas;
+        canvas.strips = settings.strips;
+        canvas.render = settings.render;
+        canvas.lod_tolerance = settings.lod_tolerance;
+        FramePipeline::Frame frame;
+        for ( size_t f = 0; f < frames && ! bCancel; ++f )
+        {
+            if ( ! decoder(frame) ) { written(0, false); return; }
+            canvas.width = frame.width;
+            canvas.height = frame.height;
+            canvas.load(frame.image.data(), frame.depth.data(), frame.depth_channels, settings.show_depth);
+            canvas.project(settings.focal, settings.extrusion);
+            canvas.restore();
+            capture.capture(canvas, quantize);
+            
+            char name[32];
+            std::snprintf(name, sizeof(name), "_%05zu", f);
+            size_t bytes = write(capture, prefix + name + extension(format), format);
+            written(bytes, bytes > 0);
+        }
+    });
+    return true;
+}
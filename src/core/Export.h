@@ -0,0 +1,100 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include "Buffer.h"
+#include "Canvas.h"
+#include "Pipeline.h"
+
+// Mesh export of the canvas in binary PLY and glTF (.glb).
+// A capture packs what is drawn (animated vertexes and colours) at a fraction of the canvas memory: float or 16-bit
+// positions quantized over their bounds, and RGBA8 colours. Writers stream it in fixed size chunks. Faces are the
+// fill triangles of the grid, generated while writing, or the ones of the decimated mesh: no index buffer is built.
+// Quantized glTF uses KHR_mesh_quantization, with the node translation and scale mapping [0,1] back to the bounds.
+
+class MeshExporter
+{
+public:
+    
+    enum Format {
+        FORMAT_PLY = 0,
+        FORMAT_GLB
+    };
+    
+    struct Capture {
+        int width = 0, height = 0;
+        size_t count = 0;
+        bool quantized = false;
+        Vec3 min, max;                                  // bounds of the positions
+        Buffer<Vec3> positions;                         // float positions
+        Buffer<uint16_t> quantized_positions;           // x, y, z over the bounds
+        Buffer<Color8> colors;
+        std::shared_ptr<const Topology> topology;       // decimated mesh only, full grids are implicit
+        
+        void capture(const Canvas & canvas, bool quantize);
+        size_t faces() const;
+        size_t bytes() const { return positions.bytes() + quantized_positions.bytes() + colors.bytes(); }
+    };
+    
+    // Bytes written, 0 on failure
+    static size_t write(const Capture & capture, const std::string & path, Format format);
+    static const char * extension(Format format) { return format == FORMAT_PLY ? ".ply" : ".glb"; }
+    
+    struct Progress {
+        size_t written = 0, total = 0;                  // files
+        size_t bytes = 0;                               // of the last file
+        double ms = 0;                                  // since the export started
+        bool failed = false;
+    };
+    
+    ~MeshExporter() { cancel(); wait(); }
+    
+    // Captures the canvas now, and writes it from a thread. False while another export runs.
+    bool exportCanvas(const Canvas & canvas, const std::string & path, Format format, bool quantize);
+    // Decodes and projects 'frames' frames from a thread, writing them as 'prefix'_00000.ply and so on
+    bool exportSequence(const FramePipeline::Decoder & decoder, const FramePipeline::Settings & settings, size_t frames,
+                        const std::string & prefix, Format format, bool quantize);
+    bool busy() const { return bBusy; }
+    void cancel() { bCancel = true; }
+    void wait();
+    Progress progress() const;
+    
+private:
+    
+    void launch(size_t total, const std::function<void()> & job);
+    void written(size_t bytes, bool ok);
+    
+    Capture capture;
+    std::thread worker;
+    std::atomic<bool> bBusy { false }, bCancel { false };
+    mutable std::mutex mutex;
+    Progress counters;
+    std::chrono::steady_clock::time_point start;
+};
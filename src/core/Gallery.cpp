@@ -0,0 +1,316 @@
+#include <cmath>
+#include <set>
+#include <algorithm>
+#include "Gallery.h"
+#include "Culling.h"
+#include "Parallel.h"
+
+// Canvas memory per vertex of a full grid: rest and animated vertexes and colours, depth, rays and depth index
+static const size_t vertex_bytes = 2 * sizeof(Vec3) + sizeof(Color8) + sizeof(Color) + 3 * sizeof(float)
+                                 + sizeof(uint32_t) + sizeof(uint16_t);
+
+// Canvas to scene: translation * rotation around y * scale, column-major
+static void placement(const Gallery::Painting & painting, float m[16])
+{
+    const float pi = 3.14159265358979f;
+    const float c = std::cos(painting.yaw * pi / 180), s = std::sin(painting.yaw * pi / 180), k = painting.scale();
+    const float t[16] = {
+        c * k,  0,      -s * k, 0,
+        0,      k,      0,      0,
+        s * k,  0,      c * k,  0,
+        painting.position.x, painting.position.y, painting.position.z, 1
+    };
+    std::copy(t, t + 16, m);
+}
+
+//--------------------------------------------------------------
+int Gallery::add(int key, const Source & source)
+{
+    std::unique_ptr<Painting> painting(new Painting());
+    painting->key = key;
+    painting->source = source;
+    painting->canvas.render = render;
+    painting->canvas.strips = strips;
+    painting->animator.random.seed(Random::hash(seed, paintings.size()));
+    paintings.push_back(std::move(painting));
+    return paintings.size() - 1;
+}
+void Gallery::clear()
+{
+    paintings.clear();
+    image.release();
+    depth.release();
+    bOver = false;
+    grains = animated = 0;
+}
+int Gallery::find(int key) const
+{
+    for ( size_t p = 0; p < paintings.size(); ++p ) if ( paintings[p]->key == key ) return p;
+    return -1;
+}
+void Gallery::configure(RenderMode r, bool s)
+{
+    if ( r == render && s == strips ) return;
+    render = r;
+    strips = s;
+    for ( auto & painting : paintings )
+    {
+        painting->canvas.render = render;
+        painting->canvas.strips = strips;
+        if ( ! painting->canvas.size() ) continue;
+        painting->canvas.updateTopology();
+        ++painting->changes;
+    }
+}
+void Gallery::arrange()
+{
+    // The camera mirrors x (CameraPose::initial), so the first painting goes on the positive side to be seen on the left
+    float width = GALLERY_SPACING * (paintings.size() - 1.f);
+    for ( auto & painting : paintings ) width += painting->source.width;
+    float x = width * 0.5f;
+    for ( auto & painting : paintings )
+    {
+        painting->position = Vec3(x - painting->source.width * 0.5f, 0, 0);
+        painting->yaw = 0;
+        x -= painting->source.width + GALLERY_SPACING;
+    }
+}
+//--------------------------------------------------------------
+void Gallery::fit()
+{
+    // Greedy: the largest painting that can still be halved is, until the scene holds in both budgets.
+    // Paintings of the same size end up at close levels, so most of them share a topology.
+    for ( auto & painting : paintings ) painting->level = 0;
+    while ( true )
+    {
+        size_t vertexes = 0, bytes = 0, largest_size = 0;
+        std::set<std::pair<int, int>> sizes;
+        Painting * largest = nullptr;
+        for ( auto & painting : paintings )
+        {
+            const int width = painting->source.width >> painting->level, height = painting->source.height >> painting->level;
+            const size_t n = (size_t) width * height;
+            vertexes += n;
+            bytes += n * vertex_bytes;
+            if ( sizes.insert(std::make_pair(width, height)).second ) bytes += TopologyCache::count(width, height, render, strips) * sizeof(unsigned int);
+            if ( painting->external() || painting->level >= GALLERY_MAX_LEVEL || width < 4 || height < 4 ) continue;
+            if ( n > largest_size ) { largest = painting.get(); largest_size = n; }
+        }
+        bOver = vertexes > vertex_budget || bytes > memory_budget;
+        if ( ! bOver || ! largest ) break;
+        ++largest->level;
+    }
+    for ( auto & painting : paintings )
+        if ( ! painting->external() && painting->level != painting->loaded ) load(*painting);
+    image.release();
+    depth.release();
+}
+void Gallery::load(Painting & painting)
+{
+    const Source & source = painting.source;
+    const int level = painting.level, width = source.width >> level, height = source.height >> level;
+    
+    // Canvas buffers never shrink, so a smaller canvas starts from scratch to give the memory back
+    if ( painting.loaded >= 0 && level > painting.loaded ) painting.canvas = Canvas();
+    Canvas & canvas = painting.canvas;
+    canvas.render = render;
+    canvas.strips = strips;
+    canvas.width = width;
+    canvas.height = height;
+    if ( ! level ) canvas.load(source.image, source.depth, false);
+    else
+    {
+        // Box filter of 2^level x 2^level source pixels
+        const int s = 1 << level;
+        const uint32_t half = 1 << (2 * level - 1);
+        image.resize((size_t) width * height * 3);
+        depth.resize((size_t) width * height);
+        parallelFor(height, [&](size_t begin, size_t end) {
+            for ( size_t y = begin; y < end; ++y )
+            {
+                for ( int x = 0; x < width; ++x )
+                {
+                    uint32_t r = 0, g = 0, b = 0, d = 0;
+                    for ( int j = 0; j < s; ++j )
+                    {
+                        const size_t row = (y * s + j) * source.width + x * s;
+                        const unsigned char * rgb = source.image + row * 3;
+                        for ( int i = 0; i < s; ++i, rgb += 3 )
+                        {
+                            r += rgb[0];
+                            g += rgb[1];
+                            b += rgb[2];
+                            d += source.depth[row + i];
+                        }
+                    }
+                    const size_t pos = x + y * width;
+                    image[pos * 3    ] = (r + half) >> (2 * level);
+                    image[pos * 3 + 1] = (g + half) >> (2 * level);
+                    image[pos * 3 + 2] = (b + half) >> (2 * level);
+                    depth[pos] = (d + half) >> (2 * level);
+                }
+            }
+        });
+        canvas.load(image.data(), depth.data(), false);
+    }
+    
+    // Dividing focal and extrusion by the scale keeps the projected shape, in canvas units
+    painting.loaded = level;
+    canvas.project(painting.focal / painting.scale(), painting.extrusion / painting.scale());
+    canvas.updateTopology();
+    painting.animator.reset();
+    bound(painting);
+    ++painting.changes;
+}
+void Gallery::project(int index, float focal, float extrusion)
+{
+    Painting & painting = *paintings[index];
+    painting.focal = focal;
+    painting.extrusion = extrusion;
+    if ( painting.external() || painting.loaded < 0 ) return;
+    painting.canvas.project(focal / painting.scale(), extrusion / painting.scale());
+    bound(painting);
+    ++painting.changes;
+}
+void Gallery::refresh(int index)
+{
+    Painting & painting = *paintings[index];
+    painting.loaded = 0;
+    bound(painting);
+    ++painting.changes;
+}
+void Gallery::bound(Painting & painting)
+{
+    const Canvas & canvas = painting.canvas;
+    struct Box {
+        Vec3 low, high;
+        Box() : low(INFINITY, INFINITY, INFINITY), high(-INFINITY, -INFINITY, -INFINITY) {}
+        Box & operator+=(const Vec3 & v)
+        {
+            low = Vec3(std::min(low.x, v.x), std::min(low.y, v.y), std::min(low.z, v.z));
+            high = Vec3(std::max(high.x, v.x), std::max(high.y, v.y), std::max(high.z, v.z));
+            return *this;
+        }
+    };
+    Box box = parallelReduce(canvas.size(), Box(),
+        [&](size_t begin, size_t end) {
+            Box b;
+            for ( size_t v = begin; v < end; ++v ) b += canvas.vertexes[v];
+            return b;
+        },
+        [](Box a, const Box & b) { a += b.low; a += b.high; return a; });
+    if ( ! canvas.size() ) box.low = box.high = Vec3();
+    
+    // Animations displace the vertexes off their rest bounds
+    Vec3 size = box.high - box.low;
+    Vec3 margin = Vec3(1, 1, 1) * (GALLERY_BOUNDS_MARGIN * std::max(size.x, std::max(size.y, size.z)));
+    painting.low = box.low - margin;
+    painting.high = box.high + margin;
+}
+//--------------------------------------------------------------
+void Gallery::fire(int target, Animation animation)
+{
+    for ( size_t p = 0; p < paintings.size(); ++p )
+    {
+        if ( target != ALL && target != (int) p ) continue;
+        Painting & painting = *paintings[p];
+        if ( ! painting.canvas.size() ) continue;
+        switch ( animation )
+        {
+            case SYNAPSES:      painting.animator.fireSynapses(painting.canvas);   break;
+            case FLATTENING:    painting.animator.fireFlattening();                break;
+            case INCLUSION:     painting.animator.fireInclusion();                 break;
+            case NOISE:         painting.animator.fireNoise();                     break;
+        }
+    }
+}
+void Gallery::update(const float matrix[16], double now, float intensity)
+{
+    animated = 0;
+    for ( auto & p : paintings )
+    {
+        Painting & painting = *p;
+        Animator & animator = painting.animator;
+        animator.strengths = strengths;
+        painting.bVisible = painting.canvas.size() && visible(painting, matrix);
+        if ( ! painting.bVisible || animator.idle() )
+        {
+            // Paused: its simulation time passes without steps, effects resume where they were once seen again
+            animator.clock.advance(now);
+            continue;
+        }
+        animator.update(painting.canvas, now, intensity);
+        grains += animator.takeGrains();
+        ++painting.changes;
+        ++animated;
+    }
+}
+bool Gallery::visible(const Painting & painting, const float matrix[16]) const
+{
+    // Its bounds against the frustum in canvas units: matrix * placement
+    float t[16], m[16];
+    placement(painting, t);
+    for ( int c = 0; c < 4; ++c )
+        for ( int r = 0; r < 4; ++r )
+            m[c * 4 + r] = matrix[r] * t[c * 4] + matrix[4 + r] * t[c * 4 + 1] + matrix[8 + r] * t[c * 4 + 2] + matrix[12 + r] * t[c * 4 + 3];
+    return Frustum(m).intersects(painting.low, painting.high);
+}
+//--------------------------------------------------------------
+void Gallery::transform(int index, float m[16]) const
+{
+    placement(*paintings[index], m);
+}
+CameraPose Gallery::overview(float aspect) const
+{
+    CameraPose pose;
+    pose.scale = Vec3(-1, -1, 1);
+    pose.fov = CAMERA_INIT_FOV;
+    if ( paintings.empty() ) { pose.position = Vec3(0, 0, CAMERA_INIT_ZPOS); return pose; }
+    
+    // Scene bounds of every painting
+    Vec3 low(INFINITY, INFINITY, INFINITY), high(-INFINITY, -INFINITY, -INFINITY);
+    for ( auto & p : paintings )
+    {
+        const Painting & painting = *p;
+        float m[16];
+        placement(painting, m);
+        for ( int corner = 0; corner < 8; ++corner )
+        {
+            Vec3 v(corner & 1 ? painting.high.x : painting.low.x, corner & 2 ? painting.high.y : painting.low.y, corner & 4 ? painting.high.z : painting.low.z);
+            Vec3 w(m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12], m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13], m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14]);
+            low = Vec3(std::min(low.x, w.x), std::min(low.y, w.y), std::min(low.z, w.z));
+            high = Vec3(std::max(high.x, w.x), std::max(high.y, w.y), std::max(high.z, w.z));
+        }
+    }
+    
+    // Back along -z, as the initial pose, far enough for the whole wall to fit the viewport
+    const float pi = 3.14159265358979f;
+    const float t = std::tan(pi * pose.fov / 360);
+    const float distance = std::max((high.y - low.y) * 0.5f / t, (high.x - low.x) * 0.5f / (t * aspect));
+    pose.target = (low + high) * 0.5f;
+    pose.position = Vec3(pose.target.x, pose.target.y, low.z - distance);
+    pose.far_clip = (high.z - low.z + distance) * 4;
+    pose.near_clip = pose.far_clip / 1000;
+    return pose;
+}
+Gallery::Stats Gallery::stats() const
+{
+    Stats s;
+    s.paintings = paintings.size();
+    s.animated = animated;
+    s.vertex_budget = vertex_budget;
+    s.memory_budget = memory_budget;
+    s.bOver = bOver;
+    std::set<const Topology *> topologies;
+    for ( auto & painting : paintings )
+    {
+        const Canvas & canvas = painting->canvas;
+        s.visible += painting->bVisible;
+        s.vertexes += canvas.size();
+        size_t indices = canvas.topology ? canvas.topology->indices.bytes() : 0;
+        s.bytes += canvas.bytes() - indices + painting->animator.synapses.bytes() + painting->animator.displacement.bytes();
+        if ( canvas.topology && topologies.insert(canvas.topology.get()).second ) s.bytes += indices;
+    }
+    s.topologies = topologies.size();
+    return s;
+}
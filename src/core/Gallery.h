@@ -0,0 +1,131 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include "Animator.h"
+#include "Canvas.h"
+#include "Pose.h"
+#include "Settings.h"
+
+// Several paintings placed in one scene, each one a canvas with its own placement, projection and animations.
+// They share a vertex and a memory budget: a painting is loaded from its source downsampled by 2^level, and fit()
+// raises the level of the largest ones until the whole scene holds in both. Canvases of the same size share their
+// topology (TopologyCache). update() only animates visible paintings with an effect running, the others cost nothing.
+
+class Gallery
+{
+public:
+    
+    // Colour and 16-bit depth of a painting at full resolution, kept alive by 'owner'.
+    // Without an image the canvas is fed by the caller (a video) at its own size, and only counted in the budget.
+    struct Source {
+        int width = 0, height = 0;
+        const unsigned char * image = nullptr;
+        const uint16_t * depth = nullptr;
+        std::shared_ptr<const void> owner;
+    };
+    
+    struct Painting {
+        int key = -1;                       // of the caller
+        Source source;
+        Vec3 position;                      // of the canvas centre in the scene
+        float yaw = 0;                      // degrees, around the vertical
+        float focal = CAMERA_INIT_FOCAL, extrusion = CANVAS_INIT_EXTRUSION;
+        int level = 0;                      // planned by fit()
+        int loaded = -1;                    // level the canvas holds, -1 for none
+        Canvas canvas;
+        Animator animator;
+        bool bVisible = false;
+        size_t changes = 0;                 // renewed whenever the animated buffers change
+        Vec3 low, high;                     // canvas bounds, margin for the animations included
+        
+        bool external() const { return ! source.image; }
+        float scale() const { return (float) (1 << std::max(loaded, 0)); }     // canvas to scene units
+    };
+    
+    enum { ALL = -1 };
+    enum Animation { SYNAPSES, FLATTENING, INCLUSION, NOISE };
+    
+    struct Stats {
+        size_t paintings = 0, visible = 0, animated = 0;
+        size_t vertexes = 0, bytes = 0;     // loaded, a shared topology counted once
+        size_t topologies = 0;
+        size_t vertex_budget = 0, memory_budget = 0;
+        bool bOver = false;                 // over a budget even at the lowest resolutions
+    };
+    
+    Gallery() : vertex_budget(GALLERY_VERTEX_BUDGET), memory_budget(GALLERY_MEMORY_BUDGET) {}
+    
+    void setBudget(size_t vertexes, size_t bytes) { vertex_budget = vertexes; memory_budget = bytes; }
+    void configure(RenderMode render, bool strips);
+    int add(int key, const Source & source);
+    void clear();
+    // Side by side on a wall, GALLERY_SPACING apart, centred on the origin
+    void arrange();
+    // Plans the levels within the budgets and reloads the paintings whose level changed
+    void fit();
+    void project(int index, float focal, float extrusion);
+    // An external canvas was fed
+    void refresh(int index);
+    
+    // On one painting or on ALL of them
+    void fire(int target, Animation animation);
+    // Culls the paintings against the projection * view matrix of the frame (column-major), then animates the visible ones
+    void update(const float matrix[16], double now, float intensity);
+    size_t takeGrains() { size_t g = grains; grains = 0; return g; }
+    
+    // Canvas to scene transform of a painting, column-major
+    void transform(int index, float m[16]) const;
+    // Pose looking at the whole scene in a viewport of 'aspect' width / height
+    CameraPose overview(float aspect) const;
+    
+    size_t size() const { return paintings.size(); }
+    Painting & operator[](size_t index) { return *paintings[index]; }
+    const Painting & operator[](size_t index) const { return *paintings[index]; }
+    int find(int key) const;
+    Stats stats() const;
+    
+    uint32_t seed = 1;
+    Animator::Strengths strengths;          // of the animators of every painting
+    
+private:
+    
+    void load(Painting & painting);
+    void bound(Painting & painting);
+    bool visible(const Painting & painting, const float matrix[16]) const;
+    
+    std::vector<std::unique_ptr<Painting>> paintings;
+    size_t vertex_budget, memory_budget;
+    RenderMode render = RENDER_WIREFRAME;
+    bool strips = false;
+    bool bOver = false;
+    size_t grains = 0, animated = 0;
+    
+    // Downsampled source of the painting being loaded
+    Buffer<unsigned char> image;
+    Buffer<uint16_t> depth;
+};
@@ -0,0 +1,107 @@
+#include <cmath>
+#include <algorithm>
+#include "Grains.h"
+#include "Settings.h"
+
+//--------------------------------------------------------------
+void GrainEngine::setup(std::shared_ptr<const Pcm> source, int output_rate, uint64_t seed)
+{
+    sample = source;
+    rate = output_rate;
+    random.seed(seed);
+    fade = std::max<size_t>(1, GRAIN_FADE * rate);
+    tokens = GRAIN_MAX_PER_FRAME;
+    last = -1;
+    ring.clear();
+    for ( Voice & v : voices ) v.bActive = false;
+    requested = started = limited = stolen = dropped = active = 0;
+}
+size_t GrainEngine::trigger(size_t count, double now)
+{
+    if ( ! count || ! sample || ! sample->samples.size() || ! rate ) return 0;
+    requested += count;
+    
+    // Token bucket: GRAIN_MAX_RATE per second, bursts of GRAIN_MAX_PER_FRAME
+    if ( last >= 0 ) tokens = std::min<double>(tokens + (now - last) * GRAIN_MAX_RATE, GRAIN_MAX_PER_FRAME);
+    last = now;
+    size_t granted = std::min<size_t>(std::min<size_t>(count, GRAIN_MAX_PER_FRAME), (size_t) tokens);
+    tokens -= granted;
+    limited += count - granted;
+    
+    // A slow and a fast voice per grain, from the first 60% of the sample
+    const double resampling = sample->rate / (double) rate;
+    for ( size_t g = 0; g < granted; ++g )
+    {
+        double position = 0.6 * random.uf() * sample->samples.size();
+        for ( int v = 0; v < 2; ++v )
+        {
+            Voice voice;
+            float pan = (random.f() + 1) * float(M_PI / 4);
+            voice.position = position;
+            voice.speed = (v ? random.range(4, 20) : random.range(0.7f, 4)) * resampling;
+            voice.left = std::cos(pan);
+            voice.right = std::sin(pan);
+            voice.bActive = true;
+            if ( ! ring.push(voice) ) ++dropped;
+        }
+    }
+    started += granted;
+    return granted;
+}
+//--------------------------------------------------------------
+void GrainEngine::mix(float * out, size_t frames)
+{
+    std::fill(out, out + 2 * frames, 0.f);
+    if ( ! sample ) return;
+    
+    // New voices into free slots, else over the one played the longest
+    Voice voice;
+    while ( ring.pop(voice) )
+    {
+        Voice * slot = std::find_if(std::begin(voices), std::end(voices), [](const Voice & v) { return ! v.bActive; });
+        if ( slot == std::end(voices) )
+        {
+            slot = std::max_element(std::begin(voices), std::end(voices), [](const Voice & a, const Voice & b) { return a.played < b.played; });
+            ++stolen;
+        }
+        *slot = voice;
+    }
+    
+    // Linear interpolation, faded in and out
+    const float * source = sample->samples.data();
+    const double length = sample->samples.size() - 1;
+    const float inv_fade = 1.f / fade;
+    size_t playing = 0;
+    for ( Voice & v : voices )
+    {
+        if ( ! v.bActive ) continue;
+        size_t remaining = v.position < length ? (size_t) ((length - v.position) / v.speed) : 0;
+        size_t n = std::min(frames, remaining);
+        for ( size_t f = 0; f < n; ++f )
+        {
+            size_t i = (size_t) v.position;
+            float t = v.position - i;
+            float s = source[i] + (source[i + 1] - source[i]) * t;
+            float envelope = std::min(1.f, std::min(v.played + f, remaining - f) * inv_fade);
+            out[2 * f]     += s * envelope * v.left;
+            out[2 * f + 1] += s * envelope * v.right;
+            v.position += v.speed;
+        }
+        v.played += n;
+        v.bActive = n < remaining;
+        playing += v.bActive;
+    }
+    for ( size_t s = 0; s < 2 * frames; ++s ) out[s] = std::min(std::max(out[s], -1.f), 1.f);
+    active = playing;
+}
+GrainEngine::Stats GrainEngine::stats() const
+{
+    Stats s;
+    s.requested = requested;
+    s.started = started;
+    s.limited = limited;
+    s.stolen = stolen;
+    s.dropped = dropped;
+    s.active = active;
+    return s;
+}
@@ -0,0 +1,78 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "Audio.h"
+#include "Random.h"
+#include "Ring.h"
+
+// Granular voices of a short sample, mixed into stereo buffers. The render thread asks for grains, limited to
+// GRAIN_MAX_PER_FRAME at once and GRAIN_MAX_RATE per second (a token bucket); every grain is two voices, at a low
+// and a high speed, from a random position and pan, as the app played them. The voices are handed to the mixing
+// (audio) thread through a lock-free ring and played by a fixed pool of GRAIN_VOICES, the oldest one being stolen
+// when it is full. Mixing the same requests gives the same samples, so grains can also be rendered offline.
+
+class GrainEngine
+{
+public:
+    
+    // Output sample rate, and the seed of the grain parameters. Not while mixing.
+    void setup(std::shared_ptr<const Pcm> sample, int rate, uint64_t seed = 1);
+    
+    // Render thread: 'count' grains wanted at time 'now' (s), the number started
+    size_t trigger(size_t count, double now);
+    
+    // Mixing thread: writes 'frames' interleaved stereo samples
+    void mix(float * out, size_t frames);
+    
+    struct Stats {
+        size_t requested = 0, started = 0, limited = 0, stolen = 0, dropped = 0, active = 0;
+    };
+    Stats stats() const;
+    
+private:
+    
+    struct Voice {
+        double position = 0, speed = 0;     // in samples of the source
+        float left = 0, right = 0;          // pan gains
+        size_t played = 0;                  // output samples
+        bool bActive = false;
+    };
+    
+    std::shared_ptr<const Pcm> sample;
+    int rate = 0;
+    Random random;
+    
+    // Render thread
+    double tokens = 0, last = -1;
+    
+    // Mixing thread
+    SpscRing<Voice> ring { 4 * GRAIN_VOICES };
+    Voice voices[GRAIN_VOICES];
+    size_t fade = 1;                        // output samples
+    
+    std::atomic<size_t> requested { 0 }, started { 0 }, limited { 0 }, stolen { 0 }, dropped { 0 }, active { 0 };
+};
@@ -0,0 +1,191 @@
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Lod.h"
+#include "Parallel.h"
+
+// Depth statistics of a quadtree node: the pixels at the top-left corner of each of its cells
+struct Stats {
+    double sum = 0, squares = 0;
+    uint32_t count = 0;
+    bool merged = false;            // the node is a single block so far
+    Stats & operator+=(const Stats & s) { sum += s.sum; squares += s.squares; count += s.count; return *this; }
+    double variance() const { return count ? squares / count - (sum / count) * (sum / count) : 0; }
+};
+
+struct Quadtree {
+    const float * depths;
+    int width, cells_x, cells_y;
+    double tolerance;
+    std::vector<uint32_t> leaves;   // x, y, size
+    
+    void emit(uint32_t x, uint32_t y, uint32_t size) { leaves.push_back(x); leaves.push_back(y); leaves.push_back(size); }
+    
+    // Children are merged bottom-up; a node that cannot merge emits its merged children as blocks
+    Stats node(int x0, int y0, int size)
+    {
+        Stats stats;
+        if ( x0 >= cells_x || y0 >= cells_y ) return stats;
+        if ( size == 1 )
+        {
+            float d = depths[(size_t) y0 * width + x0];
+            stats.sum = d;
+            stats.squares = d * d;
+            stats.count = 1;
+            stats.merged = true;
+            return stats;
+        }
+        int half = size / 2;
+        Stats children[4] = { node(x0, y0, half), node(x0 + half, y0, half), node(x0, y0 + half, half), node(x0 + half, y0 + half, half) };
+        bool merged = x0 + size <= cells_x && y0 + size <= cells_y;
+        for ( const Stats & c : children ) { stats += c; merged = merged && c.merged; }
+        if ( merged && stats.variance() <= tolerance ) { stats.merged = true; return stats; }
+        
+        for ( int c = 0; c < 4; ++c )
+            if ( children[c].merged ) emit(x0 + (c & 1) * half, y0 + (c >> 1) * half, half);
+        return stats;
+    }
+};
+
+static inline bool marked(const uint64_t * mask, size_t pixel) { return mask[pixel >> 6] >> (pixel & 63) & 1; }
+static inline void mark(uint64_t * mask, size_t pixel)         { mask[pixel >> 6] |= 1ULL << (pixel & 63); }
+
+// Visits the vertexes on the boundary of a block, clockwise from its top-left corner
+template<typename Visit>
+static void boundary(const uint64_t * mask, int width, uint32_t x0, uint32_t y0, uint32_t size, const Visit & visit)
+{
+    const size_t w = width;
+    for ( uint32_t x = x0; x < x0 + size; ++x )  { size_t p = y0 * w + x;          if ( marked(mask, p) ) visit(p); }
+    for ( uint32_t y = y0; y < y0 + size; ++y )  { size_t p = y * w + x0 + size;   if ( marked(mask, p) ) visit(p); }
+    for ( uint32_t x = x0 + size; x > x0; --x )  { size_t p = (y0 + size) * w + x; if ( marked(mask, p) ) visit(p); }
+    for ( uint32_t y = y0 + size; y > y0; --y )  { size_t p = y * w + x0;          if ( marked(mask, p) ) visit(p); }
+}
+
+//--------------------------------------------------------------
+void LodMesh::build(const float * depths, int w, int h, float tolerance)
+{
+    auto start = std::chrono::steady_clock::now();
+    width = w;
+    height = h;
+    const size_t n = (size_t) w * h;
+    const int cells_x = w - 1, cells_y = h - 1;
+    if ( cells_x < 1 || cells_y < 1 ) { clear(); return; }
+    
+    // Quadtree blocks, one row of root tiles per task
+    const int tiles_x = (cells_x + max_block - 1) / max_block;
+    const int tiles_y = (cells_y + max_block - 1) / max_block;
+    std::vector<std::vector<uint32_t>> tile_rows(tiles_y);
+    parallelFor(tiles_y, [&](size_t begin, size_t end) {
+        for ( size_t ty = begin; ty < end; ++ty )
+        {
+            Quadtree tree = { depths, w, cells_x, cells_y, tolerance, {} };
+            for ( int tx = 0; tx < tiles_x; ++tx )
+            {
+                Stats root = tree.node(tx * max_block, ty * max_block, max_block);
+                if ( root.merged ) tree.emit(tx * max_block, ty * max_block, max_block);
+            }
+            tile_rows[ty].swap(tree.leaves);
+        }
+    }, 1);
+    blocks = 0;
+    for ( const auto & r : tile_rows ) blocks += r.size() / 3;
+    leaves.resize(blocks);
+    size_t b = 0;
+    for ( const auto & r : tile_rows )
+        for ( size_t i = 0; i < r.size(); i += 3, ++b ) leaves[b] = Block{ r[i], r[i + 1], r[i + 2], 2 };
+    
+    // Vertexes: every block corner, plus the centre of blocks with vertexes of smaller neighbours on their edges
+    mask.resize((n + 63) / 64);
+    std::fill(mask.begin(), mask.end(), 0);
+    for ( const Block & l : leaves )
+    {
+        mark(mask.data(), (size_t) l.y * w + l.x);
+        mark(mask.data(), (size_t) l.y * w + l.x + l.size);
+        mark(mask.data(), (size_t) (l.y + l.size) * w + l.x);
+        mark(mask.data(), (size_t) (l.y + l.size) * w + l.x + l.size);
+    }
+    parallelFor(blocks, [&](size_t begin, size_t end) {
+        for ( size_t i = begin; i < end; ++i )
+        {
+            Block & l = leaves[i];
+            if ( l.size < 2 ) continue;
+            uint32_t count = 0;
+            boundary(mask.data(), w, l.x, l.y, l.size, [&](size_t) { ++count; });
+            if ( count > 4 ) l.triangles = count;
+        }
+    });
+    for ( const Block & l : leaves )
+        if ( l.triangles > 2 ) mark(mask.data(), (size_t) (l.y + l.size / 2) * w + l.x + l.size / 2);
+    
+    ranks.resize(mask.size());
+    uint32_t total = 0;
+    for ( size_t i = 0; i < mask.size(); ++i ) { ranks[i] = total; total += std::bitset<64>(mask[i]).count(); }
+    
+    // Vertex pixels in raster order, row by row
+    rows.resize(h + 1);
+    pixels.resize(total);
+    parallelFor(h, [&](size_t begin, size_t end) {
+        for ( size_t y = begin; y < end; ++y )
+        {
+            size_t p = y * w;
+            uint32_t v = ranks[p >> 6] + std::bitset<64>(mask[p >> 6] & ((1ULL << (p & 63)) - 1)).count();
+            rows[y] = v;
+            for ( ; p < (y + 1) * w; ++p )
+                if ( marked(mask.data(), p) ) pixels[v++] = p;
+        }
+    });
+    rows[h] = total;
+    
+    // Triangles, same winding as the full grid
+    offsets.resize(blocks + 1);
+    offsets[0] = 0;
+    for ( size_t i = 0; i < blocks; ++i ) offsets[i + 1] = offsets[i] + 3 * leaves[i].triangles;
+    if ( ! topology || topology.use_count() > 1 ) topology = std::make_shared<Topology>();
+    topology->width = w;
+    topology->height = h;
+    topology->primitive = PRIMITIVE_TRIANGLES;
+    topology->indices.resize(offsets[blocks]);
+    parallelFor(blocks, [&](size_t begin, size_t end) {
+        std::vector<unsigned int> fan;
+        for ( size_t i = begin; i < end; ++i )
+        {
+            const Block & l = leaves[i];
+            unsigned int * index = topology->indices.data() + offsets[i];
+            const size_t top = (size_t) l.y * w, bottom = (size_t) (l.y + l.size) * w;
+            if ( l.triangles == 2 )
+            {
+                unsigned int tl = vertexAt(top + l.x), tr = vertexAt(top + l.x + l.size);
+                unsigned int bl = vertexAt(bottom + l.x), br = vertexAt(bottom + l.x + l.size);
+                *index++ = tl; *index++ = tr; *index++ = bl;
+                *index++ = tr; *index++ = br; *index++ = bl;
+                continue;
+            }
+            fan.clear();
+            boundary(mask.data(), w, l.x, l.y, l.size, [&](size_t p) { fan.push_back(vertexAt(p)); });
+            unsigned int centre = vertexAt((size_t) (l.y + l.size / 2) * w + l.x + l.size / 2);
+            for ( size_t f = 0; f < fan.size(); ++f )
+            {
+                *index++ = fan[f];
+                *index++ = fan[(f + 1) % fan.size()];
+                *index++ = centre;
+            }
+        }
+    });
+    
+    build_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+void LodMesh::clear()
+{
+    pixels.clear();
+    rows.clear();
+    mask.clear();
+    ranks.clear();
+    leaves.clear();
+    topology.reset();
+    blocks = 0;
+}
+size_t LodMesh::bytes() const
+{
+    return pixels.bytes() + rows.bytes() + mask.bytes() + ranks.bytes() + leaves.bytes() + offsets.bytes()
+         + (topology ? topology->indices.bytes() : 0);
+}
@@ -0,0 +1,74 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <cstdint>
+#include <bitset>
+#include <memory>
+#include "Buffer.h"
+#include "Topology.h"
+
+// Adaptive mesh of a depth map (level of detail).
+// A quadtree of square blocks of cells, up to 'max_block' cells wide, merged while the variance of the depth
+// inside stays under a tolerance. Vertexes are the block corners, in raster order. Blocks with smaller
+// neighbours are fanned from their centre through every vertex on their boundary, so the mesh has no cracks.
+
+class LodMesh
+{
+public:
+    
+    void build(const float * depths, int width, int height, float tolerance);
+    void clear();
+    size_t bytes() const;
+    
+    size_t size() const { return pixels.size(); }
+    // Vertex at a pixel, -1 when the pixel was merged away
+    int vertexAt(size_t pixel) const
+    {
+        uint64_t word = mask[pixel >> 6], bit = 1ULL << (pixel & 63);
+        if ( ! (word & bit) ) return -1;
+        return ranks[pixel >> 6] + std::bitset<64>(word & (bit - 1)).count();
+    }
+    
+    static const int max_block = 64;
+    
+    int width = 0, height = 0;
+    Buffer<uint32_t> pixels;                // pixel of every vertex
+    Buffer<uint32_t> rows;                  // first vertex of every pixel row, plus the end
+    std::shared_ptr<Topology> topology;     // triangle list
+    size_t blocks = 0;
+    double build_time = 0;                  // ms
+    
+private:
+    
+    struct Block {
+        uint32_t x, y, size;
+        uint32_t triangles;                 // 2, or the boundary vertexes of a fan
+    };
+    
+    Buffer<uint64_t> mask;                  // one bit per pixel, set on vertexes
+    Buffer<uint32_t> ranks;                 // vertexes before every mask word
+    Buffer<Block> leaves;
+    Buffer<size_t> offsets;
+};
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstdlib>
+#include "Parallel.h"
+
+static thread_local bool inside_worker = false;
+
+//--------------------------------------------------------------
+Parallel & Parallel::pool()
+{
+    static Parallel instance;
+    return instance;
+}
+Parallel::Parallel()
+{
+    // DEPTHPAINTER_THREADS overrides the core count, e.g. to measure scaling
+    unsigned int n = std::thread::hardware_concurrency();
+    if ( const char * env = std::getenv("DEPTHPAINTER_THREADS") ) n = std::max(1, std::atoi(env));
+    for (unsigned int t = 1; t < n; ++t)
+        workers.emplace_back(&Parallel::work, this);
+}
+Parallel::~Parallel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto & w : workers) w.join();
+}
+size_t Parallel::grain(size_t count) const
+{
+    // A few chunks per thread balances uneven rows without much scheduling overhead
+    return std::max<size_t>(1, count / (threads() * 4));
+}
+//--------------------------------------------------------------
+void Parallel::run(size_t count, size_t grain, const Body & body)
+{
+    if ( ! count ) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t nChunks = chunks(count, grain);
+    
+    if ( inside_worker || workers.empty() || nChunks == 1 )
+    {
+        for (size_t c = 0; c < nChunks; ++c) body(c, c * grain, std::min(count, (c + 1) * grain));
+        return;
+    }
+    
+    Job job(body, count, grain, nChunks);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(&job);
+    }
+    wake.notify_all();
+    
+    while ( step(job) ) {}
+    
+    // The job lives on this stack: wait for the workers still inside one of its chunks
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]{ return job.pending == 0 && job.helpers == 0; });
+    jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+}
+bool Parallel::step(Job & job)
+{
+    size_t c = job.next++;
+    if ( c >= job.chunks ) return false;
+    (*job.body)(c, c * job.grain, std::min(job.count, (c + 1) * job.grain));
+    --job.pending;
+    return true;
+}
+Parallel::Job * Parallel::pick() const
+{
+    Job * picked = nullptr;
+    for ( Job * job : jobs )
+        if ( job->next < job->chunks && ( ! picked || job->helpers < picked->helpers ) ) picked = job;
+    return picked;
+}
+void Parallel::work()
+{
+    inside_worker = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    while ( true )
+    {
+        // One chunk at a time, so the workers spread again over the jobs after every chunk
+        Job * job = nullptr;
+        wake.wait(lock, [&]{ return stop || (job = pick()) != nullptr; });
+        if ( stop ) return;
+        ++job->helpers;
+        lock.unlock();
+        step(*job);
+        lock.lock();
+        --job->helpers;
+        if ( job->pending == 0 ) done.notify_all();
+    }
+}
@@ -0,0 +1,102 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Persistent worker pool for the row-parallel kernels of the core.
+// The calling thread takes part in the work and nested calls simply run inline. Calls from several threads at once
+// (the frame loop beside the pipeline, cache or exporter threads) share the workers: every chunk a worker picks
+// goes to the job with the fewest workers on it, so a background job does not leave the frame loop on its own.
+
+class Parallel
+{
+public:
+    
+    typedef std::function<void(size_t chunk, size_t begin, size_t end)> Body;
+    
+    static Parallel & pool();
+    
+    size_t threads() const { return workers.size() + 1; }
+    size_t chunks(size_t count, size_t grain) const { return grain ? (count + grain - 1) / grain : 0; }
+    size_t grain(size_t count) const;
+    
+    // Runs body over [0,count) split in chunks of 'grain' items, returns when all of them are done
+    void run(size_t count, size_t grain, const Body & body);
+    
+    Parallel(const Parallel &) = delete;
+    Parallel & operator=(const Parallel &) = delete;
+    ~Parallel();
+    
+private:
+    
+    struct Job {
+        const Body * body;
+        size_t count, grain, chunks;
+        std::atomic<size_t> next, pending;
+        size_t helpers = 0;                 // workers running one of its chunks, under 'mutex'
+        Job(const Body & body, size_t count, size_t grain, size_t chunks) : body(&body), count(count), grain(grain), chunks(chunks), next(0), pending(chunks) {}
+    };
+    
+    Parallel();
+    void work();
+    // Runs the next chunk of the job, false when none is left
+    static bool step(Job & job);
+    // Job with chunks left and the fewest workers on it, under 'mutex'
+    Job * pick() const;
+    
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::vector<Job *> jobs;
+    bool stop = false;
+};
+
+// Runs body(begin, end) over [0,count) in parallel
+inline void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)> & body, size_t grain = 0)
+{
+    Parallel & pool = Parallel::pool();
+    if ( ! grain ) grain = pool.grain(count);
+    pool.run(count, grain, [&body](size_t, size_t begin, size_t end) { body(begin, end); });
+}
+
+// Reduces body(begin, end) partial results over [0,count) with join(a, b), in chunk order
+template<typename T, typename Body, typename Join>
+T parallelReduce(size_t count, const T & identity, const Body & body, const Join & join, size_t grain = 0)
+{
+    Parallel & pool = Parallel::pool();
+    if ( ! grain ) grain = pool.grain(count);
+    std::vector<T> partial(pool.chunks(count, grain), identity);
+    pool.run(count, grain, [&](size_t chunk, size_t begin, size_t end) { partial[chunk] = body(begin, end); });
+    T result = identity;
+    for (const T & p : partial) result = join(result, p);
+    return result;
+}
@@ -0,0 +1,156 @@
+#include "Pipeline.h"
+
+//--------------------------------------------------------------
+void FramePipeline::start(const Decoder & d, double t, size_t ring_size)
+{
+    stop();
+    decoder = d;
+    frame_time = t;
+    counters = Stats();
+    
+    ring.resize(std::max<size_t>(ring_size, 1));
+    ring_stamps.resize(ring.size());
+    free_frames.clear();
+    decoded_frames.clear();
+    for ( size_t f = 0; f < ring.size(); ++f ) free_frames.push_back(f);
+    
+    // One canvas being projected, one ready; the render thread holds a third one
+    canvases.resize(2);
+    canvas_stamps.resize(canvases.size());
+    canvas_frames.resize(canvases.size());
+    free_canvases.clear();
+    for ( size_t c = 0; c < canvases.size(); ++c ) free_canvases.push_back(c);
+    ready = -1;
+    
+    bStop = false;
+    threads.emplace_back(&FramePipeline::decode, this);
+    threads.emplace_back(&FramePipeline::project, this);
+}
+void FramePipeline::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bStop = true;
+    }
+    changed.notify_all();
+    for ( std::thread & t : threads ) t.join();
+    threads.clear();
+}
+void FramePipeline::configure(const Settings & s)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    settings = s;
+}
+FramePipeline::Stats FramePipeline::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+//--------------------------------------------------------------
+bool FramePipeline::swap(Canvas & canvas)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( ready < 0 ) return false;
+        std::swap(canvas, canvases[ready]);
+        free_canvases.push_back(ready);
+        ++counters.presented;
+        counters.frame = canvas_frames[ready];
+        counters.latency = std::chrono::duration<double, std::milli>(Clock::now() - canvas_stamps[ready]).count();
+        ready = -1;
+    }
+    changed.notify_all();
+    return true;
+}
+//--------------------------------------------------------------
+// Decode thread: one frame per frame time, as long as the ring has room
+void FramePipeline::decode()
+{
+    Clock::time_point next = Clock::now();
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(frame_time));
+    while ( true )
+    {
+        size_t f;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait_until(lock, next, [&] { return bStop; });
+            changed.wait(lock, [&] { return bStop || ! free_frames.empty(); });
+            if ( bStop ) return;
+            f = free_frames.front();
+            free_frames.pop_front();
+        }
+        
+        // Late frames are not caught up with a burst
+        Clock::time_point now = Clock::now();
+        next = std::max(next + period, now);
+        bool decoded = decoder(ring[f]);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - now).count();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if ( decoded )
+            {
+                ring_stamps[f] = now;
+                decoded_frames.push_back(f);
+                ++counters.decoded;
+                counters.decode = ms;
+            }
+            else free_frames.push_front(f);
+        }
+        changed.notify_all();
+    }
+}
+// Projection thread: newest decoded frame into a free canvas, older ones are dropped
+void FramePipeline::project()
+{
+    while ( true )
+    {
+        size_t f, c;
+        Settings s;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return bStop || ( ! decoded_frames.empty() && ! free_canvases.empty() ); });
+            if ( bStop ) return;
+            while ( decoded_frames.size() > 1 )
+            {
+                free_frames.push_back(decoded_frames.front());
+                decoded_frames.pop_front();
+                ++counters.dropped;
+            }
+            f = decoded_frames.front();
+            decoded_frames.pop_front();
+            c = free_canvases.front();
+            free_canvases.pop_front();
+            s = settings;
+        }
+        changed.notify_all();
+        
+        Clock::time_point start = Clock::now();
+        const Frame & frame = ring[f];
+        Canvas & canvas = canvases[c];
+        canvas.width = frame.width;
+        canvas.height = frame.height;
+        canvas.render = s.render;
+        canvas.strips = s.strips;
+        canvas.lod_tolerance = s.lod_tolerance;
+        canvas.load(frame.image.data(), frame.depth.data(), frame.depth_channels, s.show_depth);
+        canvas.updateTopology();
+        canvas.project(s.focal, s.extrusion);
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            canvas_stamps[c] = ring_stamps[f];
+            canvas_frames[c] = frame.index;
+            free_frames.push_back(f);
+            if ( ready >= 0 )
+            {
+                free_canvases.push_back(ready);
+                ++counters.dropped;
+            }
+            ready = c;
+            ++counters.projected;
+            counters.projection = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        changed.notify_all();
+    }
+}
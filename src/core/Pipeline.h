@@ -0,0 +1,104 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "Buffer.h"
+#include "Canvas.h"
+
+// Two-stage video pipeline: a decode thread fills a ring of preallocated frames with matched colour/depth pairs,
+// paced at the clip frame rate, and a projection thread turns the newest one into a canvas. The render thread
+// only swaps that canvas in. Stale frames are dropped rather than queued, so latency stays bounded by the ring.
+
+class FramePipeline
+{
+public:
+    
+    struct Frame {
+        Buffer<unsigned char> image, depth;     // RGB, and depth with 'depth_channels' bytes per pixel
+        int width = 0, height = 0, depth_channels = 1;
+        size_t index = 0;                       // frame number in the clip, the same for colour and depth
+    };
+    // Called from the decode thread: fills the next colour/depth pair, false when there is none yet
+    typedef std::function<bool(Frame & frame)> Decoder;
+    
+    // Canvas settings the frames are projected with
+    struct Settings {
+        float focal = 0, extrusion = 0;
+        bool show_depth = false, strips = false;
+        RenderMode render = RENDER_WIREFRAME;
+        float lod_tolerance = 0;
+    };
+    
+    struct Stats {
+        size_t decoded = 0, projected = 0, presented = 0, dropped = 0;
+        size_t frame = 0;                       // clip frame of the last presented canvas
+        double latency = 0;                     // ms from decoding to presentation, last presented canvas
+        double decode = 0, projection = 0;      // ms taken by the last decoded frame and the last projected canvas
+    };
+    
+    ~FramePipeline() { stop(); }
+    
+    void start(const Decoder & decoder, double frame_time, size_t ring_size = 3);
+    void stop();
+    bool running() const { return ! threads.empty(); }
+    
+    void configure(const Settings & settings);
+    // Swaps the newest projected canvas into 'canvas' (which goes back to the pipeline), false if there is none
+    bool swap(Canvas & canvas);
+    Stats stats() const;
+    
+private:
+    
+    typedef std::chrono::steady_clock Clock;
+    
+    void decode();
+    void project();
+    
+    Decoder decoder;
+    double frame_time = 0;                      // s
+    Settings settings;
+    Stats counters;
+    
+    std::vector<Frame> ring;
+    std::vector<Clock::time_point> ring_stamps;
+    std::deque<size_t> free_frames, decoded_frames;
+    
+    std::vector<Canvas> canvases;
+    std::vector<Clock::time_point> canvas_stamps;
+    std::vector<size_t> canvas_frames;
+    std::deque<size_t> free_canvases;
+    int ready = -1;
+    
+    std::vector<std::thread> threads;
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    bool bStop = false;
+};
@@ -0,0 +1,61 @@
+#include <cmath>
+#include <algorithm>
+#include "Pose.h"
+#include "Canvas.h"
+#include "Settings.h"
+
+//--------------------------------------------------------------
+CameraPose CameraPose::initial(const Canvas & canvas)
+{
+    CameraPose pose;
+    pose.scale = Vec3(-1, -1, 1);
+    pose.fov = CAMERA_INIT_FOV;
+    pose.position = Vec3(0, 0, CAMERA_INIT_ZPOS);
+    pose.target = Vec3(0, 0, (canvas.limits.far.z - canvas.limits.near.z) * 0.5 + canvas.limits.near.z);
+    return pose;
+}
+CameraPose CameraPose::orbit(const Canvas & canvas, float flattening, size_t step)
+{
+    CameraPose pose = initial(canvas);
+    float travel = 0.8 + 0.2 * flattening;
+    pose.up = Vec3(0, 0, 1);
+    pose.target = Vec3(0, 0, (canvas.limits.far.z - canvas.limits.near.z) * 0.5 * travel + canvas.limits.near.z);
+    float angle = step * CAMERA_POSE_ROTATION_SPEED;
+    float elevation = pose.target.z * (0.8 - CAMERA_POSE_ELEVATION * std::abs(std::cos(angle)));
+    Vec3 excentricity(std::cos(angle), std::sin(angle), 0);
+    pose.position = Vec3(pose.target.x, pose.target.y, elevation) + excentricity * CAMERA_POSE_EXCENTRICITY * std::min(canvas.width, canvas.height);
+    return pose;
+}
+//--------------------------------------------------------------
+void CameraPose::matrix(int width, int height, float m[16]) const
+{
+    // View: inverse of the node transform translate * rotate * scale, with the axes of ofNode::lookAt
+    Vec3 z = normalize(position - target);
+    Vec3 x = normalize(cross(up, z));
+    Vec3 y = cross(z, x);
+    const Vec3 axes[3] = { x * (1 / scale.x), y * (1 / scale.y), z * (1 / scale.z) };
+    float view[3][4];
+    for ( int r = 0; r < 3; ++r )
+    {
+        view[r][0] = axes[r].x;
+        view[r][1] = axes[r].y;
+        view[r][2] = axes[r].z;
+        view[r][3] = -dot(axes[r], position);
+    }
+    
+    // glm::perspective, with the clip planes of ofCamera::calcClipPlanes when not set
+    const float pi = 3.14159265358979f;
+    float distance = height / (2 * std::tan(pi * fov / 360));
+    float n = near_clip ? near_clip : distance / 100;
+    float f = far_clip ? far_clip : distance * 10;
+    float focal = 1 / std::tan(pi * fov / 360);
+    float aspect = width / (float) height;
+    float a = -(f + n) / (f - n), b = -2 * f * n / (f - n);
+    for ( int c = 0; c < 4; ++c )
+    {
+        m[c * 4 + 0] = focal / aspect * view[0][c];
+        m[c * 4 + 1] = focal * view[1][c];
+        m[c * 4 + 2] = a * view[2][c] + (c == 3 ? b : 0);
+        m[c * 4 + 3] = -view[2][c];
+    }
+}
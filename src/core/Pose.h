@@ -0,0 +1,50 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <cstddef>
+#include "Vec.h"
+
+class Canvas;
+
+// Camera pose with the ofCamera conventions: a node at 'position' looking at 'target' (ofNode::lookAt), scaled as
+// ofNode::setScale, and a perspective of vertical 'fov'. The app drives its ofEasyCam with it, the offline renderer
+// builds the same matrix from it.
+
+struct CameraPose
+{
+    Vec3 position, target;
+    Vec3 up = Vec3(0, 1, 0);
+    Vec3 scale = Vec3(1, 1, 1);
+    float fov = 60;                         // vertical, degrees
+    float near_clip = 0, far_clip = 0;      // 0: derived from the viewport height, as ofCamera does
+    
+    // Reset pose, looking at the middle of the canvas depth range
+    static CameraPose initial(const Canvas & canvas);
+    // Orbit around the canvas at a simulation step (see SimulationClock), closer as 'flattening' goes to 1
+    static CameraPose orbit(const Canvas & canvas, float flattening, size_t step);
+    
+    // Projection * view of a viewport, column-major as glm
+    void matrix(int width, int height, float m[16]) const;
+};
@@ -0,0 +1,94 @@
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include "Profiler.h"
+
+//--------------------------------------------------------------
+void FrameProfiler::setup(const std::vector<std::string> & stage_names)
+{
+    names = stage_names;
+    current.resize(names.size());
+    window.resize(FRAMES * names.size());
+    clear();
+}
+void FrameProfiler::clear()
+{
+    std::fill(current.data(), current.data() + current.size(), NAN);
+    committed = 0;
+}
+void FrameProfiler::add(size_t stage, double ms)
+{
+    float & t = current[stage];
+    t = std::isnan(t) ? ms : t + ms;
+}
+void FrameProfiler::endFrame()
+{
+    float * row = window.data() + (committed % FRAMES) * names.size();
+    std::copy(current.data(), current.data() + current.size(), row);
+    std::fill(current.data(), current.data() + current.size(), NAN);
+    ++committed;
+}
+float FrameProfiler::sample(size_t stage, size_t age) const
+{
+    if ( age >= frames() ) return NAN;
+    return window[((committed - 1 - age) % FRAMES) * names.size() + stage];
+}
+//--------------------------------------------------------------
+FrameProfiler::Summary FrameProfiler::summary(size_t stage) const
+{
+    Summary s;
+    size_t n = frames();
+    sorted.resize(n);
+    double sum = 0;
+    for ( size_t age = 0; age < n; ++age )
+    {
+        float t = sample(stage, age);
+        if ( std::isnan(t) ) continue;
+        if ( ! s.samples ) s.last = t;
+        sorted[s.samples++] = t;
+        sum += t;
+    }
+    if ( ! s.samples ) return s;
+    
+    // Nearest rank
+    float * begin = sorted.data(), * end = begin + s.samples;
+    std::sort(begin, end);
+    auto percentile = [&](double p) { return begin[std::min(s.samples - 1, (size_t) std::max(0., std::ceil(p * s.samples) - 1))]; };
+    s.mean = sum / s.samples;
+    s.p50 = percentile(0.5);
+    s.p95 = percentile(0.95);
+    s.p99 = percentile(0.99);
+    s.max = end[-1];
+    return s;
+}
+bool FrameProfiler::dump(const std::string & prefix) const
+{
+    FILE * file = std::fopen((prefix + ".csv").c_str(), "w");
+    if ( ! file ) return false;
+    std::fprintf(file, "stage,samples,last,mean,p50,p95,p99,max\n");
+    for ( size_t stage = 0; stage < names.size(); ++stage )
+    {
+        Summary s = summary(stage);
+        std::fprintf(file, "%s,%zu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", names[stage].c_str(), s.samples, s.last, s.mean, s.p50, s.p95, s.p99, s.max);
+    }
+    bool ok = std::fclose(file) == 0;
+    
+    // Oldest frame first, empty cells for the stages that did not run
+    file = std::fopen((prefix + "_frames.csv").c_str(), "w");
+    if ( ! file ) return false;
+    std::fprintf(file, "frame");
+    for ( const std::string & name : names ) std::fprintf(file, ",%s", name.c_str());
+    std::fprintf(file, "\n");
+    for ( size_t age = frames(); age-- > 0; )
+    {
+        std::fprintf(file, "%zu", committed - 1 - age);
+        for ( size_t stage = 0; stage < names.size(); ++stage )
+        {
+            float t = sample(stage, age);
+            if ( std::isnan(t) ) std::fprintf(file, ",");
+            else                 std::fprintf(file, ",%.4f", t);
+        }
+        std::fprintf(file, "\n");
+    }
+    return std::fclose(file) == 0 && ok;
+}
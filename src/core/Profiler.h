@@ -0,0 +1,91 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Buffer.h"
+
+// Frame time per stage. Scoped timers add up what a stage costs within a frame, endFrame() commits the frame
+// into a rolling window of FRAMES samples per stage, which percentiles are taken from. Stages that did not run
+// in a frame have no sample for it. Single threaded: work done by other threads is reported with add().
+// With PROFILER_ON undefined, PROFILE_STAGE() compiles to nothing.
+
+class FrameProfiler
+{
+public:
+    
+    static const size_t FRAMES = 600;
+    typedef std::chrono::steady_clock Clock;
+    
+    // Names of the stages, by index
+    void setup(const std::vector<std::string> & names);
+    void add(size_t stage, double ms);
+    void endFrame();
+    void clear();
+    
+    size_t stages() const { return names.size(); }
+    const std::string & name(size_t stage) const { return names[stage]; }
+    // Frames in the window, and the sample of a stage 'age' frames ago (0 the last one), NaN when it did not run
+    size_t frames() const { return committed < FRAMES ? committed : FRAMES; }
+    float sample(size_t stage, size_t age) const;
+    
+    // Over the window, in ms
+    struct Summary {
+        size_t samples = 0;
+        double last = 0, mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+    };
+    Summary summary(size_t stage) const;
+    
+    // Writes the summary of every stage to <prefix>.csv and every frame of the window to <prefix>_frames.csv
+    bool dump(const std::string & prefix) const;
+    
+    class Scope
+    {
+    public:
+        Scope(FrameProfiler & profiler, size_t stage) : profiler(profiler), stage(stage), start(Clock::now()) {}
+        ~Scope() { profiler.add(stage, std::chrono::duration<double, std::milli>(Clock::now() - start).count()); }
+    private:
+        FrameProfiler & profiler;
+        size_t stage;
+        Clock::time_point start;
+    };
+    
+private:
+    
+    std::vector<std::string> names;
+    Buffer<float> current;              // this frame, per stage
+    Buffer<float> window;               // FRAMES rows of stages, a ring
+    size_t committed = 0;
+    mutable Buffer<float> sorted;
+};
+
+#define PROFILE_CONCAT(a, b) a##b
+#define PROFILE_SCOPE_NAME(line) PROFILE_CONCAT(profile_scope_, line)
+#ifdef PROFILER_ON
+#define PROFILE_STAGE(profiler, stage) FrameProfiler::Scope PROFILE_SCOPE_NAME(__LINE__)(profiler, stage)
+#else
+#define PROFILE_STAGE(profiler, stage)
+#endif
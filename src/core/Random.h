@@ -0,0 +1,80 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "Simd.h"
+
+// Small seedable generator replacing ofRandom() in the headless core (splitmix64),
+// plus a counter-based variant: hash(key, counter) is a pure function, so any thread can
+// draw the n-th number of a stream without sharing state.
+
+class Random
+{
+public:
+    
+    Random(uint64_t seed = 0x2545F4914F6CDD1DULL) : state(seed) {}
+    
+    void seed(uint64_t s) { state = s; }
+    
+    uint32_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return (uint32_t) ((z ^ (z >> 31)) >> 32);
+    }
+    float uf() { return (next() >> 8) * (1.f / 16777216.f); }         // [0,1)
+    float f()  { return uf() * 2.f - 1.f; }                             // [-1,1)
+    float range(float max) { return max * uf(); }
+    float range(float min, float max) { return min + (max - min) * uf(); }
+    
+    static uint32_t hash(uint32_t key, uint32_t counter)
+    {
+        uint32_t x = counter * 0x9E3779B9u + key;
+        x ^= x >> 16; x *= 0x7FEB352Du;
+        x ^= x >> 15; x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x;
+    }
+    static float hashuf(uint32_t key, uint32_t counter) { return (hash(key, counter) >> 8) * (1.f / 16777216.f); }
+    static float hashf(uint32_t key, uint32_t counter)  { return hashuf(key, counter) * 2.f - 1.f; }
+    
+    // Same streams, 4 counters at a time (bit-exact with the scalar versions)
+    static uint4 hash(uint4 key, uint4 counter)
+    {
+        uint4 x = counter * uint4(0x9E3779B9u) + key;
+        x = x ^ shr<16>(x); x = x * uint4(0x7FEB352Du);
+        x = x ^ shr<15>(x); x = x * uint4(0x846CA68Bu);
+        x = x ^ shr<16>(x);
+        return x;
+    }
+    static float4 hashuf(uint4 key, uint4 counter) { return toFloat(shr<8>(hash(key, counter))) * float4(1.f / 16777216.f); }
+    static float4 hashf(uint4 key, uint4 counter)  { return hashuf(key, counter) * float4(2.f) - float4(1.f); }
+    
+private:
+    
+    uint64_t state;
+};
@@ -0,0 +1,361 @@
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include "Raster.h"
+#include "Parallel.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double lap(Clock::time_point & start)
+{
+    Clock::time_point now = Clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - start).count();
+    start = now;
+    return ms;
+}
+
+// Floor and ceiling of window coordinates, without the library calls
+static inline int floorInt(float x)
+{
+    x = std::min(std::max(x, -1E9f), 1E9f);
+    int i = (int) x;
+    return i - (x < i);
+}
+static inline int ceilInt(float x) { return -floorInt(-x); }
+
+// Pixels of one tile of the frame
+struct Tile
+{
+    int x0, y0, x1, y1, width;
+    unsigned char * colors;
+    float * depths;
+    
+    // Depth test (less) and source alpha blending of a fragment into the 8-bit frame, as an RGB8 framebuffer does
+    inline void plot(int x, int y, float z, float r, float g, float b, float a) const
+    {
+        size_t p = (size_t) y * width + x;
+        if ( ! (z < depths[p]) || z > 1 ) return;
+        depths[p] = z;
+        unsigned char * c = colors + p * 3;
+        a = std::min(std::max(a, 0.f), 1.f);
+        c[0] = (unsigned char) (c[0] + (std::min(std::max(r, 0.f), 1.f) * 255 - c[0]) * a + 0.5f);
+        c[1] = (unsigned char) (c[1] + (std::min(std::max(g, 0.f), 1.f) * 255 - c[1]) * a + 0.5f);
+        c[2] = (unsigned char) (c[2] + (std::min(std::max(b, 0.f), 1.f) * 255 - c[2]) * a + 0.5f);
+    }
+};
+
+//--------------------------------------------------------------
+// A 1 pixel point covers the pixel its position falls in
+static inline void drawPoint(const Tile & tile, float x, float y, float z, const Color & c)
+{
+    int px = floorInt(x), py = floorInt(y);
+    if ( px < tile.x0 || px >= tile.x1 || py < tile.y0 || py >= tile.y1 ) return;
+    tile.plot(px, py, z, c.r, c.g, c.b, c.a);
+}
+// A 1 pixel line covers one pixel per column (or row, along its major axis) whose centre it crosses,
+// the last one excluded as the diamond-exit rule does
+template<typename V>
+static inline void drawLine(const Tile & tile, const V & a, const V & b, const Color & ca, const Color & cb)
+{
+    float dx = b.x - a.x, dy = b.y - a.y;
+    bool major_x = std::abs(dx) >= std::abs(dy);
+    float d = major_x ? dx : dy;
+    if ( d == 0 ) return;
+    float from = major_x ? a.x : a.y, to = major_x ? b.x : b.y;
+    int lo = major_x ? tile.x0 : tile.y0, hi = major_x ? tile.x1 : tile.y1;
+    int first = std::max(lo, ceilInt(std::min(from, to) - 0.5f));
+    int last = std::min(hi - 1, ceilInt(std::max(from, to) - 0.5f) - 1);
+    for ( int i = first; i <= last; ++i )
+    {
+        float t = (i + 0.5f - from) / d;
+        float minor = major_x ? a.y + t * dy : a.x + t * dx;
+        int j = floorInt(minor);
+        int px = major_x ? i : j, py = major_x ? j : i;
+        if ( px < tile.x0 || px >= tile.x1 || py < tile.y0 || py >= tile.y1 ) continue;
+        // Depth is linear on screen, colours perspective correct
+        float z = a.z + t * (b.z - a.z);
+        float wa = (1 - t) * a.w, wb = t * b.w, k = 1 / (wa + wb);
+        wa *= k;
+        wb *= k;
+        tile.plot(px, py, z, ca.r * wa + cb.r * wb, ca.g * wa + cb.g * wb, ca.b * wa + cb.b * wb, ca.a * wa + cb.a * wb);
+    }
+}
+// Filled triangle: pixel centres inside the three edges, the ones on an edge owned by its top or left side
+template<typename V>
+static inline void drawTriangle(const Tile & tile, const V * a, const V * b, const V * c, const Color * ca, const Color * cb, const Color * cc)
+{
+    float area = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+    if ( ! (area != 0) ) return;
+    if ( area < 0 ) { std::swap(b, c); std::swap(cb, cc); area = -area; }
+    
+    int x0 = std::max(tile.x0, ceilInt(std::min(a->x, std::min(b->x, c->x)) - 0.5f));
+    int x1 = std::min(tile.x1 - 1, floorInt(std::max(a->x, std::max(b->x, c->x)) - 0.5f));
+    int y0 = std::max(tile.y0, ceilInt(std::min(a->y, std::min(b->y, c->y)) - 0.5f));
+    int y1 = std::min(tile.y1 - 1, floorInt(std::max(a->y, std::max(b->y, c->y)) - 0.5f));
+    if ( x0 > x1 || y0 > y1 ) return;
+    
+    // Edge u -> v: E(p) = (v.x - u.x) (p.y - u.y) - (v.y - u.y) (p.x - u.x), positive inside
+    const V * from[3] = { b, c, a }, * to[3] = { c, a, b };
+    float ex[3], ey[3], e0[3];
+    bool owned[3];
+    for ( int e = 0; e < 3; ++e )
+    {
+        float dx = to[e]->x - from[e]->x, dy = to[e]->y - from[e]->y;
+        ex[e] = -dy;
+        ey[e] = dx;
+        e0[e] = dx * (y0 + 0.5f - from[e]->y) - dy * (x0 + 0.5f - from[e]->x);
+        owned[e] = dy > 0 || (dy == 0 && dx < 0);
+    }
+    
+    // Barycentric weights of a, b, c are E_bc, E_ca, E_ab over the area
+    const float inv = 1 / area;
+    const float wa = a->w, wb = b->w, wc = c->w;
+    for ( int y = y0; y <= y1; ++y )
+    {
+        int row = y - y0;
+        float e[3];
+        for ( int k = 0; k < 3; ++k ) e[k] = e0[k] + ey[k] * row;
+        for ( int x = x0; x <= x1; ++x, e[0] += ex[0], e[1] += ex[1], e[2] += ex[2] )
+        {
+            if ( e[0] < 0 || e[1] < 0 || e[2] < 0 ) continue;
+            if ( (e[0] == 0 && ! owned[0]) || (e[1] == 0 && ! owned[1]) || (e[2] == 0 && ! owned[2]) ) continue;
+            float la = e[0] * inv, lb = e[1] * inv, lc = e[2] * inv;
+            float z = la * a->z + lb * b->z + lc * c->z;
+            float pa = la * wa, pb = lb * wb, pc = lc * wc, k = 1 / (pa + pb + pc);
+            pa *= k;
+            pb *= k;
+            pc *= k;
+            tile.plot(x, y, z, ca->r * pa + cb->r * pb + cc->r * pc, ca->g * pa + cb->g * pb + cc->g * pc,
+                               ca->b * pa + cb->b * pb + cc->b * pc, ca->a * pa + cb->a * pb + cc->a * pc);
+        }
+    }
+}
+
+//--------------------------------------------------------------
+size_t Rasterizer::bytes() const
+{
+    size_t b = rgb.bytes() + depths.bytes() + gradient.bytes() + screen.bytes() + triangles.bytes();
+    for ( const auto & bin : bins ) b += bin.capacity() * sizeof(uint32_t);
+    return b;
+}
+void Rasterizer::resize(int w, int h)
+{
+    width = w;
+    height = h;
+    tiles_x = (w + tile_size - 1) / tile_size;
+    tiles_y = (h + tile_size - 1) / tile_size;
+    rgb.resize((size_t) w * h * 3);
+    depths.resize((size_t) w * h);
+}
+// ofBackgroundGradient circular is a fan of 32 triangles around the centre, with the edge colour on a polygon
+// whose sides are at the half diagonal: colours are linear in the distance to the side of every sector.
+void Rasterizer::updateGradient()
+{
+    if ( gradient_width == width && gradient_height == height && ! std::memcmp(&gradient_center, &center, sizeof(Color))
+         && ! std::memcmp(&gradient_edge, &edge, sizeof(Color)) ) return;
+    gradient_width = width;
+    gradient_height = height;
+    gradient_center = center;
+    gradient_edge = edge;
+    gradient.resize((size_t) width * height * 3);
+    
+    const int sectors = 32;
+    const float pi = 3.14159265358979f, sector = 2 * pi / sectors;
+    const float cx = width * 0.5f, cy = height * 0.5f, radius = std::sqrt(cx * cx + cy * cy);
+    parallelFor(height, [&](size_t begin, size_t end) {
+        for ( size_t y = begin; y < end; ++y )
+        {
+            unsigned char * g = gradient.data() + y * width * 3;
+            for ( int x = 0; x < width; ++x, g += 3 )
+            {
+                float dx = x + 0.5f - cx, dy = y + 0.5f - cy;
+                float theta = std::atan2(dx, dy);
+                if ( theta < 0 ) theta += 2 * pi;
+                float bisector = (std::floor(theta / sector) + 0.5f) * sector;
+                float t = std::min(1.f, (dx * std::sin(bisector) + dy * std::cos(bisector)) / radius);
+                g[0] = (unsigned char) ((center.r + (edge.r - center.r) * t) * 255 + 0.5f);
+                g[1] = (unsigned char) ((center.g + (edge.g - center.g) * t) * 255 + 0.5f);
+                g[2] = (unsigned char) ((center.b + (edge.b - center.b) * t) * 255 + 0.5f);
+            }
+        }
+    });
+}
+void Rasterizer::unrollStrips(const std::shared_ptr<const Topology> & topology)
+{
+    if ( strips == topology ) return;
+    strips = topology;
+    const Buffer<unsigned int> & indices = topology->indices;
+    triangles.resize(indices.size() * 3);
+    size_t n = 0;
+    for ( size_t i = 2; i < indices.size(); ++i )
+    {
+        if ( indices[i] == Topology::restart ) { ++i; continue; }
+        if ( indices[i-1] == Topology::restart || indices[i-2] == Topology::restart ) continue;
+        triangles[n++] = indices[i-2];
+        triangles[n++] = indices[i-1];
+        triangles[n++] = indices[i];
+    }
+    triangles.resize(n);
+}
+//--------------------------------------------------------------
+void Rasterizer::render(const Canvas & canvas, const CameraPose & pose, int w, int h)
+{
+    Clock::time_point start = Clock::now();
+    if ( w != width || h != height ) resize(w, h);
+    updateGradient();
+    
+    // Window coordinates, rows from the top
+    float m[16];
+    pose.matrix(width, height, m);
+    const size_t n = canvas.size();
+    screen.resize(n);
+    const Vec3 * vertexes = canvas.animated_vertexes.data();
+    parallelFor(n, [&](size_t begin, size_t end) {
+        for ( size_t v = begin; v < end; ++v )
+        {
+            const Vec3 & p = vertexes[v];
+            float x = m[0] * p.x + m[4] * p.y + m[8]  * p.z + m[12];
+            float y = m[1] * p.x + m[5] * p.y + m[9]  * p.z + m[13];
+            float z = m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14];
+            float cw = m[3] * p.x + m[7] * p.y + m[11] * p.z + m[15];
+            ScreenVertex & s = screen[v];
+            if ( ! (cw > 0) || z < -cw ) { s.x = s.y = s.z = s.w = 0; continue; }
+            float iw = 1 / cw;
+            s.x = (x * iw + 1) * 0.5f * width;
+            s.y = (1 - y * iw) * 0.5f * height;
+            s.z = (z * iw + 1) * 0.5f;
+            s.w = iw;
+        }
+    });
+    timing.transform = lap(start);
+    
+    // Primitives: vertexes for point topologies, triangles otherwise (strips unrolled)
+    const std::shared_ptr<const Topology> & topology = canvas.topology;
+    bPoints = ! topology || topology->primitive == PRIMITIVE_POINTS;
+    primitive_indices = nullptr;
+    primitives = n;
+    if ( ! bPoints )
+    {
+        if ( topology->primitive == PRIMITIVE_TRIANGLE_STRIP ) unrollStrips(topology);
+        const Buffer<unsigned int> & list = topology->primitive == PRIMITIVE_TRIANGLE_STRIP ? triangles : topology->indices;
+        primitive_indices = list.data();
+        primitives = list.size() / 3;
+    }
+    
+    // Binning in chunks of primitives: a tile goes through the bins of every chunk in order, so the draw order is kept
+    Parallel & pool = Parallel::pool();
+    const size_t tiles = (size_t) tiles_x * tiles_y;
+    const size_t grain = std::max<size_t>(16384, (primitives + 4 * pool.threads() - 1) / (4 * pool.threads()));
+    const size_t chunks = pool.chunks(primitives, grain);
+    const bool bFill = ! bPoints && canvas.render == RENDER_FILL;
+    if ( bins.size() < chunks * tiles ) bins.resize(chunks * tiles);
+    for ( size_t b = 0; b < chunks * tiles; ++b ) bins[b].clear();
+    
+    pool.run(primitives, grain, [&](size_t chunk, size_t begin, size_t end) {
+        std::vector<uint32_t> * chunk_bins = bins.data() + chunk * tiles;
+        for ( size_t p = begin; p < end; ++p )
+        {
+            float x0, y0, x1, y1;
+            if ( bPoints )
+            {
+                const ScreenVertex & s = screen[p];
+                if ( ! s.w ) continue;
+                x0 = x1 = s.x;
+                y0 = y1 = s.y;
+            }
+            else
+            {
+                const ScreenVertex & a = screen[primitive_indices[p * 3]];
+                const ScreenVertex & b = screen[primitive_indices[p * 3 + 1]];
+                const ScreenVertex & c = screen[primitive_indices[p * 3 + 2]];
+                if ( ! a.w || ! b.w || ! c.w ) continue;
+                x0 = std::min(a.x, std::min(b.x, c.x));
+                x1 = std::max(a.x, std::max(b.x, c.x));
+                y0 = std::min(a.y, std::min(b.y, c.y));
+                y1 = std::max(a.y, std::max(b.y, c.y));
+            }
+            // Pixels touched: the ones whose centre a filled triangle covers, the ones the position falls in otherwise.
+            // Most triangles of a dense canvas cover no pixel centre at all, and are dropped here.
+            int px0, px1, py0, py1;
+            if ( bFill )
+            {
+                px0 = ceilInt(x0 - 0.5f);
+                px1 = floorInt(x1 - 0.5f);
+                py0 = ceilInt(y0 - 0.5f);
+                py1 = floorInt(y1 - 0.5f);
+            }
+            else
+            {
+                px0 = floorInt(x0);
+                px1 = floorInt(x1);
+                py0 = floorInt(y0);
+                py1 = floorInt(y1);
+            }
+            px0 = std::max(px0, 0);
+            py0 = std::max(py0, 0);
+            px1 = std::min(px1, width - 1);
+            py1 = std::min(py1, height - 1);
+            if ( px0 > px1 || py0 > py1 ) continue;
+            int tx0 = px0 / tile_size, tx1 = px1 / tile_size;
+            int ty0 = py0 / tile_size, ty1 = py1 / tile_size;
+            for ( int ty = ty0; ty <= ty1; ++ty )
+                for ( int tx = tx0; tx <= tx1; ++tx )
+                    chunk_bins[ty * tiles_x + tx].push_back((uint32_t) p);
+        }
+    });
+    timing.bin = lap(start);
+    
+    // One tile per job, handed out in order to whichever thread is free
+    pool.run(tiles, 1, [&](size_t, size_t begin, size_t end) {
+        for ( size_t t = begin; t < end; ++t ) rasterTile(canvas, t, chunks);
+    });
+    timing.raster = lap(start);
+}
+void Rasterizer::rasterTile(const Canvas & canvas, size_t t, size_t chunks)
+{
+    Tile tile;
+    tile.x0 = (int) (t % tiles_x) * tile_size;
+    tile.y0 = (int) (t / tiles_x) * tile_size;
+    tile.x1 = std::min(width, tile.x0 + tile_size);
+    tile.y1 = std::min(height, tile.y0 + tile_size);
+    tile.width = width;
+    tile.colors = rgb.data();
+    tile.depths = depths.data();
+    
+    // Cleared to the background, at the far plane
+    for ( int y = tile.y0; y < tile.y1; ++y )
+    {
+        size_t row = (size_t) y * width;
+        std::copy(gradient.data() + (row + tile.x0) * 3, gradient.data() + (row + tile.x1) * 3, rgb.data() + (row + tile.x0) * 3);
+        std::fill(depths.data() + row + tile.x0, depths.data() + row + tile.x1, 1.f);
+    }
+    
+    const ScreenVertex * s = screen.data();
+    const Color * c = canvas.animated_colors.data();
+    const RenderMode render = canvas.render;
+    const size_t tiles = (size_t) tiles_x * tiles_y;
+    for ( size_t chunk = 0; chunk < chunks; ++chunk )
+    {
+        for ( uint32_t p : bins[chunk * tiles + t] )
+        {
+            if ( bPoints ) { drawPoint(tile, s[p].x, s[p].y, s[p].z, c[p]); continue; }
+            
+            const unsigned int * v = primitive_indices + (size_t) p * 3;
+            switch ( render )
+            {
+                case RENDER_POINTS:
+                    for ( int k = 0; k < 3; ++k ) drawPoint(tile, s[v[k]].x, s[v[k]].y, s[v[k]].z, c[v[k]]);
+                    break;
+                case RENDER_WIREFRAME:
+                    drawLine(tile, s[v[0]], s[v[1]], c[v[0]], c[v[1]]);
+                    drawLine(tile, s[v[1]], s[v[2]], c[v[1]], c[v[2]]);
+                    drawLine(tile, s[v[2]], s[v[0]], c[v[2]], c[v[0]]);
+                    break;
+                case RENDER_FILL:
+                    drawTriangle(tile, s + v[0], s + v[1], s + v[2], c + v[0], c + v[1], c + v[2]);
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Buffer.h"
+#include "Canvas.h"
+#include "Pose.h"
+
+// CPU rasterizer of a canvas, for rendering on machines without a GPU. It draws what the app draws with OpenGL:
+// ofBackgroundGradient (circular), then the canvas topology in the glPolygonMode of its render mode (points, lines
+// or fill) with a less-than depth test, alpha blending and smooth colours, 1 pixel points and lines.
+// Primitives crossing the near plane are dropped instead of clipped.
+// Vertexes are transformed and primitives binned to screen tiles in parallel, keeping the draw order, and then
+// every tile is rasterized on its own by whichever thread claims it next.
+
+class Rasterizer
+{
+public:
+    
+    static const int tile_size = 64;
+    
+    // Background gradient, from 'center' in the middle of the frame to 'edge' at the corners
+    Color center, edge;
+    
+    void render(const Canvas & canvas, const CameraPose & pose, int width, int height);
+    
+    const unsigned char * pixels() const { return rgb.data(); }     // RGB, top row first
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    size_t bytes() const;
+    
+    struct Timing {
+        double transform = 0, bin = 0, raster = 0;      // ms
+        double total() const { return transform + bin + raster; }
+    } timing;
+    size_t primitives = 0;
+    
+private:
+    
+    // Window position, depth in [0,1] and 1 / clip w, which is 0 behind the near plane
+    struct ScreenVertex {
+        float x, y, z, w;
+    };
+    
+    void resize(int width, int height);
+    void updateGradient();
+    void unrollStrips(const std::shared_ptr<const Topology> & topology);
+    void rasterTile(const Canvas & canvas, size_t tile, size_t chunks);
+    
+    int width = 0, height = 0, tiles_x = 0, tiles_y = 0;
+    Buffer<unsigned char> rgb;
+    Buffer<float> depths;
+    Buffer<unsigned char> gradient;                 // RGB of the background, for the current size and colours
+    Color gradient_center, gradient_edge;
+    int gradient_width = 0, gradient_height = 0;
+    
+    Buffer<ScreenVertex> screen;
+    std::shared_ptr<const Topology> strips;         // strips unrolled into 'triangles'
+    Buffer<unsigned int> triangles;
+    std::vector<std::vector<uint32_t>> bins;        // primitives of every binning chunk and tile, in draw order
+    
+    // Primitives of the frame being drawn
+    const unsigned int * primitive_indices = nullptr;
+    bool bPoints = false;
+};
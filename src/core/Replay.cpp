@@ -0,0 +1,273 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "Replay.h"
+#include "CanvasFile.h"
+#include "Parallel.h"
+#include "Pose.h"
+#include "Settings.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//--------------------------------------------------------------
+bool ReplayScript::load(const std::string & path)
+{
+    std::ifstream file(path);
+    if ( ! file ) { error = "Could not open " + path; return false; }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parse(text.str());
+}
+bool ReplayScript::parse(const std::string & text)
+{
+    static const char * fires[] = { "synapses", "flattening", "inclusion", "noise" };
+    static const char * modes[] = { "points", "wireframe", "fill" };
+    events.clear();
+    error.clear();
+    bool bEnd = false;
+    end = 0;
+    
+    std::istringstream lines(text);
+    std::string line;
+    for ( size_t number = 1; std::getline(lines, line); ++number )
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string first, command, argument;
+        if ( ! (words >> first) ) continue;
+        words >> argument;
+        
+        auto fail = [&](const char * what) { error = "Line " + std::to_string(number) + ": " + what; return false; };
+        char * rest = nullptr;
+        if ( first == "seed" )
+        {
+            seed = std::strtoull(argument.c_str(), &rest, 10);
+            if ( argument.empty() || *rest ) return fail("seed takes an integer");
+            continue;
+        }
+        if ( first == "step" )
+        {
+            step = std::strtod(argument.c_str(), &rest);
+            if ( argument.empty() || *rest || ! (step > 0) ) return fail("step takes a positive number of ms");
+            continue;
+        }
+        
+        ReplayEvent event;
+        event.time = std::strtod(first.c_str(), &rest);
+        if ( *rest || ! (event.time >= 0) ) return fail("expected a time in ms or a directive");
+        command = argument;
+        argument.clear();
+        words >> argument;
+        char * number_end = nullptr;
+        float value = std::strtof(argument.c_str(), &number_end);
+        bool numeric = ! argument.empty() && ! *number_end;
+        int on = argument == "on" ? 1 : argument == "off" ? 0 : argument == "toggle" ? -1 : -2;
+        
+        if ( command == "load" || command == "soundtrack" )
+        {
+            if ( argument.empty() ) return fail("expected a file");
+            event.command = command == "load" ? ReplayEvent::LOAD : ReplayEvent::SOUNDTRACK;
+            event.source = argument;
+        }
+        else if ( command == "fire" )
+        {
+            const char ** found = std::find_if(std::begin(fires), std::end(fires), [&](const char * f) { return argument == f; });
+            if ( found == std::end(fires) ) return fail("fire takes synapses, flattening, inclusion or noise");
+            event.command = (ReplayEvent::Command) (ReplayEvent::FIRE_SYNAPSES + (found - fires));
+        }
+        else if ( command == "extrusion" || command == "focal" || command == "intensity" )
+        {
+            if ( ! numeric ) return fail("expected a number");
+            event.command = command == "extrusion" ? ReplayEvent::EXTRUSION : command == "focal" ? ReplayEvent::FOCAL : ReplayEvent::INTENSITY;
+            event.value = value;
+        }
+        else if ( command == "orbit" || command == "lod" )
+        {
+            if ( on < -1 || (command == "lod" && on < 0) ) return fail("expected on or off");
+            event.command = command == "orbit" ? ReplayEvent::ORBIT : ReplayEvent::LOD;
+            event.value = on;
+        }
+        else if ( command == "render" )
+        {
+            const char ** found = std::find_if(std::begin(modes), std::end(modes), [&](const char * m) { return argument == m; });
+            if ( found == std::end(modes) ) return fail("render takes points, wireframe or fill");
+            event.command = ReplayEvent::RENDER;
+            event.value = RENDER_POINTS + (found - modes);
+        }
+        else if ( command == "end" )
+        {
+            event.command = ReplayEvent::END;
+            end = bEnd ? std::min(end, event.time) : event.time;
+            bEnd = true;
+        }
+        else return fail("unknown command");
+        events.push_back(event);
+    }
+    
+    std::stable_sort(events.begin(), events.end(), [](const ReplayEvent & a, const ReplayEvent & b) { return a.time < b.time; });
+    if ( ! bEnd ) end = events.empty() ? 0 : events.back().time;
+    return true;
+}
+size_t ReplayScript::due(size_t next, double now) const
+{
+    while ( next < events.size() && events[next].time <= now ) ++next;
+    return next;
+}
+//--------------------------------------------------------------
+bool Replay::apply(const ReplayEvent & event, const std::string & directory, double now)
+{
+    switch ( event.command )
+    {
+        case ReplayEvent::LOAD:
+        {
+            CanvasFile file;
+            std::string path = directory.empty() || event.source[0] == '/' ? event.source : directory + "/" + event.source;
+            if ( ! file.open(path) ) { error = "Could not open " + path; return false; }
+            animator.reset();
+            file.load(canvas, focal, extrusion, false);
+            canvas.updateTopology();
+            canvas.restore();
+            loaded = event.source;
+            break;
+        }
+        case ReplayEvent::FIRE_SYNAPSES:    animator.fireSynapses(canvas);                              break;
+        case ReplayEvent::FIRE_FLATTENING:  animator.fireFlattening();                                  break;
+        case ReplayEvent::FIRE_INCLUSION:   animator.fireInclusion();                                   break;
+        case ReplayEvent::FIRE_NOISE:       animator.fireNoise();                                       break;
+        case ReplayEvent::EXTRUSION:        extrusion = event.value; canvas.project(focal, extrusion);  break;
+        case ReplayEvent::FOCAL:            focal = event.value;     canvas.project(focal, extrusion);  break;
+        case ReplayEvent::ORBIT:            orbit = event.value < 0 ? ! orbit : event.value > 0;        break;
+        case ReplayEvent::RENDER:           canvas.render = (RenderMode) event.value; canvas.updateTopology(); break;
+        case ReplayEvent::INTENSITY:        intensity = event.value; soundtrack_start = -1;             break;
+        case ReplayEvent::SOUNDTRACK:
+        {
+            std::string path = directory.empty() || event.source[0] == '/' ? event.source : directory + "/" + event.source;
+            if ( ! soundtrack.load(path) ) { error = "Could not analyze " + path; return false; }
+            soundtrack_start = now;
+            break;
+        }
+        case ReplayEvent::LOD:
+        {
+            // Reloaded from the same file, as the app does
+            canvas.lod_tolerance = event.value > 0 ? LOD_TOLERANCE : 0;
+            if ( loaded.empty() ) break;
+            ReplayEvent reload;
+            reload.command = ReplayEvent::LOAD;
+            reload.source = loaded;
+            return apply(reload, directory, now);
+        }
+        case ReplayEvent::END:                                                                          break;
+    }
+    return true;
+}
+bool Replay::run(const ReplayScript & script, const std::string & directory)
+{
+    animator = Animator();
+    animator.random.seed(script.seed);
+    focal = CAMERA_INIT_FOCAL;
+    extrusion = CANVAS_INIT_EXTRUSION;
+    intensity = 1;
+    soundtrack_start = -1;
+    orbit = false;
+    error.clear();
+    loaded.clear();
+    frames.assign(script.frames(), Frame());
+    mixdown.clear();
+    if ( grain_sample )
+    {
+        grains.setup(grain_sample, grain_rate, script.seed);
+        mixdown.reserve(2 * (size_t) std::ceil(frames.size() * script.step * 1E-3 * grain_rate));
+    }
+    
+    size_t next = 0;
+    for ( size_t f = 0; f < frames.size(); ++f )
+    {
+        Frame & frame = frames[f];
+        frame.time = f * script.step;
+        Clock::time_point start = Clock::now();
+        for ( size_t last = script.due(next, frame.time); next < last; ++next )
+            if ( ! apply(script.events[next], directory, frame.time) ) return false;
+        frame.events = since(start);
+        
+        if ( soundtrack_start >= 0 ) intensity = soundtrack.smoothed((frame.time - soundtrack_start) * 1E-3) * SPECTRUM_GAIN + SPECTRUM_BIAS;
+        
+        Clock::time_point update = Clock::now();
+        animator.update(canvas, frame.time, intensity);
+        frame.update = since(update);
+        frame.firings = animator.synapses.size();
+        
+        // Grains up to the start of the next frame
+        if ( grain_sample )
+        {
+            Clock::time_point mixing = Clock::now();
+            frame.grains = grains.trigger(animator.takeGrains(), frame.time * 1E-3);
+            size_t mixed = mixdown.size() / 2, until = (size_t) std::llround((f + 1) * script.step * 1E-3 * grain_rate);
+            mixdown.resize(2 * std::max(mixed, until));
+            grains.mix(mixdown.data() + 2 * mixed, mixdown.size() / 2 - mixed);
+            frame.mix = since(mixing);
+        }
+        
+        if ( raster_width > 0 && canvas.size() )
+        {
+            const CameraPose pose = orbit ? CameraPose::orbit(canvas, animator.flattened(), animator.clock.steps()) : CameraPose::initial(canvas);
+            Clock::time_point culling = Clock::now();
+            float matrix[16];
+            pose.matrix(raster_width, raster_height, matrix);
+            culler.bound(canvas);
+            culler.cull(matrix);
+            frame.cull = since(culling);
+            frame.visible = culler.stats().visible;
+            frame.culled = culler.stats().culled;
+            
+            Clock::time_point rasterizing = Clock::now();
+            raster.render(canvas, pose, raster_width, raster_height);
+            frame.raster = since(rasterizing);
+        }
+        frame.total = since(start);
+    }
+    return true;
+}
+//--------------------------------------------------------------
+// 64-bit words mixed in fixed blocks, then the block hashes in order: the same result for any number of threads
+uint64_t Replay::checksum(const void * data, size_t bytes)
+{
+    static const size_t block = 1 << 20;
+    auto mix = [](uint64_t h, uint64_t word) {
+        h = (h ^ word) * 0x100000001B3ULL;
+        return h ^ (h >> 29);
+    };
+    const unsigned char * bytes_data = (const unsigned char *) data;
+    size_t blocks = (bytes + block - 1) / block;
+    std::vector<uint64_t> hashes(blocks);
+    parallelFor(blocks, [&](size_t begin, size_t end) {
+        for ( size_t b = begin; b < end; ++b )
+        {
+            const unsigned char * p = bytes_data + b * block;
+            size_t n = std::min(block, bytes - b * block);
+            uint64_t h = 0xCBF29CE484222325ULL, word;
+            size_t i = 0;
+            for ( ; i + 8 <= n; i += 8 ) { std::memcpy(&word, p + i, 8); h = mix(h, word); }
+            for ( ; i < n; ++i ) h = mix(h, p[i]);
+            hashes[b] = h;
+        }
+    }, 1);
+    uint64_t h = 0xCBF29CE484222325ULL ^ bytes;
+    for ( uint64_t b : hashes ) h = mix(h, b);
+    return h;
+}
+uint64_t Replay::checksum(const Canvas & canvas)
+{
+    uint64_t vertexes = checksum(canvas.animated_vertexes.data(), canvas.animated_vertexes.size() * sizeof(Vec3));
+    uint64_t colors = checksum(canvas.animated_colors.data(), canvas.animated_colors.size() * sizeof(Color));
+    return (vertexes ^ (colors + 0x9E3779B97F4A7C15ULL + (vertexes << 6) + (vertexes >> 2)));
+}
@@ -0,0 +1,126 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Animator.h"
+#include "Audio.h"
+#include "Canvas.h"
+#include "Culling.h"
+#include "Grains.h"
+#include "Raster.h"
+
+// Deterministic replays: a timeline of the events the app reacts to (example loads, firings, camera changes), run
+// against a fixed-step virtual clock and a seeded generator, so two runs of the same script do the same work.
+//
+//  # comment
+//  seed 7                  generator seed (1 by default)
+//  step 33.333             frame step in ms (30 fps by default)
+//  0     load meninas      source of the canvas: a .dpc for the headless runner, an example for the app
+//  500   fire synapses     synapses, flattening, inclusion or noise
+//  1000  extrusion -2      absolute, as 'focal'
+//  1500  orbit on          on, off or toggle
+//  2000  render fill       points, wireframe or fill
+//  2500  lod on            on or off
+//  3000  intensity 4       of the effects, in place of the audio spectrum (1 by default)
+//  3000  soundtrack a.dpe  effects driven by the spectrum envelope of a track played from then (.dpe or .wav)
+//  10000 end               last frame, else the last event
+
+struct ReplayEvent
+{
+    enum Command { LOAD, FIRE_SYNAPSES, FIRE_FLATTENING, FIRE_INCLUSION, FIRE_NOISE, EXTRUSION, FOCAL, ORBIT, RENDER, LOD, INTENSITY, SOUNDTRACK, END };
+    double time = 0;            // ms
+    Command command = END;
+    float value = 0;            // extrusion, focal, intensity; 1/0 for on/off (-1 toggles); RenderMode
+    std::string source;         // of LOAD and SOUNDTRACK
+};
+
+class ReplayScript
+{
+public:
+    
+    bool load(const std::string & path);
+    bool parse(const std::string & text);
+    
+    // Events in time order (stable for equal times), and the first one after 'next' not due at 'now'
+    std::vector<ReplayEvent> events;
+    size_t due(size_t next, double now) const;
+    
+    uint64_t seed = 1;
+    double step = 1000 / 30.;
+    double end = 0;             // ms
+    size_t frames() const { return (size_t) (end / step) + 1; }
+    
+    std::string error;          // of the last failed load/parse
+};
+
+// Headless runner: plays a script over canvases loaded from precomputed files, as fast as it goes, timing every
+// frame. The canvas is reset to rest on every load, as the app does. With a raster size, every frame is also
+// rasterized from the app camera (orbiting or at rest). With a grain sample, the grains of the effects are mixed
+// along the virtual clock into 'mixdown' (interleaved stereo at 'grain_rate').
+
+class Replay
+{
+public:
+    
+    // Loads 'source' (relative to 'directory') into the canvas, projected for the current focal and extrusion
+    bool run(const ReplayScript & script, const std::string & directory);
+    
+    struct Frame {
+        double time = 0;        // virtual, ms
+        double events = 0, update = 0, cull = 0, raster = 0, mix = 0, total = 0;
+        size_t firings = 0;     // live synapses
+        size_t grains = 0;      // started
+        size_t visible = 0, culled = 0;     // tiles seen by the rasterized pose
+    };
+    std::vector<Frame> frames;
+    
+    Canvas canvas;
+    Animator animator;
+    float focal = 0, extrusion = 0, intensity = 1;
+    bool orbit = false;
+    SpectrumEnvelope soundtrack;
+    double soundtrack_start = -1;   // ms, -1 for a fixed intensity
+    std::string error;
+    
+    Rasterizer raster;
+    int raster_width = 0, raster_height = 0;
+    TileCuller culler;
+    
+    std::shared_ptr<const Pcm> grain_sample;
+    int grain_rate = 44100;
+    GrainEngine grains;
+    Buffer<float> mixdown;
+    
+    // Of the animated vertexes and colours, or of any bytes, independent of the number of threads
+    static uint64_t checksum(const Canvas & canvas);
+    static uint64_t checksum(const void * data, size_t bytes);
+    
+private:
+    
+    bool apply(const ReplayEvent & event, const std::string & directory, double now);
+    std::string loaded;
+};
@@ -0,0 +1,67 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free ring between one producer and one consumer thread. Neither side ever blocks:
+// push() fails when the ring is full, pop() when it is empty. One slot is kept free to tell both apart.
+
+template<typename T>
+class SpscRing
+{
+public:
+    
+    explicit SpscRing(size_t capacity) : slots(capacity + 1) {}
+    
+    // Producer thread
+    bool push(const T & item)
+    {
+        size_t tail = write.load(std::memory_order_relaxed);
+        size_t next = tail + 1 == slots.size() ? 0 : tail + 1;
+        if ( next == read.load(std::memory_order_acquire) ) return false;
+        slots[tail] = item;
+        write.store(next, std::memory_order_release);
+        return true;
+    }
+    // Consumer thread
+    bool pop(T & item)
+    {
+        size_t head = read.load(std::memory_order_relaxed);
+        if ( head == write.load(std::memory_order_acquire) ) return false;
+        item = slots[head];
+        read.store(head + 1 == slots.size() ? 0 : head + 1, std::memory_order_release);
+        return true;
+    }
+    // Consumer thread, with no producer running
+    void clear() { read.store(write.load()); }
+    
+private:
+    
+    std::vector<T> slots;
+    alignas(64) std::atomic<size_t> write { 0 };
+    alignas(64) std::atomic<size_t> read { 0 };
+};
@@ -0,0 +1,81 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+// Camera, canvas and animation parameters shared by the app and the headless core.
+
+#define CAMERA_POSE_ROTATION_SPEED      5E-3
+#define CAMERA_POSE_ELEVATION           0.22    // [0,1]
+#define CAMERA_POSE_EXCENTRICITY        0.5     // [0,1]
+
+#define CANVAS_INIT_EXTRUSION           -2.6
+#define CAMERA_INIT_FOCAL               9000
+#define CAMERA_INIT_ZPOS                -1200
+#define CAMERA_INIT_FOV                 70      // degrees
+
+#define SIMULATION_STEP                 (1000 / 60.)    // ms of a fixed animation step, whatever the frame rate
+#define SIMULATION_MAX_STEPS            15      // steps caught up by a frame (0.25 s), the rest of a longer stall is dropped
+
+#define SPECTRUM_BANDS                  64      // linear, up to the Nyquist frequency
+#define SPECTRUM_DECAY                  0.5     // s of band energy averaged
+#define SPECTRUM_GAIN                   15      // effects intensity: averaged energy * gain + bias
+#define SPECTRUM_BIAS                   0.5
+#define ONSET_HISTORY                   43      // spectrum frames (0.5 s) of flux the onset threshold adapts to
+#define ONSET_RATIO                     1.8     // flux over the recent mean making an onset
+
+#define GRAIN_VOICES                    32      // mixed at once, the oldest is stolen beyond
+#define GRAIN_MAX_PER_FRAME             4       // grains started by a frame at most
+#define GRAIN_MAX_RATE                  40      // grains per second, on average
+#define GRAIN_FADE                      0.005   // s of fade in and out of every voice
+
+#define DEPTH_SIGMA_SPATIAL             1.0     // depth pixels, of the upsampling of a smaller depth
+#define DEPTH_SIGMA_RANGE               24      // colour distance (sum of the 8-bit channel differences) of depth edges
+
+#define LOD_TOLERANCE                   2       // depth variance merged into a block, in 8-bit levels squared
+
+#define GALLERY_VERTEX_BUDGET           (16 << 20)      // vertexes of every painting of the gallery together
+#define GALLERY_MEMORY_BUDGET           ((size_t) 1536 << 20)   // bytes of their canvases
+#define GALLERY_MAX_LEVEL               4       // paintings are downsampled by 2^level, 16 at most
+#define GALLERY_SPACING                 300     // between paintings on the wall, in scene units (source pixels)
+#define GALLERY_BOUNDS_MARGIN           0.1     // of the canvas size, around its bounds for the displaced vertexes
+
+#define SYNAP_DISCHARGE_TIME            800     // ms
+#define SYNAP_DISCHARGE_STRENGH         1E-1    // [0.5,5]
+#define SYNAP_DISCHARGE_DENSITY         1E-4    // [0,1]
+#define SYNAP_DISCHARGE_SOUND_DENSITY   0.05    // [0,1]
+#define SYNAP_LOCAL_MAX_PERTURBATION    3
+#define SYNAP_LOCAL_MAX_NUMBER          2
+#define SYNAP_LOCAL_MIN_NUMBER          1
+#define SYNAP_MIN_LIFESPAN              15
+#define SYNAP_MAX_LIFESPAN              40
+#define SYNAP_MAX_SPEED                 4
+#define SYNAP_CAPACITY                  (1 << 22)   // live synapses
+
+#define FLATTENING_TIME                 5000
+#define INCLUSION_TIME                  4000
+#define INCLUSION_SOUND_DENSITY         0.9     // [0,1]
+#define NOISE_INCREASE_TIME             6000
+#define NOISE_SPEED                     1.12    // [0,...)
+#define NOISE_SAMPLING                  5       // 1,2,...
@@ -0,0 +1,146 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// Minimal 4-wide float and uint32 vectors for the core kernels: SSE2 on x86, NEON on ARM, plain arrays elsewhere.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON
+#endif
+
+struct float4
+{
+#if defined(SIMD_SSE2)
+    __m128 v;
+    float4() {}
+    float4(__m128 v) : v(v) {}
+    float4(float s) : v(_mm_set1_ps(s)) {}
+    float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+    static float4 load(const float * p) { return _mm_loadu_ps(p); }
+    void store(float * p) const { _mm_storeu_ps(p, v); }
+#elif defined(SIMD_NEON)
+    float32x4_t v;
+    float4() {}
+    float4(float32x4_t v) : v(v) {}
+    float4(float s) : v(vdupq_n_f32(s)) {}
+    float4(float a, float b, float c, float d) { float t[4] = { a, b, c, d }; v = vld1q_f32(t); }
+    static float4 load(const float * p) { return vld1q_f32(p); }
+    void store(float * p) const { vst1q_f32(p, v); }
+#else
+    float v[4];
+    float4() {}
+    float4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+    float4(float a, float b, float c, float d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+    static float4 load(const float * p) { return float4(p[0], p[1], p[2], p[3]); }
+    void store(float * p) const { p[0] = v[0]; p[1] = v[1]; p[2] = v[2]; p[3] = v[3]; }
+#endif
+};
+
+struct uint4
+{
+#if defined(SIMD_SSE2)
+    __m128i v;
+    uint4() {}
+    uint4(__m128i v) : v(v) {}
+    uint4(uint32_t s) : v(_mm_set1_epi32((int) s)) {}
+    uint4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) : v(_mm_setr_epi32((int) a, (int) b, (int) c, (int) d)) {}
+#elif defined(SIMD_NEON)
+    uint32x4_t v;
+    uint4() {}
+    uint4(uint32x4_t v) : v(v) {}
+    uint4(uint32_t s) : v(vdupq_n_u32(s)) {}
+    uint4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) { uint32_t t[4] = { a, b, c, d }; v = vld1q_u32(t); }
+#else
+    uint32_t v[4];
+    uint4() {}
+    uint4(uint32_t s) { v[0] = v[1] = v[2] = v[3] = s; }
+    uint4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+#endif
+};
+
+#if defined(SIMD_SSE2)
+inline float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+inline float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+inline float4 min(float4 a, float4 b)       { return _mm_min_ps(a.v, b.v); }
+inline float4 max(float4 a, float4 b)       { return _mm_max_ps(a.v, b.v); }
+inline float4 sqrt(float4 a)                { return _mm_sqrt_ps(a.v); }
+inline float4 abs(float4 a)                 { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+inline uint4 operator+(uint4 a, uint4 b)    { return _mm_add_epi32(a.v, b.v); }
+inline uint4 operator^(uint4 a, uint4 b)    { return _mm_xor_si128(a.v, b.v); }
+inline uint4 operator*(uint4 a, uint4 b)
+{
+    // Low 32 bits of the products, without SSE4.1
+    __m128i even = _mm_mul_epu32(a.v, b.v);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+template<int n> inline uint4 shr(uint4 a)   { return _mm_srli_epi32(a.v, n); }
+inline float4 toFloat(uint4 a)              { return _mm_cvtepi32_ps(a.v); }    // for values below 2^31
+#elif defined(SIMD_NEON)
+inline float4 operator+(float4 a, float4 b) { return vaddq_f32(a.v, b.v); }
+inline float4 operator-(float4 a, float4 b) { return vsubq_f32(a.v, b.v); }
+inline float4 operator*(float4 a, float4 b) { return vmulq_f32(a.v, b.v); }
+inline float4 min(float4 a, float4 b)       { return vminq_f32(a.v, b.v); }
+inline float4 max(float4 a, float4 b)       { return vmaxq_f32(a.v, b.v); }
+inline float4 abs(float4 a)                 { return vabsq_f32(a.v); }
+inline uint4 operator+(uint4 a, uint4 b)    { return vaddq_u32(a.v, b.v); }
+inline uint4 operator^(uint4 a, uint4 b)    { return veorq_u32(a.v, b.v); }
+inline uint4 operator*(uint4 a, uint4 b)    { return vmulq_u32(a.v, b.v); }
+template<int n> inline uint4 shr(uint4 a)   { return vshrq_n_u32(a.v, n); }
+inline float4 toFloat(uint4 a)              { return vcvtq_f32_u32(a.v); }
+#if defined(__aarch64__)
+inline float4 operator/(float4 a, float4 b) { return vdivq_f32(a.v, b.v); }
+inline float4 sqrt(float4 a)                { return vsqrtq_f32(a.v); }
+#else
+inline float4 operator/(float4 a, float4 b) { float x[4], y[4]; a.store(x); b.store(y); return float4(x[0]/y[0], x[1]/y[1], x[2]/y[2], x[3]/y[3]); }
+inline float4 sqrt(float4 a)                { float x[4]; a.store(x); return float4(std::sqrt(x[0]), std::sqrt(x[1]), std::sqrt(x[2]), std::sqrt(x[3])); }
+#endif
+#else
+#define SIMD_LANEWISE(expr) float4 r; for (int i = 0; i < 4; ++i) r.v[i] = expr; return r;
+inline float4 operator+(float4 a, float4 b) { SIMD_LANEWISE(a.v[i] + b.v[i]) }
+inline float4 operator-(float4 a, float4 b) { SIMD_LANEWISE(a.v[i] - b.v[i]) }
+inline float4 operator*(float4 a, float4 b) { SIMD_LANEWISE(a.v[i] * b.v[i]) }
+inline float4 operator/(float4 a, float4 b) { SIMD_LANEWISE(a.v[i] / b.v[i]) }
+inline float4 min(float4 a, float4 b)       { SIMD_LANEWISE(std::min(a.v[i], b.v[i])) }
+inline float4 max(float4 a, float4 b)       { SIMD_LANEWISE(std::max(a.v[i], b.v[i])) }
+inline float4 sqrt(float4 a)                { SIMD_LANEWISE(std::sqrt(a.v[i])) }
+inline float4 abs(float4 a)                 { SIMD_LANEWISE(std::abs(a.v[i])) }
+inline float4 toFloat(uint4 a)              { SIMD_LANEWISE((float) a.v[i]) }
+#define SIMD_LANEWISE_U(expr) uint4 r; for (int i = 0; i < 4; ++i) r.v[i] = expr; return r;
+inline uint4 operator+(uint4 a, uint4 b)    { SIMD_LANEWISE_U(a.v[i] + b.v[i]) }
+inline uint4 operator^(uint4 a, uint4 b)    { SIMD_LANEWISE_U(a.v[i] ^ b.v[i]) }
+inline uint4 operator*(uint4 a, uint4 b)    { SIMD_LANEWISE_U(a.v[i] * b.v[i]) }
+template<int n> inline uint4 shr(uint4 a)   { SIMD_LANEWISE_U(a.v[i] >> n) }
+#endif
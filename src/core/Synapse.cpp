@@ -0,0 +1,187 @@
+#include <cmath>
+#include <algorithm>
+#include "Synapse.h"
+#include "Noise.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "Settings.h"
+
+// Random streams of a synapse: a few at birth, then some per step
+enum { STREAM_LIFESPAN = 0, STREAM_DX, STREAM_DY };
+enum { STREAM_STEP_X = 0, STREAM_STEP_Y, STREAM_GRAIN, STEP_STREAMS };
+
+//--------------------------------------------------------------
+void SynapsePool::setCapacity(size_t c)
+{
+    clear();
+    capacity = c;
+}
+void SynapsePool::clear()
+{
+    used = live = 0;
+    free_slots.clear();
+}
+size_t SynapsePool::bytes() const
+{
+    return positions.bytes() + dx.bytes() + dy.bytes() + ages.bytes() + lifespans.bytes() + keys.bytes() + steps.bytes()
+         + free_slots.bytes() + sparks.bytes() + row_starts.bytes() + row_cursors.bytes();
+}
+void SynapsePool::grow()
+{
+    // Storage grows by doubling up to the capacity, and is kept from then on
+    size_t n = std::min(capacity, std::max<size_t>(4096, positions.capacity() * 2));
+    positions.reserve(n);
+    dx.reserve(n);
+    dy.reserve(n);
+    ages.reserve(n);
+    lifespans.reserve(n);
+    keys.reserve(n);
+    steps.reserve(n);
+    free_slots.reserve(n);
+    sparks.reserve(n);
+}
+bool SynapsePool::fire(int position, uint32_t seed)
+{
+    if ( ! capacity ) setCapacity(SYNAP_CAPACITY);
+    
+    size_t slot;
+    if ( free_slots.size() )
+    {
+        slot = free_slots[free_slots.size() - 1];
+        free_slots.resize(free_slots.size() - 1);
+    }
+    else if ( used < capacity )
+    {
+        if ( used == positions.capacity() ) grow();
+        slot = used++;
+        positions.resize(used);
+        dx.resize(used);
+        dy.resize(used);
+        ages.resize(used);
+        lifespans.resize(used);
+        keys.resize(used);
+        steps.resize(used);
+    }
+    else { ++dropped; return false; }
+    
+    uint32_t key = Random::hash(seed, (uint32_t) slot);
+    positions[slot] = position;
+    lifespans[slot] = SYNAP_MIN_LIFESPAN + (SYNAP_MAX_LIFESPAN - SYNAP_MIN_LIFESPAN) * Random::hashuf(key, STREAM_LIFESPAN);
+    ages[slot] = lifespans[slot];
+    dx[slot] = SYNAP_MAX_SPEED * Random::hashf(key, STREAM_DX);
+    dy[slot] = SYNAP_MAX_SPEED * Random::hashf(key, STREAM_DY);
+    keys[slot] = key;
+    steps[slot] = 1;
+    ++live;
+    return true;
+}
+//--------------------------------------------------------------
+void SynapsePool::sort(const Canvas & canvas)
+{
+    const int width = canvas.width, height = canvas.height;
+    row_starts.resize(height + 1);
+    std::fill(row_starts.begin(), row_starts.end(), 0);
+    for ( size_t s = 0; s < used; ++s )
+        if ( lifespans[s] > 0 ) ++row_starts[positions[s] / width + 1];
+    for ( int y = 0; y < height; ++y ) row_starts[y + 1] += row_starts[y];
+    
+    sparks.resize(row_starts[height]);
+    row_cursors = row_starts;
+    for ( size_t s = 0; s < used; ++s )
+    {
+        if ( lifespans[s] <= 0 ) continue;
+        Spark & spark = sparks[row_cursors[positions[s] / width]++];
+        spark.position = positions[s];
+        spark.life = lifespans[s] / ages[s];
+    }
+}
+void SynapsePool::collect()
+{
+    for ( size_t s = 0; s < used; ++s )
+    {
+        if ( lifespans[s] >= 0 ) continue;
+        lifespans[s] = 0;
+        free_slots.resize(free_slots.size() + 1);
+        free_slots[free_slots.size() - 1] = s;
+        --live;
+    }
+    // Once all died, slots are handed out from the start again
+    if ( ! live ) clear();
+}
+//--------------------------------------------------------------
+void SynapsePool::restore(Canvas & canvas)
+{
+    if ( ! live ) return;
+    
+    sort(canvas);
+    parallelFor(canvas.height, [&](size_t begin, size_t end) {
+        for ( size_t o = row_starts[begin]; o < row_starts[end]; ++o )
+        {
+            int pos = canvas.vertexAt(sparks[o].position);
+            if ( pos < 0 ) continue;
+            // Alpha belongs to the inclusion cut
+            float alpha = canvas.animated_colors[pos].a;
+            canvas.animated_colors[pos] = canvas.colors[pos];
+            canvas.animated_colors[pos].a = alpha;
+            canvas.animated_vertexes[pos] = canvas.vertexes[pos];
+        }
+    });
+}
+size_t SynapsePool::step(const Canvas & canvas)
+{
+    if ( ! live ) return 0;
+    
+    // Move them slot by slot, the ones still alive may play a grain
+    const int width = canvas.width, height = canvas.height;
+    size_t grains = parallelReduce(used, (size_t) 0, [&](size_t begin, size_t end) {
+        size_t g = 0;
+        for ( size_t s = begin; s < end; ++s )
+        {
+            if ( lifespans[s] <= 0 ) continue;
+            uint32_t counter = steps[s]++ * STEP_STREAMS;
+            int pos = positions[s];
+            int y = pos / width;
+            int x = pos - y * width;
+            x += std::round( dx[s] * (0.5f + 0.5f * Random::hashuf(keys[s], counter + STREAM_STEP_X)) );
+            y += std::round( dy[s] * (0.5f + 0.5f * Random::hashuf(keys[s], counter + STREAM_STEP_Y)) );
+            
+            --lifespans[s];
+            if ( x < 1 || y < 1 || x >= width-1 || y >= height-1 ) lifespans[s] = 0;
+            else positions[s] = y * width + x;
+            if ( ! lifespans[s] ) lifespans[s] = -1;
+            else g += Random::hashuf(keys[s], steps[s] * STEP_STREAMS + STREAM_GRAIN) < SYNAP_DISCHARGE_SOUND_DENSITY;
+        }
+        return g;
+    }, [](size_t a, size_t b) { return a + b; });
+    collect();
+    return grains;
+}
+void SynapsePool::discharge(Canvas & canvas, float time)
+{
+    if ( ! live ) return;
+    
+    // Local perturbation discharge at the current positions
+    Vec3 * pVertexes = canvas.animated_vertexes.data();
+    Color * pColors = canvas.animated_colors.data();
+    sort(canvas);
+    parallelFor(canvas.height, [&](size_t begin, size_t end) {
+        for ( size_t o = row_starts[begin]; o < row_starts[end]; ++o )
+        {
+            const Spark & spark = sparks[o];
+            int pos = canvas.vertexAt(spark.position);
+            if ( pos < 0 ) continue;
+            
+            // Color: brighter and less saturated the younger the synapse
+            Color & c = pColors[pos];
+            float h, s, v;
+            c.getHsb(h, s, v);
+            c.setHsb(h, s * (1 - spark.life), v + (Color::limit() - v) * 3.0 * spark.life);
+            
+            // 3D Position
+            float perturbation[4];
+            float t = time + spark.position;
+            signedNoise1(float4(t + 10, t + 20, t + 30, 0)).store(perturbation);
+            pVertexes[pos] += Vec3(perturbation[0], perturbation[1], perturbation[2]) * SYNAP_LOCAL_MAX_PERTURBATION;
+        }
+    });
+}
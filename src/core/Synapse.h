@@ -0,0 +1,81 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "Buffer.h"
+#include "Canvas.h"
+
+// Synapse particles in fixed-capacity structure-of-arrays storage.
+// Dead slots go to a free list and are recycled by the next firings; every particle draws its
+// random numbers from its own counter-based stream, so updates run in parallel and stay reproducible.
+
+class SynapsePool
+{
+public:
+    
+    void setCapacity(size_t capacity);
+    size_t getCapacity() const { return capacity; }
+    
+    // Spawns a synapse at a canvas position, returns false when the pool is full
+    bool fire(int position, uint32_t seed);
+    // Calms down the canvas under every synapse, before the frame is animated
+    void restore(Canvas & canvas);
+    // Moves every synapse one simulation step, returns the grains to play
+    size_t step(const Canvas & canvas);
+    // Lights up the canvas under every synapse
+    void discharge(Canvas & canvas, float time);
+    void clear();
+    
+    size_t size() const { return live; }
+    bool empty() const { return ! live; }
+    size_t getDropped() const { return dropped; }
+    size_t bytes() const;
+    
+private:
+    
+    void grow();
+    void collect();
+    // Counting sort of the live synapses by canvas row into 'sparks': rows can then be written
+    // in parallel without races, and the canvas is visited in memory order
+    void sort(const Canvas & canvas);
+    
+    size_t capacity = 0, used = 0, live = 0, dropped = 0;
+    
+    // Slot data
+    Buffer<int> positions;
+    Buffer<float> dx, dy, ages;
+    Buffer<int> lifespans;          // 0 for a free slot, -1 for a synapse that just died
+    Buffer<uint32_t> keys, steps;
+    Buffer<uint32_t> free_slots;
+    
+    // What a synapse does to the canvas this step
+    struct Spark {
+        int position;
+        float life;
+    };
+    Buffer<Spark> sparks;
+    Buffer<size_t> row_starts, row_cursors;
+};
@@ -0,0 +1,130 @@
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <algorithm>
+#include "Topology.h"
+#include "Parallel.h"
+
+typedef std::tuple<int, int, Primitive, bool> TopologyKey;     // width, height, primitive, fill
+
+static std::mutex mutex;
+static std::map<TopologyKey, std::shared_ptr<const Topology>> cache;
+
+//--------------------------------------------------------------
+// Cells of tile t: x in [x0, x1), y in [y0, y1)
+static void tileCells(const Topology & topology, size_t t, int & x0, int & x1, int & y0, int & y1)
+{
+    x0 = (t % topology.tiles_x) * Topology::tile;
+    y0 = (t / topology.tiles_x) * Topology::tile;
+    x1 = std::min(x0 + Topology::tile, topology.width - 1);
+    y1 = std::min(y0 + Topology::tile, topology.height - 1);
+}
+// Indices of a tile of cw x ch cells
+static size_t tileCount(Primitive primitive, bool fill, int cw, int ch)
+{
+    if ( primitive == PRIMITIVE_TRIANGLE_STRIP ) return (size_t) ch * (2 * (cw + 1) + 1);
+    return (size_t) cw * ch * (fill ? 6 : 3);
+}
+static void buildTiles(Topology & topology, bool fill)
+{
+    const size_t tiles = (size_t) topology.tiles_x * topology.tiles_y;
+    topology.tile_starts.resize(tiles + 1);
+    size_t offset = 0;
+    for ( size_t t = 0; t < tiles; ++t )
+    {
+        int x0, x1, y0, y1;
+        tileCells(topology, t, x0, x1, y0, y1);
+        topology.tile_starts[t] = offset;
+        offset += tileCount(topology.primitive, fill, x1 - x0, y1 - y0);
+    }
+    topology.tile_starts[tiles] = offset;
+    topology.indices.resize(offset);
+    
+    const int width = topology.width;
+    const bool strips = topology.primitive == PRIMITIVE_TRIANGLE_STRIP;
+    parallelFor(tiles, [&](size_t begin, size_t end) {
+        for ( size_t t = begin; t < end; ++t )
+        {
+            int x0, x1, y0, y1;
+            tileCells(topology, t, x0, x1, y0, y1);
+            unsigned int * index = topology.indices.data() + topology.tile_starts[t];
+            for ( int y = y0; y < y1; ++y )
+            {
+                if ( strips )
+                {
+                    // Zig-zag between row y and y+1 across the tile: the cell triangles are the same as the triangle list ones
+                    for ( int x = x0; x <= x1; ++x )
+                    {
+                        *index++ = x + y     * width;
+                        *index++ = x + (y+1) * width;
+                    }
+                    *index++ = Topology::restart;
+                    continue;
+                }
+                for ( int x = x0; x < x1; ++x )
+                {
+                    *index++ = x     + y     * width;
+                    *index++ = (x+1) + y     * width;
+                    *index++ = x     + (y+1) * width;
+                    
+                    if ( ! fill ) continue;
+                    
+                    *index++ = (x+1) + y     * width;
+                    *index++ = (x+1) + (y+1) * width;
+                    *index++ = x     + (y+1) * width;
+                }
+            }
+        }
+    });
+}
+//--------------------------------------------------------------
+std::shared_ptr<const Topology> TopologyCache::get(int width, int height, RenderMode render, bool strips)
+{
+    // Points and wireframe share the same triangle list, wireframe and fill the same strips
+    Primitive primitive = strips ? (render == RENDER_POINTS ? PRIMITIVE_POINTS : PRIMITIVE_TRIANGLE_STRIP) : PRIMITIVE_TRIANGLES;
+    bool fill = ! strips && render == RENDER_FILL;
+    TopologyKey key(width, height, primitive, fill);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = cache.find(key);
+    if ( cached != cache.end() ) return cached->second;
+    
+    // Drop the topologies no canvas uses anymore, beyond a few
+    size_t unused = 0;
+    for (auto it = cache.begin(); it != cache.end(); )
+    {
+        if ( it->second.use_count() == 1 && ++unused > max_unused ) it = cache.erase(it);
+        else ++it;
+    }
+    
+    std::shared_ptr<Topology> topology = std::make_shared<Topology>();
+    topology->width = width;
+    topology->height = height;
+    topology->primitive = primitive;
+    if ( width >= 2 && height >= 2 )
+    {
+        topology->tiles_x = (width - 2) / Topology::tile + 1;
+        topology->tiles_y = (height - 2) / Topology::tile + 1;
+        if ( primitive != PRIMITIVE_POINTS ) buildTiles(*topology, fill);
+    }
+    cache[key] = topology;
+    return topology;
+}
+size_t TopologyCache::count(int width, int height, RenderMode render, bool strips)
+{
+    if ( width < 2 || height < 2 || (strips && render == RENDER_POINTS) ) return 0;
+    Primitive primitive = strips ? PRIMITIVE_TRIANGLE_STRIP : PRIMITIVE_TRIANGLES;
+    bool fill = ! strips && render == RENDER_FILL;
+    // Full tiles, then the last column and row of partial ones
+    const int cells_x = width - 1, cells_y = height - 1, t = Topology::tile;
+    const int full_x = cells_x / t, full_y = cells_y / t, rest_x = cells_x % t, rest_y = cells_y % t;
+    return (size_t) full_x * full_y * tileCount(primitive, fill, t, t)
+         + (rest_x ? full_y * tileCount(primitive, fill, rest_x, t) : 0)
+         + (rest_y ? full_x * tileCount(primitive, fill, t, rest_y) : 0)
+         + (rest_x && rest_y ? tileCount(primitive, fill, rest_x, rest_y) : 0);
+}
+void TopologyCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.clear();
+}
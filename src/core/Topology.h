@@ -0,0 +1,72 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <memory>
+#include "Buffer.h"
+
+enum RenderMode {
+    RENDER_POINTS = 0,
+    RENDER_WIREFRAME,
+    RENDER_FILL
+};
+
+enum Primitive {
+    PRIMITIVE_POINTS = 0,       // no indices, one point per vertex
+    PRIMITIVE_TRIANGLES,
+    PRIMITIVE_TRIANGLE_STRIP    // one strip per row, separated by Topology::restart
+};
+
+// Index buffer of a width x height grid. It only depends on the grid size and render mode,
+// so canvases of the same size (other examples, every video frame) share the same one.
+// Grid indices are laid out tile after tile, of 'tile' x 'tile' cells in row-major order, so the cells of any
+// screen region are a few contiguous ranges: tile t spans [tile_starts[t], tile_starts[t + 1]). Strips then run
+// along the rows of a tile. Topologies built otherwise (level of detail) have no tiles.
+
+struct Topology
+{
+    static const unsigned int restart = 0xFFFFFFFF;
+    static const int tile = 64;
+    
+    int width, height;
+    Primitive primitive;
+    Buffer<unsigned int> indices;
+    int tiles_x = 0, tiles_y = 0;
+    Buffer<uint32_t> tile_starts;       // empty for points, which are drawn without indices
+};
+
+class TopologyCache
+{
+public:
+    
+    // Strips need primitive restart, and take about a third of the triangle list memory.
+    // Without strips, the layout is the original one: a triangle per cell for points and wireframe, two for fill.
+    static std::shared_ptr<const Topology> get(int width, int height, RenderMode render, bool strips);
+    // Indices of the topology get() builds
+    static size_t count(int width, int height, RenderMode render, bool strips);
+    static void clear();
+    
+    static const size_t max_unused = 4;
+};
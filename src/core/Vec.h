@@ -0,0 +1,131 @@
+/*
+The code in this repository is available under the MIT License.
+
+Copyright (c) 2019 - Rafael Redondo
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+// Plain vector and color types for the headless core.
+// Memory layouts match glm::vec3 and ofFloatColor so buffers can be handed to the GPU as they are.
+
+struct Vec3
+{
+    float x, y, z;
+    
+    Vec3() : x(0), y(0), z(0) {}
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+    
+    Vec3 operator+(const Vec3 & v) const { return Vec3(x + v.x, y + v.y, z + v.z); }
+    Vec3 operator-(const Vec3 & v) const { return Vec3(x - v.x, y - v.y, z - v.z); }
+    Vec3 operator*(float s) const        { return Vec3(x * s, y * s, z * s); }
+    Vec3 & operator+=(const Vec3 & v)    { x += v.x; y += v.y; z += v.z; return *this; }
+    Vec3 & operator*=(float s)           { x *= s; y *= s; z *= s; return *this; }
+    float length() const                 { return std::sqrt(x * x + y * y + z * z); }
+};
+
+inline Vec3 operator*(float s, const Vec3 & v) { return v * s; }
+inline float dot(const Vec3 & a, const Vec3 & b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(const Vec3 & a, const Vec3 & b) { return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+inline Vec3 normalize(const Vec3 & v) { float l = v.length(); return l > 0 ? v * (1 / l) : v; }
+
+// 8-bit RGBA, the compact form used to store rest colours
+struct Color8
+{
+    unsigned char r, g, b, a;
+};
+
+struct Color
+{
+    float r, g, b, a;
+    
+    Color() : r(0), g(0), b(0), a(1) {}
+    Color(const Color8 & c) { const float k = 1 / 255.f; r = c.r * k; g = c.g * k; b = c.b * k; a = c.a * k; }
+    Color(float r, float g, float b, float a = 1) : r(r), g(g), b(b), a(a) {}
+    static Color fromBytes(int r, int g, int b, int a = 255) { const float k = 1 / 255.f; return Color(r * k, g * k, b * k, a * k); }
+    
+    // HSB helpers, same conventions as ofColor_<float> (all channels in [0,1])
+    static float limit() { return 1.f; }
+    float getBrightness() const { return std::max(r, std::max(g, b)); }
+    float getSaturation() const
+    {
+        float max = getBrightness();
+        float min = std::min(r, std::min(g, b));
+        if ( max == min ) return 0;
+        return (max - min) / max;
+    }
+    void getHsb(float & hue, float & saturation, float & brightness) const
+    {
+        float max = getBrightness();
+        if ( max == 0 ) { hue = saturation = brightness = 0; return; }
+        float min = std::min(r, std::min(g, b));
+        if ( max == min ) { hue = saturation = 0; brightness = max; return; }
+        float hueSixth;
+        if ( r == max )
+        {
+            hueSixth = (g - b) / (max - min);
+            if ( hueSixth < 0 ) hueSixth += 6;
+        }
+        else if ( g == max ) hueSixth = 2 + (b - r) / (max - min);
+        else                 hueSixth = 4 + (r - g) / (max - min);
+        hue = hueSixth / 6.f;
+        saturation = (max - min) / max;
+        brightness = max;
+    }
+    void setHsb(float hue, float saturation, float brightness)
+    {
+        saturation = std::min(std::max(saturation, 0.f), 1.f);
+        brightness = std::min(std::max(brightness, 0.f), 1.f);
+        if ( brightness == 0 ) { r = g = b = 0; return; }
+        if ( saturation == 0 ) { r = g = b = brightness; return; }
+        float hueSix = hue * 6.f;
+        int hueSixCategory = (int) std::floor(hueSix);
+        float hueSixRemainder = hueSix - hueSixCategory;
+        float pv = (1.f - saturation) * brightness;
+        float qv = (1.f - saturation * hueSixRemainder) * brightness;
+        float tv = (1.f - saturation * (1.f - hueSixRemainder)) * brightness;
+        switch (hueSixCategory)
+        {
+            default:
+            case 0: r = brightness; g = tv; b = pv; break;
+            case 1: r = qv; g = brightness; b = pv; break;
+            case 2: r = pv; g = brightness; b = tv; break;
+            case 3: r = pv; g = qv; b = brightness; break;
+            case 4: r = tv; g = pv; b = brightness; break;
+            case 5: r = brightness; g = pv; b = qv; break;
+        }
+    }
+    void setBrightness(float brightness)
+    {
+        float h, s, v;
+        getHsb(h, s, v);
+        setHsb(h, s, brightness);
+    }
+    void setSaturation(float saturation)
+    {
+        float h, s, v;
+        getHsb(h, s, v);
+        setHsb(h, saturation, v);
+    }
+};
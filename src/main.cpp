@@ -1,13 +1,32 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "Converter.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char ** argv){
+	// Batch conversion of the examples into precomputed canvases, no window
+	for (int a = 1; a < argc; ++a)
+	{
+		if (string(argv[a]) != "--convert") continue;
+		string directory = a + 1 < argc && string(argv[a + 1]) != "--geometry" ? argv[a + 1] : ofToDataPath("", true);
+		bool geometry = false;
+		for (int g = 1; g < argc; ++g) geometry |= string(argv[g]) == "--geometry";
+		return convertDirectory(directory, geometry) ? 0 : 1;
+	}
+	for (int a = 1; a < argc; ++a)
+	{
+		if (string(argv[a]) != "--envelope") continue;
+		return convertSoundtrack(a + 1 < argc ? argv[a + 1] : ofToDataPath(SOUNDTRACK, true)) ? 0 : 1;
+	}
+	
 	ofSetupOpenGL(1024,768,OF_FULLSCREEN);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofApp * app = new ofApp();
+	for (int a = 1; a + 1 < argc; ++a)
+		if (string(argv[a]) == "--replay") app->replay_path = argv[a + 1];
+	ofRunApp(app);
 
 }
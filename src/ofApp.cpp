@@ -1,5 +1,6 @@
 
 #include "ofApp.h"
+#include "Converter.h"
 
 //--------------------------------------------------------------
 void ofApp::setup()
@@ -9,8 +10,12 @@ void ofApp::setup()
     ofFill();
     ofSetFrameRate(30);
     glPointSize(1);
-    canvas.render = OF_MESH_WIREFRAME;
-    
+    canvas.render = RENDER_WIREFRAME;
+#ifndef TARGET_OPENGLES
+    // Row strips need primitive restart, but take a third of the index memory
+    canvas.strips = glewIsSupported("GL_VERSION_3_1");
+#endif
+
 #ifdef LEAP_MOTION_ON
     hand_id = 0;    // 0-righthand 1-lefthand;
     finger_id = 2;
@@ -19,42 +24,137 @@ void ofApp::setup()
     leap.setMappingY(  50, 100, -ofGetScreenHeight() / 2, ofGetScreenHeight() / 2);
     leap.setMappingZ(   0, 100, -ofGetScreenWidth()  / 2, ofGetScreenWidth()  / 2);
 #endif
-    
+
+#ifdef PROFILER_ON
+    profiler.setup({ "frame", "update", "examples", "video", "decode", "projection", "load", "effects", "synapses", "wave",
+                     "flattening", "inclusion", "noise", "compose", "upload", "culling", "spectrum", "leap", "draw", "background", "canvas", "console" });
+#endif
+
     setupAudio();
     resetCamera();
+    examples.configure(exampleSettings());
+    examples.start(prepareExample, EXAMPLE_CACHE_BUDGET);
+    
+    if ( ! replay_path.empty() )
+    {
+        // Unthrottled, the script loads the examples
+        bReplay = script.load(replay_path);
+        if ( ! bReplay ) ofLogError() << "Replay " << replay_path << ": " << script.error;
+        else
+        {
+            ofSetFrameRate(0);
+            ofSetVerticalSync(false);
+            animator.random.seed(script.seed);
+            ofSeedRandom(script.seed);
+            return;
+        }
+    }
+#ifdef CONTROL_ON
+    if ( control.start(CONTROL_PORT) ) ofLogNotice() << "Control on port " << control.getPort();
+    else                               ofLogError() << "Control: " << control.error;
+#endif
     loadExample(MENINAS);
 }
 
 //--------------------------------------------------------------
 void ofApp::update()
 {
+#ifdef PROFILER_ON
+    profiler.add(STAGE_FRAME, ofGetLastFrameTime() * 1E3);
+#endif
+    PROFILE_STAGE(profiler, STAGE_UPDATE);
+    if ( bReplay ) updateReplay();
+#ifdef CONTROL_ON
+    updateControl();
+#endif
     camera.move(camera.speed);
     
-    if ( bVideo && video.isPlaying() )
     {
-        video.update();
-        video_depth.update();
-        updateCanvas();
+        PROFILE_STAGE(profiler, STAGE_EXAMPLES);
+        examples.configure(exampleSettings());
+        if ( pending_example >= 0 ) presentExample();
     }
     
+    if ( bGallery )
+    {
+        PROFILE_STAGE(profiler, STAGE_VIDEO);
+        gallery.configure(canvas.render, canvas.strips);
+        if ( gallery_video >= 0 )
+        {
+            pipeline.configure(videoSettings());
+            if ( pipeline.swap(gallery[gallery_video].canvas) ) gallery.refresh(gallery_video);
+        }
+    }
+    else if ( bVideo )
+    {
+        // Frames are decoded and projected off the main thread, the newest one is swapped in
+        PROFILE_STAGE(profiler, STAGE_VIDEO);
+        pipeline.configure(videoSettings());
+        if ( pipeline.swap(canvas) )
+        {
+#ifdef PROFILER_ON
+            FramePipeline::Stats stats = pipeline.stats();
+            profiler.add(STAGE_DECODE, stats.decode);
+            profiler.add(STAGE_PROJECTION, stats.projection);
+#endif
+        }
+    }
+    if ( bVideoExport && ! exporter.busy() )
+    {
+        // The sequence is written, the clip plays again
+        bVideoExport = false;
+        startVideo();
+    }
+
 #ifdef ANIMATIONS_ON
-    updateSynapses();
-    updateFlattening();
-    updateInclusion();
-    updateNoise();
+#ifdef SOUND_ON
+    float intensity = spectrum * SPECTRUM_GAIN + SPECTRUM_BIAS;
+#else
+    float intensity = 8 * ofNoise( now() * 1E-3 ) + 1;
+#endif
+#ifdef CONTROL_ON
+    if ( control_intensity >= 0 ) intensity = control_intensity;
+#endif
+    if ( bReplay ) intensity = replay_soundtrack_start < 0 ? replay_intensity
+                             : replay_soundtrack.smoothed((now() - replay_soundtrack_start) * 1E-3) * SPECTRUM_GAIN + SPECTRUM_BIAS;
+    bool bFiring = animator.synapses.size();
+    {
+        PROFILE_STAGE(profiler, STAGE_EFFECTS);
+        if ( bGallery ) updateGallery(intensity);
+        else            animator.update(canvas, now(), intensity);
+    }
+#ifdef PROFILER_ON
+    // Effects that ran, as timed by the animator
+    const double effects[] = { animator.timing.synapses, animator.timing.wave, animator.timing.flattening,
+                               animator.timing.inclusion, animator.timing.noise, animator.timing.compose };
+    for ( size_t e = 0; e < 6 && ! bGallery; ++e ) if ( effects[e] > 0 ) profiler.add(STAGE_SYNAPSES + e, effects[e]);
+#endif
+    if ( bFiring && ! animator.synapses.size() ) ofLogNotice() << "Fire off " << frameNumber();
+#ifdef SOUND_ON
+    grains.trigger(bGallery ? gallery.takeGrains() : animator.takeGrains(), now() * 1E-3);
+#endif
     updatePose();
 #endif
-    
+    {
+        PROFILE_STAGE(profiler, STAGE_UPLOAD);
+        if ( bGallery ) uploadGallery();
+        else            uploadCanvas();
+    }
+    if ( ! bGallery )
+    {
+        PROFILE_STAGE(profiler, STAGE_CULLING);
+        cullCanvas();
+    }
+
 #ifdef SOUND_ON
-    float s = 0;
-    float * band = ofSoundGetSpectrum(SPECTRUM_BANDS);
-    for (size_t b = 0; b < SPECTRUM_BANDS; ++b) s += band[b];
-    if (power.size() > ofGetFrameRate() * SPECTRUM_DECAY ) power.erase(power.begin());
-    power.push_back(s);
-    spectrum = std::accumulate(power.begin(), power.end(), 0.f) / (float) power.size();
+    {
+        PROFILE_STAGE(profiler, STAGE_SPECTRUM);
+        updateSpectrum();
+    }
 #endif
-        
+
 #ifdef LEAP_MOTION_ON
+    PROFILE_STAGE(profiler, STAGE_LEAP);
     hands = leap.getSimpleHands();
     if ( leap.isFrameNew() && hands.size() )
     {
@@ -69,306 +169,276 @@ void ofApp::update()
     }
     leap.markFrameAsOld();
 #endif
+    if ( bReplay ) ++replay_frame;
 }
 
 //--------------------------------------------------------------
 void ofApp::draw()
 {
-    ofDisableDepthTest();
-    ofBackgroundGradient(central_color, edge_color, OF_GRADIENT_CIRCULAR);
-    //ofBackground(central_color * 0.6 - edge_color * 0.4);
-    ofEnableDepthTest();
-    camera.begin();
-    canvas.draw(canvas.render);
-    camera.end();
-    ofDisableDepthTest();
-    
-    if ( ! bConsole ) return;
-    
+    {
+        PROFILE_STAGE(profiler, STAGE_DRAW);
+        {
+            PROFILE_STAGE(profiler, STAGE_BACKGROUND);
+            ofDisableDepthTest();
+            ofBackgroundGradient(central_color, edge_color, OF_GRADIENT_CIRCULAR);
+            //ofBackground(central_color * 0.6 - edge_color * 0.4);
+        }
+        {
+            PROFILE_STAGE(profiler, STAGE_CANVAS);
+            ofEnableDepthTest();
+            camera.begin();
+            if ( bGallery ) drawGallery();
+            else            drawCanvas();
+            camera.end();
+            ofDisableDepthTest();
+        }
+        PROFILE_STAGE(profiler, STAGE_CONSOLE);
+        if ( bConsole ) drawConsole();
+#ifdef PROFILER_ON
+        if ( bGraph ) drawProfile();
+#endif
+    }
+#ifdef PROFILER_ON
+    profiler.endFrame();
+#endif
+}
+void ofApp::drawConsole()
+{
     ofPushStyle();
     ofSetColor(255);
-    string msg = "Source " + ofToString(bVideo ? video.getWidth() : image.getWidth()) + " x "
-                           + ofToString(bVideo ? video.getHeight() : image.getHeight());
+    string msg = "Source " + ofToString(bVideo ? video_width : canvas.width) + " x "
+                           + ofToString(bVideo ? video_height : canvas.height) + (shownSource() && shownSource()->file.isOpen() ? " (mapped)" : "");
+    msg += "\nCanvas: "                 + ofToString(canvas.size()) + " vertexes, " + ofToString(canvas.bytes() >> 20) + " MB";
+    msg += "\nIndices: "                + ofToString(topology ? topology->indices.size() : 0) + (canvas.strips ? " (strips)" : "");
+    const TileCuller::Stats & culled = culler.stats();
+    msg += "\nCulling 'k': "            + (bCulling && ! culler.whole() ? ofToString(culled.visible) + " / " + ofToString(culled.tiles) + " tiles visible, "
+                                          + ofToString(culled.culled) + " culled, " + ofToString(culled.vertexes >> 10) + " K vertexes drawn"
+                                          : string(bCulling ? "whole" : "off"));
+    msg += ", budget 'b': "             + (bBudget ? ofToString(CULL_VERTEX_BUDGET >> 10) + " K, " + ofToString(culled.budgeted) + " tiles dropped" : string("off"));
+    msg += "\nLevel of detail 'l': "   + (canvas.decimated() ? ofToString(100.0 * canvas.size() / (canvas.width * canvas.height), 2) + "% vertexes, "
+                                          + ofToString(canvas.lod.blocks) + " blocks, " + ofToString(canvas.lod.build_time, 1) + " ms" : string("off"));
+    CanvasCache::Stats cached = examples.stats();
+    msg += "\nExamples cache: "       + ofToString(cached.entries) + " prepared, " + ofToString(cached.bytes >> 20) + " / "
+                                        + ofToString(cached.budget >> 20) + " MB, " + ofToString(cached.hits) + " hits, "
+                                        + ofToString(cached.misses) + " misses" + (pending_example >= 0 ? ", loading..." : "");
+    msg += "\nGallery 'a': "            + string(bGallery ? "" : "off");
+    if ( bGallery )
+    {
+        Gallery::Stats shown = gallery.stats();
+        msg += ofToString(shown.paintings) + " paintings, " + ofToString(shown.visible) + " visible, " + ofToString(shown.animated) + " animated, "
+             + ofToString(shown.vertexes >> 10) + " / " + ofToString(shown.vertex_budget >> 10) + " K vertexes, "
+             + ofToString(shown.bytes >> 20) + " / " + ofToString(shown.memory_budget >> 20) + " MB, "
+             + ofToString(shown.topologies) + " topologies" + (shown.bOver ? " (over budget)" : "");
+        msg += "\n  target 'o': "             + (gallery_target == Gallery::ALL ? string("all") : ofToString(gallery_target + 1) + ", "
+                                            + ofToString(gallery[gallery_target].canvas.width) + " x " + ofToString(gallery[gallery_target].canvas.height));
+    }
+    MeshExporter::Progress exported = exporter.progress();
+    msg += "\nExport 'y' ply, 'g' glb, 16 bits 'u': " + string(bQuantize ? "on" : "off");
+    if ( exported.total ) msg += ", " + ofToString(exported.written) + " / " + ofToString(exported.total) + " written, "
+                                 + ofToString(exported.bytes >> 20) + " MB, " + ofToString(exported.ms, 0) + " ms" + (exported.failed ? ", failed" : "");
     msg += "\nFps: "                    + ofToString(ofGetFrameRate(), 2);
+    if ( bVideo )
+    {
+        FramePipeline::Stats stats = pipeline.stats();
+        msg += "\nVideo frame "            + ofToString(stats.frame) + ", latency " + ofToString(stats.latency, 1) + " ms, decoded "
+             + ofToString(stats.decoded)  + ", presented " + ofToString(stats.presented) + ", dropped " + ofToString(stats.dropped);
+    }
     msg += "\nCamera position: "        + ofToString(camera.getPosition(), 2);
     msg += "\nCamera Speed 'arrows': "  + ofToString(camera.speed, 2);
     msg += "\nCamera reset 'return'";
     msg += "\nCamera orbit 'spacebar'";
     msg += "\nFocal distance 'q,w': "   + ofToString(camera.focal, 2);
     msg += "\nExtrusion 'e,r': "        + ofToString(camera.extrusion, 2);
-    msg += "\nSpectrum: "               + ofToString(spectrum, 2);
+    msg += "\nSpectrum: "               + ofToString(spectrum, 2) + ", " + ofToString(onsets) + " onsets"
+                                        + (envelope.frames() ? " (envelope)" : analyzer.running() ? " (live)" : "");
+    GrainEngine::Stats grained = grains.stats();
+    msg += "\nGrains: "                 + ofToString(grained.active) + " / " + ofToString(GRAIN_VOICES) + " voices, "
+                                        + ofToString(grained.started) + " started, " + ofToString(grained.limited) + " limited, "
+                                        + ofToString(grained.stolen) + " stolen";
+#ifdef CONTROL_ON
+    ControlServer::Stats controlled = control.stats();
+    msg += "\nControl: "                + (control.running() ? "port " + ofToString(control.getPort()) + ", " + ofToString(controlled.received) + " commands, "
+                                          + ofToString(controlled.coalesced) + " coalesced, " + ofToString(controlled.dropped) + " dropped, "
+                                          + ofToString(controlled.malformed) + " malformed" : string("off"));
+#endif
     msg += "\nRender mode 'z,x,c'";
     msg += "\nShow depth 'd'";
     msg += "\nPlay soundtrack '.'";
     msg += "\nFirings 's' 'f' 'i' 'n'";
+    msg += "\nEffects 'p': "             + ofToString(animator.timing.total(), 2) + " ms" + (animator.bProfile ? " (separate)" : " (fused)");
+    msg += "\n  synapses "                 + ofToString(animator.timing.synapses, 2) + ", wave " + ofToString(animator.timing.wave, 2)
+         + ", flattening "                  + ofToString(animator.timing.flattening, 2) + ", inclusion " + ofToString(animator.timing.inclusion, 2)
+         + ", noise "                       + ofToString(animator.timing.noise, 2) + ", compose " + ofToString(animator.timing.compose, 2);
+    msg += "\n  wave "                     + string(Effect::name(animator.wave_effect.state)) + ", flattening " + Effect::name(animator.flattening_effect.state)
+         + ", inclusion "                   + Effect::name(animator.inclusion_effect.state) + ", noise " + Effect::name(animator.noise_effect.state)
+         + ", "                             + ofToString(animator.steps) + " steps of " + ofToString(SIMULATION_STEP, 1) + " ms";
+#ifdef PROFILER_ON
+    msg += "\nFrame profile 't' graph, 'v' dump: p95 " + ofToString(profiler.summary(STAGE_FRAME).p95, 1) + " ms, update "
+         + ofToString(profiler.summary(STAGE_UPDATE).p95, 1) + " ms, draw " + ofToString(profiler.summary(STAGE_DRAW).p95, 1) + " ms";
+#endif
 #ifdef LEAP_MOTION_ON
     msg += leap.isConnected() ? "\nLEAP connected!" : "\nLEAP disconnected o_0";
 #endif
     msg += "\nHelp 'h'";
     ofDrawBitmapString(msg, 10, 10);
     ofSetColor(255,0,0);
-    if ( ! bLoaded ) ofDrawBitmapString("Error loading sources o_O", 10, ofGetWindowHeight()-20);
+    if ( ! bLoaded && pending_example < 0 ) ofDrawBitmapString("Error loading sources o_O", 10, ofGetWindowHeight()-20);
     ofPopStyle();
 }
 //--------------------------------------------------------------
 void ofApp::fireSynapses()
 {
-    ofLogNotice() << "Firing! " << ofGetFrameNum();
-    
-    float mFirings = canvas.width * canvas.height * SYNAP_DISCHARGE_DENSITY;
-    nFirings = ofRandom(mFirings * 0.3, mFirings * 2.f);
-    for (size_t n = 0; n < nFirings; ++n)
-    {
-        int pos = round( ofRandom(canvas.width * canvas.height - 1) );
-        size_t nLocalFirings = round(ofRandom(SYNAP_LOCAL_MIN_NUMBER-0.5, SYNAP_LOCAL_MAX_NUMBER+0.5));
-        for (size_t t = 0; t < nLocalFirings; ++t)
-            synapses.push_back( Synapse(pos) );
-    }
-    global_discharge_strengh = ofRandom(0.01, SYNAP_DISCHARGE_STRENGH);
-    firing_starttime = ofGetElapsedTimeMillis();
-    nFirings = synapses.size();
+    ofLogNotice() << "Firing! " << frameNumber();
     
+    if ( bGallery ) gallery.fire(gallery_target, Gallery::SYNAPSES);
+    else            animator.fireSynapses(canvas);
+
 #ifdef SOUND_ON
-    sounddischarge.setSpeed( ofMap(1 - global_discharge_strengh / SYNAP_DISCHARGE_STRENGH, 0, 1, 0.8, 1.2) );
+    const Animator & fired = bGallery && gallery.size() ? gallery[std::max(gallery_target, 0)].animator : animator;
+    sounddischarge.setSpeed( ofMap(1 - fired.global_discharge_strengh / SYNAP_DISCHARGE_STRENGH, 0, 1, 0.8, 1.2) );
     sounddischarge.setPosition(ofRandomuf());
     sounddischarge.play();
 #endif
 }
-void ofApp::updateSynapses()
-{
-    // Mesh pointers
-    auto pColors = canvas.getColorsPointer();
-    auto pVertexes = canvas.getVerticesPointer();
-    
-    // Canvas: global perturbation
-    float thickness = canvas.limits.far.z - canvas.limits.near.z;
-    float elapsed_time = ofGetElapsedTimeMillis() - firing_starttime;
-    if ( elapsed_time < SYNAP_DISCHARGE_TIME )
-    {
-        float inc = elapsed_time / (float) SYNAP_DISCHARGE_TIME;
-        float wave_z =  canvas.limits.far.z - thickness * inc;
-        // inc = inc < 0.1 ? inc / 0.1 : (1 - inc) / 0.9;   // Fast-in, easy-out
-        for (size_t pos = 0; pos < canvas.vertexes.size(); ++pos)
-        {
-            float wave_phase = 1.5 - abs(canvas.vertexes[pos].z - wave_z) / thickness;
-            wave_phase = pow(wave_phase,6);
-            *(pVertexes+pos) = canvas.vertexes[pos]
-                             + (1-wave_phase) * global_discharge_strengh * glm::vec3(ofRandom(-1,1),ofRandom(-1,1),ofRandom(-1,1));
-                            // + inc * global_discharge_strengh * glm::vec3(ofRandom(-1,1),ofRandom(-1,1),ofRandom(-1,1));
-        }
-    }
-    
-    if ( ! synapses.size() ) return;
-
-    // Calm down dead neurons and discharge the others
-    for (auto & s : synapses)
-    {
-        int pos = s.getPosition();
-        *(pColors+pos) = canvas.colors[pos];
-        *(pVertexes+pos) = canvas.vertexes[pos];
-    }
-    
-    // Remove dead neurons
-    synapses.erase(std::remove_if(synapses.begin(), synapses.end(),
-                                  [this](Synapse & s) { return s.discharge(canvas.width, canvas.height); }), synapses.end());
-    
-    // Local perturbation discharge
-    for (auto & s : synapses)
-    {
-        int pos = s.getPosition();
-        
-        // Color
-        float brightness = (pColors+pos)->getBrightness();
-        float inc = (pColors+pos)->limit() - brightness;
-        (pColors+pos)->setBrightness( brightness + inc * 3.0 * s.getLifeFactor());
-        (pColors+pos)->setSaturation( (pColors+pos)->getSaturation() * s.getLifeFactorInv() );
-
-        // 3D Position
-        float n = ofGetElapsedTimef();
-        glm::vec3 perturbation( ofSignedNoise(n+pos+10),
-                                ofSignedNoise(n+pos+20),
-                                ofSignedNoise(n+pos+30));
-        *(pVertexes+pos) += perturbation * SYNAP_LOCAL_MAX_PERTURBATION;// * s.getLifeFactor();
-        
-#ifdef SOUND_ON
-        if ( ofRandomuf() < SYNAP_DISCHARGE_SOUND_DENSITY ) playGrain();
-#endif
-    }
-
-    if ( ! synapses.size() ) ofLogNotice() << "Fire off " << ofGetFrameNum();
-}
 void ofApp::fireFlattening()
 {
-    bFlat = ! bFlat;
-    flattening_starttime = ofGetElapsedTimeMillis();
-}
-void ofApp::updateFlattening()
-{
-    float elapsed_time = ofGetElapsedTimeMillis() - flattening_starttime;
-    flattening =  bFlat ? elapsed_time / (float) FLATTENING_TIME : 1 - elapsed_time / (float) FLATTENING_TIME;
-    if ( flattening < 0 || flattening > 1 ) { flattening = MIN(MAX(flattening, 0.f), 1.f); return; }
-    flattening *= flattening;
-    float middle = (canvas.limits.far.z - canvas.limits.near.z) * 0.5 + canvas.limits.near.z;
-    auto pVertexes = canvas.getVerticesPointer();
-    for (size_t pos = 0; pos < canvas.vertexes.size(); ++pos)
-        (pVertexes+pos)->z = flattening * middle + (1 - flattening) * canvas.vertexes[pos].z;
+    if ( bGallery ) gallery.fire(gallery_target, Gallery::FLATTENING);
+    else            animator.fireFlattening();
 }
 void ofApp::fireInclusion()
 {
-    bInclusion = ! bInclusion;
-    inclusion_starttime = ofGetElapsedTimeMillis();
-}
-void ofApp::updateInclusion()
-{
-    float elapsed_time = ofGetElapsedTimeMillis() - inclusion_starttime;
-    if ( elapsed_time > INCLUSION_TIME ) return;
-    float inclusion = bInclusion ? elapsed_time / (float) INCLUSION_TIME : 1 - elapsed_time / (float) INCLUSION_TIME;
-    // inclusion *= 1 + 0.2 * ofNoise(4 * ofGetElapsedTimeMillis()) * (1-inclusion);
-    float cut = (canvas.limits.far.z - canvas.limits.near.z + 4) * inclusion + canvas.limits.near.z - 2;
-    auto pColors = canvas.getColorsPointer();
-    for (size_t pos = 0; pos < canvas.vertexes.size(); ++pos)
-        (pColors+pos)->a = canvas.vertexes[pos].z > cut ? 1.f : 0.f;
-    
-#ifdef SOUND_ON
-    if ( ofRandomuf() < INCLUSION_SOUND_DENSITY ) playGrain();
-#endif
+    if ( bGallery ) gallery.fire(gallery_target, Gallery::INCLUSION);
+    else            animator.fireInclusion();
 }
 void ofApp::fireNoise()
 {
-    bNoise = ! bNoise;
-    noise_starttime = ofGetElapsedTimeMillis();
+    if ( bGallery ) gallery.fire(gallery_target, Gallery::NOISE);
+    else            animator.fireNoise();
 }
-void ofApp::updateNoise()
+void ofApp::updateCanvas(bool reset)
 {
-    float elapsed_time = ofGetElapsedTimeMillis() - noise_starttime;
-    float noise = bNoise ? elapsed_time / (float) NOISE_INCREASE_TIME : 1 - elapsed_time / (float) NOISE_INCREASE_TIME;
-    if (noise < 0) return;
-    noise = MIN(noise, 1.f);
-    int s = NOISE_SAMPLING;
-    glm::vec2 ss(canvas.width - 2 * s - 1, canvas.height - 2 * s - 1);
-    float speed = NOISE_SPEED;
-    float n = ofGetElapsedTimef();
-#ifdef SOUND_ON
-    float nn = spectrum * 15.f + 0.5;
-#else
-    float nn = 8 * ofNoise( n ) + 1;
-#endif
-    float thick = (canvas.limits.far.z - canvas.limits.near.z);
-    float middle = 0.5 * thick + canvas.limits.near.z;
-    auto pVertexes = canvas.getVerticesPointer();
-    for ( int y = 0; y < canvas.height; y += s )
+    PROFILE_STAGE(profiler, STAGE_LOAD);
+    if ( ! bLoaded ) return;
+    if ( bVideo ) { pipeline.configure(videoSettings()); return; }
+    
+    const ExampleSource * shown = shownSource();
+    if ( ! shown ) return;
+    if ( shown->file.isOpen() ) shown->file.load(canvas, camera.focal, camera.extrusion, bDepth);
+    else
     {
-        float Y = y * canvas.width;
-        for ( int x = 0; x < canvas.width; x += s )
-        {
-            float N = 10 * nn * ofNoise(speed * n + x + Y);
-            int yextra = ss.y > y ? 0 : canvas.height - y - s;
-            int xextra = ss.x > x ? 0 : canvas.width  - x - s;
-            for ( int yy = y; yy < y + s + yextra; ++yy )
-            {
-                int ys = yy * canvas.width;
-                for ( int xx = x; xx < x + s + xextra ; ++xx )
-                {
-                    int pos = xx + ys;
-                    float strength = (canvas.limits.far.z - canvas.vertexes[pos].z) / thick;
-                    strength *= strength;
-                    float inc = N * strength + ofRandom(nn * strength + 1);
-                    if ( flattening >= 1 ) (pVertexes + pos)->z = middle - inc * noise;
-                    else                   (pVertexes + pos)->z -= inc * pow( noise * flattening, 0.5);
-                }
-            }
-        }
+        if ( ! shown->image.isAllocated() || shown->depth.empty() ) return;
+        canvas.load(shown->image.getData(), shown->depth.data(), bDepth);
+        canvas.project(camera.focal, camera.extrusion);
     }
+    if ( reset ) canvas.updateTopology();
 }
-void ofApp::updateCanvas(bool reset)
+void ofApp::updateProjection()
 {
-    if ( ! bLoaded ) return;
+    // Focal and extrusion only move the vertexes along their cached rays
+    canvas.project(camera.focal, camera.extrusion);
+}
+void ofApp::uploadCanvas()
+{
+    if ( ! canvas.size() || ! canvas.topology ) return;
     
-    // Get pixels
-    if ( ! (bVideo ? video.getPixels().isAllocated() : image.getPixels().isAllocated()) )               return;
-    if ( ! (bVideo ? video_depth.getPixels().isAllocated() : image_depth.getPixels().isAllocated()) )   return;
-
-    unsigned char * iData = bVideo ? video.getPixels().getData() : image.getPixels().getData();
-    unsigned char * dData = bVideo ? video_depth.getPixels().getData() : image_depth.getPixels().getData();
+    const float * vertices = &canvas.animated_vertexes[0].x;
+    const float * colors = &canvas.animated_colors[0].r;
     
-    // Reset mesh
-    if ( ! reset )
+    // Indices only change with the topology, shared by both vertex buffers
+    if ( canvas.topology != topology )
     {
-        canvas.clearColors();
-        canvas.clearVertices();
-        canvas.vertexes.clear();
-        canvas.colors.clear();
-
-    } else canvas.clear();
+        topology = canvas.topology;
+        if ( topology->indices.size() )
+        {
+            indices.allocate(topology->indices.size() * sizeof(unsigned int), topology->indices.data(), GL_STATIC_DRAW);
+            for (auto & vbo : vbos) vbo.setIndexBuffer(indices);
+        }
+    }
     
-    glm::vec2 centering = glm::vec2( canvas.width  * 0.5, canvas.height * 0.5 );
-
-    // Update mesh
-    for ( int y = 0; y < canvas.height; ++y )
+    if ( vbos[0].getNumVertices() != (int) canvas.size() )
     {
-        for ( int x = 0; x < canvas.width; ++x )
+        for (auto & vbo : vbos)
         {
-            int pos = x + y * canvas.width;
-            float d = 255 - dData[ bVideo ? pos * 3 : pos ];
-
-            // Color
-            pos *= 3;
-            int r = iData[ pos ];
-            int g = iData[ pos + 1 ];
-            int b = iData[ pos + 2 ];
-            int a = 255.f;
-            ofColor color = bDepth ? ofColor(255-d,255-d,255-d) : ofColor(r,g,b,a);
-            
-            // 3D Location
-            float w = x - centering.x;
-            float h = y - centering.y;
-            ofVec3f v(w,h,-camera.focal);
-            float m = v.length();
-            v /= m; // v.normalize();
-            v *= ( m + d * camera.extrusion ) - ofVec3f(0,0,camera.focal);
-            
-            canvas.addVertex(v);
-            canvas.addColor(color);
-            
-            // Store depth and color
-            canvas.vertexes.push_back(v);
-            canvas.colors.push_back(color);
-
-            if ( ! reset ) continue;
-            if ( x == canvas.width-1 || y == canvas.height-1 ) continue;
-            
-            canvas.addIndex(x     + y     * canvas.width);
-            canvas.addIndex((x+1) + y     * canvas.width);
-            canvas.addIndex(x     + (y+1) * canvas.width);
-            
-            if (canvas.render != OF_MESH_FILL) continue;
-            
-            canvas.addIndex((x+1) + y     * canvas.width);
-            canvas.addIndex((x+1) + (y+1) * canvas.width);
-            canvas.addIndex(x     + (y+1) * canvas.width);
+            vbo.setVertexData(vertices, 3, canvas.size(), GL_DYNAMIC_DRAW, sizeof(Vec3));
+            vbo.setColorData(colors, canvas.size(), GL_DYNAMIC_DRAW, sizeof(Color));
         }
+        return;
     }
-    canvas.limits.far = *std::max_element(canvas.vertexes.begin(), canvas.vertexes.end(), [](glm::vec3 v1,glm::vec3 v2){return v1.z<v2.z;});
-    canvas.limits.near= *std::min_element(canvas.vertexes.begin(), canvas.vertexes.end(), [](glm::vec3 v1,glm::vec3 v2){return v1.z<v2.z;});
+    
+    // Animated output is double-buffered: upload into the buffer the previous frame is not drawing from
+    front = 1 - front;
+    vbos[front].updateVertexData(vertices, canvas.size());
+    vbos[front].updateColorData(colors, canvas.size());
+}
+void ofApp::cullCanvas()
+{
+    // Bounds of what was just uploaded, seen through the camera of the frame
+    culler.bound(canvas);
+    glm::mat4 matrix = camera.getModelViewProjectionMatrix();
+    culler.cull(&matrix[0][0], bBudget ? CULL_VERTEX_BUDGET : 0);
+}
+void ofApp::drawCanvas()
+{
+    if ( ! topology ) return;
+    drawMesh(vbos[front], *topology, canvas.render, bCulling && ! culler.whole() ? &culler.ranges() : nullptr);
+}
+void ofApp::drawMesh(ofVbo & vbo, const Topology & topology, RenderMode render, const vector<TileCuller::Range> * ranges)
+{
+    GLenum mode = GL_FILL;
+    if ( render == RENDER_POINTS )    mode = GL_POINT;
+    if ( render == RENDER_WIREFRAME ) mode = GL_LINE;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    const TileCuller::Range whole = { 0, (uint32_t) (topology.indices.size() ? topology.indices.size() : vbo.getNumVertices()) };
+    const TileCuller::Range * first = ranges ? ranges->data() : &whole;
+    const TileCuller::Range * last = ranges ? first + ranges->size() : &whole + 1;
+    switch (topology.primitive)
+    {
+        case PRIMITIVE_POINTS:
+            for ( auto range = first; range != last; ++range ) vbo.draw(GL_POINTS, range->first, range->count);
+            break;
+        case PRIMITIVE_TRIANGLES:
+            for ( auto range = first; range != last; ++range ) vbo.drawElements(GL_TRIANGLES, range->count, range->first);
+            break;
+        case PRIMITIVE_TRIANGLE_STRIP:
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(Topology::restart);
+            for ( auto range = first; range != last; ++range ) vbo.drawElements(GL_TRIANGLE_STRIP, range->count, range->first);
+            glDisable(GL_PRIMITIVE_RESTART);
+            break;
+    }
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key)
 {
+    if ( bGallery && galleryKeyPressed(key) ) return;
     switch (key)
     {
         case 's': fireSynapses();                                           break;
         case 'f': fireFlattening();                                         break;
         case 'i': fireInclusion();                                          break;
         case 'n': fireNoise();                                              break;
+        case 'p': animator.bProfile = ! animator.bProfile;                  break;
         case 'd': bDepth = ! bDepth; updateCanvas();                        break;
-        case 'z': canvas.render = OF_MESH_POINTS;    updateCanvas(true);    break;
-        case 'x': canvas.render = OF_MESH_WIREFRAME; updateCanvas(true);    break;
-        case 'c': canvas.render = OF_MESH_FILL;      updateCanvas(true);    break;
-        case 'e': camera.extrusion += 0.1;           updateCanvas();        break;
-        case 'r': camera.extrusion -= 0.1;           updateCanvas();        break;
-        case 'q': camera.focal += 500;               updateCanvas();        break;
-        case 'w': camera.focal -= 500;               updateCanvas();        break;
+        case 'l': canvas.lod_tolerance = canvas.lod_tolerance > 0 ? 0 : LOD_TOLERANCE; updateCanvas(true); break;
+        case 'z': canvas.render = RENDER_POINTS;     canvas.updateTopology(); break;
+        case 'x': canvas.render = RENDER_WIREFRAME;  canvas.updateTopology(); break;
+        case 'c': canvas.render = RENDER_FILL;       canvas.updateTopology(); break;
+        case 'e': camera.extrusion += 0.1;           updateProjection();    break;
+        case 'r': camera.extrusion -= 0.1;           updateProjection();    break;
+        case 'q': camera.focal += 500;               updateProjection();    break;
+        case 'w': camera.focal -= 500;               updateProjection();    break;
         case 'h': bConsole = !bConsole;                                     break;
+        case 'y': exportMesh(MeshExporter::FORMAT_PLY);                     break;
+        case 'g': exportMesh(MeshExporter::FORMAT_GLB);                     break;
+        case 'u': bQuantize = ! bQuantize;                                  break;
+        case 'a': if ( bGallery ) closeGallery(); else openGallery();       break;
+        case 'k': bCulling = ! bCulling;                                    break;
+        case 'b': bBudget = ! bBudget;                                      break;
+#ifdef PROFILER_ON
+        case 't': bGraph = ! bGraph;                                        break;
+        case 'v': dumpProfile();                                            break;
+#endif
         case '1': loadExample(MENINAS);                                     break;
         case '2': loadExample(GOYA);                                        break;
         case '3': loadExample(DEGAS);                                       break;
@@ -395,13 +465,10 @@ void ofApp::keyPressed(int key)
         default: break;
     }
 }
-void ofApp::loadExample(Example example)
+bool ofApp::exampleSources(Example example, string & image_name, string & depth_name)
 {
-    string image_name, depth_name;
-    bool request_video = false;
-    
     switch (example) {
-            
+        
         case MENINAS:
             image_name = "velazquez_meninas.jpg";
             depth_name = "velazquez_meninas_depth.png";
@@ -441,69 +508,540 @@ void ofApp::loadExample(Example example)
         case VIDEO:
             image_name = "eurecat_indoor_small.mov";
             depth_name = "depth_indoor_small.mov";
-            request_video = true;
-            break;
+            return true;
         default:
             break;
     }
+    return false;
+}
+bool ofApp::openSource(const string & image_name, const string & depth_name, ExampleSource & source)
+{
+    // Precomputed canvas next to the sources, made on the first load and mapped from then on
+    string image_path = ofToDataPath(image_name), depth_path = ofToDataPath(depth_name);
+    string canvas_path = canvasPath(image_path);
+    uint64_t stamp = CanvasFile::stamp(image_path, depth_path);
+    std::unique_lock<std::mutex> converting = CanvasFile::lock(canvas_path);
+    source.image.clear();
+    source.depth.clear();
+    if ( stamp && source.file.open(canvas_path) && source.file.getStamp() == stamp ) return true;
     
-    if (request_video)
+    source.file.close();
+    if ( ! decodeExample(image_path, depth_path, source.image, source.depth) ) return false;
+    if ( CanvasFile::write(canvas_path, stamp, source.image.getWidth(), source.image.getHeight(), source.image.getData(), source.depth.data())
+         && source.file.open(canvas_path) )
     {
-        bLoaded = video.load(image_name);
-        bLoaded &= video_depth.load(depth_name);
-        
-        if ( ! bLoaded ) { ofLogError() << "Resource not found"; return; }
-        
-        video.setVolume(0);
-        video_depth.setVolume(0);
-        video.play();
-        video_depth.play();
-        
-        canvas.width = video.getWidth();
-        canvas.height = video.getHeight();
-        
-        central_color = edge_color = ofColor(0, 0, 0);
-        bVideo = true;
-
-    } else {
-        
-        bLoaded = image.load(image_name);
-        bLoaded &= image_depth.load(depth_name);
-        
-        if ( ! bLoaded ) { ofLogError() << "Resource not found"; return; }
-
-        // image.resize(image.getWidth() * 0.5, image.getHeight() * 0.5);
-        image_depth.resize(image.getWidth(), image.getHeight());
-        image_depth.setImageType(OF_IMAGE_GRAYSCALE);
-        image.setImageType(OF_IMAGE_COLOR);
-        
-        canvas.width = image.getWidth();
-        canvas.height = image.getHeight();
-
-        central_color = edge_color = image.getPixels().getColor( canvas.width * ( 1 + canvas.height * 0.5 ) );
+        source.image.clear();
+        source.depth.clear();
+    }
+    else ofLogWarning() << "Could not write " << canvas_path;
+    return true;
+}
+// Worker thread of the example cache
+bool ofApp::prepareExample(int key, const CanvasCache::Settings & settings, Canvas & prepared, std::shared_ptr<const void> & source)
+{
+    string image_name, depth_name;
+    if ( exampleSources((Example) key, image_name, depth_name) ) return false;     // videos stream through the pipeline
+    
+    // Kept with the canvas, so showing it never opens nor decodes the sources again
+    auto opened = std::make_shared<ExampleSource>();
+    if ( ! openSource(image_name, depth_name, *opened) ) return false;
+    if ( opened->file.isOpen() ) opened->file.load(prepared, settings.focal, settings.extrusion, false);
+    else
+    {
+        prepared.width = opened->image.getWidth();
+        prepared.height = opened->image.getHeight();
+        prepared.load(opened->image.getData(), opened->depth.data(), false);
+        prepared.project(settings.focal, settings.extrusion);
+    }
+    prepared.updateTopology();
+    source = opened;
+    return true;
+}
+CanvasCache::Settings ofApp::exampleSettings()
+{
+    CanvasCache::Settings settings;
+    settings.focal = camera.focal;
+    settings.extrusion = camera.extrusion;
+    settings.strips = canvas.strips;
+    settings.render = canvas.render;
+    settings.lod_tolerance = canvas.lod_tolerance;
+    return settings;
+}
+void ofApp::loadExample(Example example)
+{
+    // A video being exported gives the players back first
+    if ( bVideoExport ) { exporter.cancel(); exporter.wait(); bVideoExport = false; }
+    
+    if ( example != VIDEO )
+    {
+        // Still examples are prepared by the cache worker and swapped in by update() once ready,
+        // the following ones in the show order are prefetched meanwhile
+        pending_example = example;
+        examples.request(example);
+        for ( int n = 1; n <= EXAMPLE_PREFETCH; ++n ) examples.prefetch((example + n) % VIDEO);
+        presentExample();
+        return;
+    }
+    
+    pending_example = -1;
+    pipeline.stop();
+    shown_origin = CanvasCache::Origin();
+    bLoaded = openVideo();
+    if ( ! bLoaded ) { ofLogError() << "Resource not found"; return; }
+    
+    canvas.width = video_width;
+    canvas.height = video_height;
+    
+    central_color = edge_color = ofColor(0, 0, 0);
+    bVideo = true;
+    shown_example = VIDEO;
+    
+    animator.reset();
+    bDepth = false;
+    updateCanvas(true);
+    startVideo();
+}
+bool ofApp::openVideo()
+{
+    string image_name, depth_name;
+    exampleSources(VIDEO, image_name, depth_name);
+    
+    // Decoded off the main thread, so no textures
+    video.setUseTexture(false);
+    video_depth.setUseTexture(false);
+    bool loaded = video.load(image_name);
+    loaded &= video_depth.load(depth_name);
+    if ( ! loaded ) return false;
+    
+    // Both players are stepped frame by frame by the decode thread
+    video.setVolume(0);
+    video_depth.setVolume(0);
+    video.play();
+    video_depth.play();
+    video.setPaused(true);
+    video_depth.setPaused(true);
+    video_width = video.getWidth();
+    video_height = video.getHeight();
+    video_frames = video.getTotalNumFrames();
+    video_duration = video.getDuration();
+    return true;
+}
+void ofApp::startVideo()
+{
+    double frame_time = video_frames > 0 ? video_duration / video_frames : 1 / 30.;
+    pipeline.start([this](FramePipeline::Frame & frame) { return decodeVideo(frame); }, frame_time);
+}
+void ofApp::presentExample()
+{
+    CanvasCache::State state = examples.state(pending_example);
+    if ( state == CanvasCache::FAILED )
+    {
+        ofLogError() << "Resource not found";
+        bLoaded = false;
+        pending_example = -1;
+        return;
+    }
+    if ( state != CanvasCache::READY ) return;
+    
+    // The painting shown goes back to the cache with its source, unless it is a video frame or shows the depth
+    pipeline.stop();
+    RenderMode render = canvas.render;
+    shown_origin.settings = exampleSettings();
+    shown_origin.bAnimated = true;
+    examples.swap(pending_example, canvas, shown_origin, bLoaded && ! bVideo && ! bDepth ? shown_example : -1);
+    shown_example = pending_example;
+    pending_example = -1;
+    bLoaded = true;
+    
+    // The worker left the source mapped or decoded along the canvas
+    if ( const ExampleSource * shown = shownSource() )
+    {
+        ofPixels colors;
+        colors.setFromExternalPixels(const_cast<unsigned char *>(shown->colors()), canvas.width, canvas.height, OF_PIXELS_RGB);
+        central_color = edge_color = colors.getColor( canvas.width * ( 1 + canvas.height * 0.5 ) );
         central_color.setBrightness(55);
         edge_color.setBrightness(15);
+    }
+    bVideo = false;
+    
+    animator.reset();
+    bDepth = false;
+    canvas.render = render;
+    canvas.updateTopology();
+    // Projected by the worker for the camera of its request: only a change since then projects again
+    const CanvasCache::Settings & prepared = shown_origin.settings;
+    if ( prepared.focal != camera.focal || prepared.extrusion != camera.extrusion )
+    {
+        canvas.project(camera.focal, camera.extrusion);
+        canvas.restore();
+    }
+    else if ( shown_origin.bAnimated ) canvas.restore();
+}
+FramePipeline::Settings ofApp::videoSettings()
+{
+    FramePipeline::Settings settings;
+    settings.focal = camera.focal;
+    settings.extrusion = camera.extrusion;
+    settings.show_depth = bDepth;
+    settings.strips = canvas.strips;
+    settings.render = canvas.render;
+    settings.lod_tolerance = canvas.lod_tolerance;
+    if ( bGallery && gallery_video >= 0 )
+    {
+        // The video painting has a projection of its own, and a full grid as any other painting
+        settings.focal = gallery[gallery_video].focal;
+        settings.extrusion = gallery[gallery_video].extrusion;
+        settings.show_depth = false;
+        settings.lod_tolerance = 0;
+    }
+    return settings;
+}
+bool ofApp::decodeVideo(FramePipeline::Frame & frame)
+{
+    // Decode thread: step both clips to the same frame, looping at the end
+    if ( video.getCurrentFrame() + 1 >= video_frames ) { video.firstFrame(); video_depth.firstFrame(); }
+    else                                               { video.nextFrame();  video_depth.nextFrame(); }
+    video.update();
+    video_depth.update();
+    if ( video_depth.getCurrentFrame() != video.getCurrentFrame() )
+    {
+        video_depth.setFrame(video.getCurrentFrame());
+        video_depth.update();
+    }
+    
+    const ofPixels & pixels = video.getPixels();
+    const ofPixels & depth = video_depth.getPixels();
+    if ( ! pixels.isAllocated() || ! depth.isAllocated() || pixels.getNumChannels() != 3 ) return false;
+    if ( pixels.getWidth() != depth.getWidth() || pixels.getHeight() != depth.getHeight() ) return false;
+    
+    frame.width = pixels.getWidth();
+    frame.height = pixels.getHeight();
+    frame.depth_channels = depth.getNumChannels();
+    frame.index = video.getCurrentFrame();
+    frame.image.resize(pixels.size());
+    frame.depth.resize(depth.size());
+    std::copy(pixels.getData(), pixels.getData() + pixels.size(), frame.image.data());
+    std::copy(depth.getData(), depth.getData() + depth.size(), frame.depth.data());
+    return true;
+}
+void ofApp::exportMesh(MeshExporter::Format format)
+{
+    if ( ! bLoaded || exporter.busy() ) return;
+    string name = ofToDataPath("export_" + ofGetTimestampString("%Y%m%d-%H%M%S"), true);
+    if ( ! bVideo )
+    {
+        exporter.exportCanvas(canvas, name + MeshExporter::extension(format), format, bQuantize);
+        return;
+    }
+    
+    // Every frame of the clip, from the first one: the decode thread stops and the players are stepped by the exporter
+    pipeline.stop();
+    video.setFrame(video_frames - 1);
+    video_depth.setFrame(video_frames - 1);
+    bVideoExport = exporter.exportSequence([this](FramePipeline::Frame & frame) { return decodeVideo(frame); },
+                                           videoSettings(), video_frames, name, format, bQuantize);
+    if ( ! bVideoExport ) startVideo();
+}
+//--------------------------------------------------------------
+void ofApp::openGallery()
+{
+    // The single canvas is left as it is, the video pipeline feeds the gallery instead
+    if ( bVideoExport ) { exporter.cancel(); exporter.wait(); bVideoExport = false; }
+    pipeline.stop();
+    pending_example = -1;
+    gallery.clear();
+    gallery.configure(canvas.render, canvas.strips);
+    gallery_video = -1;
+    for ( int example = MENINAS; example < VIDEO; ++example )
+    {
+        string image_name, depth_name;
+        exampleSources((Example) example, image_name, depth_name);
+        auto opened = std::make_shared<ExampleSource>();
+        if ( ! openSource(image_name, depth_name, *opened) ) { ofLogWarning() << "Gallery: " << image_name << " not found"; continue; }
+        Gallery::Source painting;
+        bool mapped = opened->file.isOpen();
+        painting.width = mapped ? opened->file.width() : opened->image.getWidth();
+        painting.height = mapped ? opened->file.height() : opened->image.getHeight();
+        painting.image = mapped ? opened->file.image() : opened->image.getData();
+        painting.depth = mapped ? opened->file.depth() : opened->depth.data();
+        painting.owner = opened;
+        gallery.add(example, painting);
+    }
+    if ( bVideo || openVideo() )
+    {
+        Gallery::Source frames;
+        frames.width = video_width;
+        frames.height = video_height;
+        gallery_video = gallery.add(VIDEO, frames);
+    }
+    for ( size_t p = 0; p < gallery.size(); ++p ) { gallery[p].focal = camera.focal; gallery[p].extrusion = camera.extrusion; }
+    gallery.arrange();
+    gallery.fit();
+    if ( gallery_video >= 0 ) startVideo();
+    
+    gallery_meshes.clear();
+    gallery_meshes.resize(gallery.size());
+    gallery_target = Gallery::ALL;
+    bGallery = true;
+    camera.orbit = false;
+    camera.speed = glm::vec3(0.f, 0.f, 0.f);
+    setPose(gallery.overview(ofGetWidth() / (float) ofGetHeight()));
+}
+void ofApp::closeGallery()
+{
+    // Back to the canvas shown before, and to its video if it was one
+    pipeline.stop();
+    bGallery = false;
+    gallery.clear();
+    gallery_meshes.clear();
+    gallery_indices.clear();
+    gallery_video = -1;
+    if ( bVideo ) startVideo();
+    else { video.close(); video_depth.close(); }
+    resetCamera();
+}
+void ofApp::updateGallery(float intensity)
+{
+    // Culled against the frame camera, animated where visible and running
+    glm::mat4 matrix = camera.getModelViewProjectionMatrix();
+    gallery.update(&matrix[0][0], now(), intensity);
+}
+void ofApp::uploadGallery()
+{
+    // Only paintings seen and changed since their last upload; indices once per topology
+    bool retopology = false;
+    for ( size_t p = 0; p < gallery.size(); ++p )
+    {
+        const Gallery::Painting & painting = gallery[p];
+        const Canvas & painted = painting.canvas;
+        GalleryMesh & mesh = gallery_meshes[p];
+        if ( ! painting.bVisible || painting.changes == mesh.changes || ! painted.size() || ! painted.topology ) continue;
+        mesh.changes = painting.changes;
+        
+        if ( painted.topology != mesh.topology )
+        {
+            mesh.topology = painted.topology;
+            retopology = true;
+            ofBufferObject & indices = gallery_indices[mesh.topology];
+            if ( mesh.topology->indices.size() )
+            {
+                if ( ! indices.isAllocated() ) indices.allocate(mesh.topology->indices.size() * sizeof(unsigned int), mesh.topology->indices.data(), GL_STATIC_DRAW);
+                for (auto & vbo : mesh.vbos) vbo.setIndexBuffer(indices);
+            }
+        }
+        
+        const float * vertices = &painted.animated_vertexes[0].x;
+        const float * colors = &painted.animated_colors[0].r;
+        if ( mesh.vbos[0].getNumVertices() != (int) painted.size() )
+        {
+            for (auto & vbo : mesh.vbos)
+            {
+                vbo.setVertexData(vertices, 3, painted.size(), GL_DYNAMIC_DRAW, sizeof(Vec3));
+                vbo.setColorData(colors, painted.size(), GL_DYNAMIC_DRAW, sizeof(Color));
+            }
+            continue;
+        }
+        mesh.front = 1 - mesh.front;
+        mesh.vbos[mesh.front].updateVertexData(vertices, painted.size());
+        mesh.vbos[mesh.front].updateColorData(colors, painted.size());
+    }
+    if ( ! retopology ) return;
+    
+    // Index buffers no mesh draws anymore
+    for ( auto it = gallery_indices.begin(); it != gallery_indices.end(); )
+    {
+        bool used = std::any_of(gallery_meshes.begin(), gallery_meshes.end(), [&](const GalleryMesh & mesh) { return mesh.topology == it->first; });
+        if ( used ) ++it;
+        else it = gallery_indices.erase(it);
+    }
+}
+void ofApp::drawGallery()
+{
+    for ( size_t p = 0; p < gallery.size(); ++p )
+    {
+        GalleryMesh & mesh = gallery_meshes[p];
+        if ( ! gallery[p].bVisible || ! mesh.topology ) continue;
+        glm::mat4 transform;
+        gallery.transform(p, &transform[0][0]);
+        ofPushMatrix();
+        ofMultMatrix(transform);
+        drawMesh(mesh.vbos[mesh.front], *mesh.topology, gallery[p].canvas.render);
+        ofPopMatrix();
+    }
+}
+bool ofApp::galleryKeyPressed(int key)
+{
+    // Projection keys act on the target painting or all of them, the examples leave the gallery
+    float focal = 0, extrusion = 0;
+    switch (key)
+    {
+        case 'e': extrusion = 0.1;                                          break;
+        case 'r': extrusion = -0.1;                                         break;
+        case 'q': focal = 500;                                              break;
+        case 'w': focal = -500;                                             break;
+        case 'o': gallery_target = gallery_target + 1 < (int) gallery.size() ? gallery_target + 1 : Gallery::ALL; return true;
+        case 'd': case 'l': case 'y': case 'g': case ' ':                   return true;
+        default:
+            if ( key >= '0' && key <= '9' ) closeGallery();
+            return false;
+    }
+    for ( size_t p = 0; p < gallery.size(); ++p )
+        if ( gallery_target == Gallery::ALL || gallery_target == (int) p ) gallery.project(p, gallery[p].focal + focal, gallery[p].extrusion + extrusion);
+    return true;
+}
+//--------------------------------------------------------------
+#ifdef PROFILER_ON
+void ofApp::drawProfile()
+{
+    // One line per stage over the window, newest frame on the right, and the percentiles of each
+    const float left = 10, right = ofGetWindowWidth() - 10, bottom = ofGetWindowHeight() - 40;
+    const float step = (right - left) / FrameProfiler::FRAMES;
+    ofPushStyle();
+    ofSetColor(255, 60);
+    for ( float ms : { 1000 / 60.f, 1000 / 30.f } ) ofDrawLine(left, bottom - ms * PROFILER_GRAPH_SCALE, right, bottom - ms * PROFILER_GRAPH_SCALE);
+    
+    string table = "stage         p50     p95     p99     max";
+    for ( size_t stage = 0; stage < profiler.stages(); ++stage )
+    {
+        FrameProfiler::Summary summary = profiler.summary(stage);
+        if ( ! summary.samples ) continue;
+        ofColor color = ofColor::fromHsb(stage * 255 / STAGES, 180, 255);
+        ofSetColor(color);
+        ofPolyline line;
+        for ( size_t age = 0; age < profiler.frames(); ++age )
+        {
+            float ms = profiler.sample(stage, age);
+            if ( ! std::isnan(ms) ) line.addVertex(right - age * step, bottom - ms * PROFILER_GRAPH_SCALE);
+        }
+        line.draw();
         
-        bVideo = false;
+        char row[128];
+        snprintf(row, sizeof(row), "\n%-10s %7.2f %7.2f %7.2f %7.2f", profiler.name(stage).c_str(), summary.p50, summary.p95, summary.p99, summary.max);
+        table += row;
+        ofDrawBitmapString(profiler.name(stage), right - 90, bottom - summary.last * PROFILER_GRAPH_SCALE);
     }
-
-    bFlat = bNoise =  bInclusion = bDepth = false;
-    updateCanvas(true);
+    ofSetColor(255);
+    ofDrawBitmapString(table, right - 380, 20);
+    ofPopStyle();
 }
+void ofApp::dumpProfile()
+{
+    if ( ! profiler.frames() ) return;
+    string prefix = ofToDataPath("profile_" + ofGetTimestampString("%Y%m%d-%H%M%S"), true);
+    if ( profiler.dump(prefix) ) ofLogNotice() << "Frame profile written to " << prefix << ".csv";
+    else                         ofLogError() << "Frame profile not written to " << prefix << ".csv";
+}
+#endif
+//--------------------------------------------------------------
+double ofApp::now() const
+{
+    return bReplay ? replay_frame * script.step : ofGetElapsedTimeMillis();
+}
+size_t ofApp::frameNumber() const
+{
+    return bReplay ? replay_frame : ofGetFrameNum();
+}
+void ofApp::updateReplay()
+{
+    if ( replay_frame == script.frames() )
+    {
+        // Every frame run: the canvas as the headless runner leaves it
+        ofLogNotice() << "Replay done, " << replay_frame << " frames in " << ofGetElapsedTimef() << " s, checksum "
+                      << ofToHex(Replay::checksum(canvas));
+        bReplay = false;
+        ofExit();
+        return;
+    }
+    
+    // Events due at the virtual time, loads waiting for the cache worker so they land on the same frame
+    for ( size_t last = script.due(replay_next, now()); replay_next < last; ++replay_next )
+    {
+        const ReplayEvent & event = script.events[replay_next];
+        switch ( event.command )
+        {
+            case ReplayEvent::LOAD:
+            {
+                string image_name, depth_name;
+                int example = MENINAS;
+                for ( ; example < VIDEO; ++example )
+                {
+                    exampleSources((Example) example, image_name, depth_name);
+                    if ( ofFilePath::removeExt(image_name) == ofFilePath::removeExt(event.source) ) break;
+                }
+                if ( example == VIDEO ) { ofLogError() << "Replay: no example " << event.source; break; }
+                loadExample((Example) example);
+                while ( pending_example >= 0 ) { ofSleepMillis(1); presentExample(); }
+                break;
+            }
+            case ReplayEvent::FIRE_SYNAPSES:    fireSynapses();                                             break;
+            case ReplayEvent::FIRE_FLATTENING:  fireFlattening();                                           break;
+            case ReplayEvent::FIRE_INCLUSION:   fireInclusion();                                            break;
+            case ReplayEvent::FIRE_NOISE:       fireNoise();                                                break;
+            case ReplayEvent::EXTRUSION:        camera.extrusion = event.value; updateProjection();         break;
+            case ReplayEvent::FOCAL:            camera.focal = event.value;     updateProjection();         break;
+            case ReplayEvent::ORBIT:            camera.orbit = event.value < 0 ? ! camera.orbit : event.value > 0; break;
+            case ReplayEvent::RENDER:           canvas.render = (RenderMode) event.value; canvas.updateTopology(); break;
+            case ReplayEvent::LOD:              canvas.lod_tolerance = event.value > 0 ? LOD_TOLERANCE : 0; updateCanvas(true); break;
+            case ReplayEvent::INTENSITY:        replay_intensity = event.value; replay_soundtrack_start = -1; break;
+            case ReplayEvent::SOUNDTRACK:
+            {
+                // Played along, but the effects follow its envelope on the virtual clock
+                if ( ! replay_soundtrack.load(ofToDataPath(event.source, true)) ) { ofLogError() << "Replay: could not analyze " << event.source; break; }
+                replay_soundtrack_start = now();
+                soundtrack.setPosition(0);
+                soundtrack.play();
+                break;
+            }
+            case ReplayEvent::END:                                                                          break;
+        }
+    }
+}
+//--------------------------------------------------------------
+#ifdef CONTROL_ON
+void ofApp::updateControl()
+{
+    // Actions run in order as keys; parameters come coalesced, and the canvas is projected once however many changed
+    control.drain(control_commands);
+    bool bFocal = false, bExtrusion = false;
+    for ( const ControlCommand & command : control_commands )
+    {
+        if ( command.is("/key") )
+        {
+            int key = (int) command.value;
+            if ( command.argument == ControlCommand::STRING )
+            {
+                const string name = command.text;
+                key = name == "return" ? OF_KEY_RETURN : name == "left" ? OF_KEY_LEFT : name == "right" ? OF_KEY_RIGHT
+                    : name == "up" ? OF_KEY_UP : name == "down" ? OF_KEY_DOWN : name == "space" ? ' ' : name.size() == 1 ? name[0] : 0;
+            }
+            if ( key ) keyPressed(key);
+            else ofLogWarning() << "Control: no key " << command.text;
+        }
+        else if ( command.is("/extrusion") && command.argument == ControlCommand::FLOAT ) { camera.extrusion = command.value; bExtrusion = true; }
+        else if ( command.is("/focal") && command.argument == ControlCommand::FLOAT )     { camera.focal = command.value;     bFocal = true; }
+        else if ( command.is("/intensity") && command.argument == ControlCommand::FLOAT ) control_intensity = command.value;
+        else if ( ! std::strncmp(command.address, "/strength/", 10) && command.argument == ControlCommand::FLOAT )
+        {
+            const string effect = command.address + 10;
+            Animator::Strengths & strengths = animator.strengths;
+            float * strength = effect == "synapses" ? &strengths.synapses : effect == "flattening" ? &strengths.flattening
+                             : effect == "inclusion" ? &strengths.inclusion : effect == "noise" ? &strengths.noise : nullptr;
+            if ( strength ) { *strength = ofClamp(command.value, 0, 1); gallery.strengths = strengths; }
+            else ofLogWarning() << "Control: no effect " << effect;
+        }
+        else ofLogWarning() << "Control: unknown command " << command.address;
+    }
+    if ( ! bFocal && ! bExtrusion ) return;
+    if ( ! bGallery ) { updateProjection(); return; }
+    for ( size_t p = 0; p < gallery.size(); ++p )
+        if ( gallery_target == Gallery::ALL || gallery_target == (int) p )
+            gallery.project(p, bFocal ? camera.focal : gallery[p].focal, bExtrusion ? camera.extrusion : gallery[p].extrusion);
+}
+#endif
 void ofApp::updatePose()
 {
-    if (!camera.orbit) return;
-
-    float travel = ofMap(flattening, 0, 1, 0.8, 1.0);
-    glm::vec3 up( 0, 0, 1);
-    glm::vec3 center(0, 0, (canvas.limits.far.z - canvas.limits.near.z) * 0.5 * travel + canvas.limits.near.z);
-    float angle = ofGetFrameNum() * CAMERA_POSE_ROTATION_SPEED;
-    float elevation = center.z * (0.8 - CAMERA_POSE_ELEVATION * abs(cos(angle)));
-    glm::vec3 origin( center.x, center.y, elevation );
-    glm::vec3 excentricity = glm::rotate(glm::vec3(1,0,0), angle, glm::vec3(0,0,1));
-    glm::vec3 position = origin + excentricity * CAMERA_POSE_EXCENTRICITY * MIN(canvas.width,canvas.height);
-    camera.setPosition(position);
-    camera.lookAt(center,up);
+    if (!camera.orbit || bGallery) return;
+    setPose(CameraPose::orbit(canvas, animator.flattened(), animator.clock.steps()));
 }
 void ofApp::resetCamera()
 {
@@ -511,12 +1049,17 @@ void ofApp::resetCamera()
     camera.speed = glm::vec3(0.f,0.f,0.f);
     camera.extrusion = CANVAS_INIT_EXTRUSION;
     camera.focal = CAMERA_INIT_FOCAL;
-    camera.setScale(-1,-1, 1);
-    camera.setFov(70);
-    camera.setPosition(glm::vec3( 0., 0., CAMERA_INIT_ZPOS ));
-    glm::vec3 center(0, 0, (canvas.limits.far.z - canvas.limits.near.z) * 0.5 + canvas.limits.near.z);
-    glm::vec3 up(0,1,0);
-    camera.lookAt(center,up);
+    setPose(bGallery ? gallery.overview(ofGetWidth() / (float) ofGetHeight()) : CameraPose::initial(canvas));
+}
+void ofApp::setPose(const CameraPose & pose)
+{
+    // The offline renderer (render/Render.cpp) builds its matrix from the same pose
+    camera.setScale(pose.scale.x, pose.scale.y, pose.scale.z);
+    camera.setFov(pose.fov);
+    camera.setNearClip(pose.near_clip);
+    camera.setFarClip(pose.far_clip);
+    camera.setPosition(glm::vec3(pose.position.x, pose.position.y, pose.position.z));
+    camera.lookAt(glm::vec3(pose.target.x, pose.target.y, pose.target.z), glm::vec3(pose.up.x, pose.up.y, pose.up.z));
 }
 //--------------------------------------------------------------
 void ofApp::setupAudio()
@@ -525,30 +1068,69 @@ void ofApp::setupAudio()
     return;
 #endif
     // Players OST and FX
-    soundtrack.load("ClairDeLune_ROLI.wav");
+    soundtrack.load(SOUNDTRACK);
     soundtrack.setVolume(1.f);
     //soundtrack.play();
     sounddischarge.load("SignalInterference29cut.wav");
     sounddischarge.setVolume(0.6);
     sounddischarge.play();
-    soundgrain.load("34170__glaneur-de-sons__electric-wire-03_cut.wav");
-    soundgrain.setVolume(0.6);
-    soundgrain.setMultiPlay(true);
+    auto grain = std::make_shared<Pcm>();
+    if ( grain->loadWav(ofToDataPath(GRAIN_SAMPLE, true)) )
+    {
+        grains.setup(grain, GRAIN_OUTPUT_RATE);
+        ofSoundStreamSettings settings;
+        settings.setOutListener(this);
+        settings.sampleRate = GRAIN_OUTPUT_RATE;
+        settings.numOutputChannels = 2;
+        settings.numInputChannels = 0;
+        settings.bufferSize = 512;
+        if ( ! grain_stream.setup(settings) ) ofLogError() << "Could not open the grains output";
+    }
+    else ofLogError() << "Could not decode " << GRAIN_SAMPLE;
+    
+    // Spectrum envelope made by DepthPainter --envelope, or the samples analyzed live
+    string track = ofToDataPath(SOUNDTRACK, true);
+    if ( envelope.read(envelopePath(track)) ) return;
+    auto pcm = std::make_shared<Pcm>();
+    if ( pcm->loadWav(track) ) analyzer.start(pcm);
+    else ofLogError() << "Could not decode " << track << " for its spectrum";
 }
-void ofApp::playGrain()
+void ofApp::updateSpectrum()
 {
-    soundgrain.setVolume( 1.0 );
-    soundgrain.setPan( ofRandomf() );
-    soundgrain.setPosition( 0.6 * ofRandomuf() );
-    soundgrain.setSpeed( ofMap( ofRandomuf(), 0, 1, 0.7, 4) );
-    soundgrain.play();
-    soundgrain.setPan( ofRandomf() );
-    soundgrain.setSpeed( ofMap( ofRandomuf(), 0, 1, 4, 20) );
-    soundgrain.play();
+    // Band energy of the soundtrack over the last SPECTRUM_DECAY s, none when it does not play
+    bool playing = soundtrack.isPlaying();
+    double position = soundtrack.getPositionMS() * 1E-3;
+    if ( envelope.frames() )
+    {
+        spectrum = playing ? envelope.smoothed(position) : 0;
+        if ( playing ) onsets += envelope.onsets(track_position, position);
+        track_position = position;
+        return;
+    }
+    analyzer.sync(position, playing);
+    analyzer.poll();
+    spectrum = playing ? analyzer.smoothed() : 0;
+    onsets += analyzer.onsets;
+}
+void ofApp::audioOut(ofSoundBuffer & buffer)
+{
+    grains.mix(buffer.getBuffer().data(), buffer.getNumFrames());
 }
 //--------------------------------------------------------------
 void ofApp::exit()
 {
+#ifdef PROFILER_ON
+    dumpProfile();
+#endif
+#ifdef CONTROL_ON
+    control.stop();
+#endif
+    exporter.cancel();
+    exporter.wait();
+    analyzer.stop();
+    grain_stream.close();
+    pipeline.stop();
+    examples.stop();
     video.close();
     video_depth.close();
 #ifdef LEAP_MOTION
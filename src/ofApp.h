@@ -27,39 +27,34 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define SOUND_ON
 #define ANIMATIONS_ON
 #define LEAP_MOTION_ON
+#define PROFILER_ON
+#define CONTROL_ON
 
-#define SYNAP_DISCHARGE_TIME            800     // ms
-#define SYNAP_DISCHARGE_STRENGH         1E-1    // [0.5,5]
-#define SYNAP_DISCHARGE_TIME            800     // ms
-#define SYNAP_DISCHARGE_STRENGH         1E-1    // [0.5,5]
-#define SYNAP_DISCHARGE_DENSITY         1E-4    // [0,1]
-#define SYNAP_DISCHARGE_SOUND_DENSITY   0.05    // [0,1]
-#define SYNAP_LOCAL_MAX_PERTURBATION    3
-#define SYNAP_LOCAL_MAX_NUMBER          2
-#define SYNAP_LOCAL_MIN_NUMBER          1
-#define SYNAP_MIN_LIFESPAN              15
-#define SYNAP_MAX_LIFESPAN              40
-#define SYNAP_MAX_SPEED                 4
-
-#define FLATTENING_TIME                 5000
-#define INCLUSION_TIME                  4000
-#define INCLUSION_SOUND_DENSITY         0.9     // [0,1]
-#define NOISE_INCREASE_TIME             6000
-#define NOISE_SPEED                     1.12    // [0,...)
-#define NOISE_SAMPLING                  5       // 1,2,...
-
-#define SPECTRUM_BANDS                  64
-#define SPECTRUM_DECAY                  0.5
-
-#define CAMERA_POSE_ROTATION_SPEED      5E-3
-#define CAMERA_POSE_ELEVATION           0.22    // [0,1]
-#define CAMERA_POSE_EXCENTRICITY        0.5     // [0,1]
-
-#define CANVAS_INIT_EXTRUSION           -2.6
-#define CAMERA_INIT_FOCAL               9000
-#define CAMERA_INIT_ZPOS                -1200
+#define SOUNDTRACK                      "ClairDeLune_ROLI.wav"
+#define GRAIN_SAMPLE                    "34170__glaneur-de-sons__electric-wire-03_cut.wav"
+#define GRAIN_OUTPUT_RATE               44100
+
+#define EXAMPLE_CACHE_BUDGET            (1024 << 20)    // bytes of prepared examples kept
+#define EXAMPLE_PREFETCH                2               // examples prepared ahead, in the show order
+
+#define CULL_VERTEX_BUDGET              (2 << 20)       // vertexes of the tiles drawn with the budget 'b' on
 
 #include "ofMain.h"
+#include "core/Settings.h"
+#include "core/Canvas.h"
+#include "core/Animator.h"
+#include "core/Audio.h"
+#include "core/Grains.h"
+#include "core/Pipeline.h"
+#include "core/CanvasFile.h"
+#include "core/CanvasCache.h"
+#include "core/Gallery.h"
+#include "core/Culling.h"
+#include "core/Control.h"
+#include "core/Pose.h"
+#include "core/Export.h"
+#include "core/Profiler.h"
+#include "core/Replay.h"
 
 #ifdef LEAP_MOTION_ON
 #define LEAP_MOTION_SENSIBILITY         4E-4    // [0,..)
@@ -79,42 +74,36 @@ enum Example {
     VIDEO
 };
 
-class Synapse {
-    
-public:
-    
-    Synapse(int pos) : position(pos)
-    {
-        age = lifespan = ofRandom(SYNAP_MIN_LIFESPAN, SYNAP_MAX_LIFESPAN);
-        direction = ofPoint( ofRandom(-SYNAP_MAX_SPEED,SYNAP_MAX_SPEED),
-                             ofRandom(-SYNAP_MAX_SPEED,SYNAP_MAX_SPEED) );
-    }
-    ~Synapse(){}
-    bool discharge(int width, int height)
-    {
-        int y = floor(position/width);
-        int x = position - y * width;
-        x += round( direction.x * ofRandom(0.5,1) );
-        y += round( direction.y * ofRandom(0.5,1) );
-        
-        --lifespan;
-        
-        if ( x < 1 || y < 1 || x >= width-1 || y >= height-1) lifespan = 0;
-        else position = y * width + x;
-
-        return died();
-    }
-    bool died() { return lifespan <= 0; }
-    int getPosition() { return position; }
-    float getLifeFactor() { return lifespan / age; }
-    float getLifeFactorInv() { return 1 - getLifeFactor(); }
+#ifdef PROFILER_ON
+#define PROFILER_GRAPH_SCALE            6       // px per ms
 
-private:
-    
-    float age;
-    int lifespan, position;
-    ofPoint direction;
+// Timed stages of a frame
+enum Stage {
+    STAGE_FRAME = 0,                            // interval between frames
+    STAGE_UPDATE,
+    STAGE_EXAMPLES,
+    STAGE_VIDEO,
+    STAGE_DECODE,                               // on the decode thread, per presented video frame
+    STAGE_PROJECTION,                           // on the projection thread, likewise
+    STAGE_LOAD,
+    STAGE_EFFECTS,
+    STAGE_SYNAPSES,
+    STAGE_WAVE,
+    STAGE_FLATTENING,
+    STAGE_INCLUSION,
+    STAGE_NOISE,
+    STAGE_COMPOSE,
+    STAGE_UPLOAD,
+    STAGE_CULLING,
+    STAGE_SPECTRUM,
+    STAGE_LEAP,
+    STAGE_DRAW,
+    STAGE_BACKGROUND,
+    STAGE_CANVAS,
+    STAGE_CONSOLE,
+    STAGES
 };
+#endif
 
 class ofApp : public ofBaseApp
 {
@@ -138,34 +127,35 @@ public:
     void exit();
     
     void loadExample(Example example);
+    void presentExample();
     void fireNoise();
     void fireSynapses();
     void fireInclusion();
     void fireFlattening();
-    void updateNoise();
-    void updateSynapses();
-    void updateInclusion();
-    void updateFlattening();
     void updateCanvas(bool reset = false);
+    void updateProjection();
+    void uploadCanvas();
+    void drawCanvas();
+    // Only the given ranges of the mesh when not null
+    static void drawMesh(ofVbo & vbo, const Topology & topology, RenderMode render, const vector<TileCuller::Range> * ranges = nullptr);
+    void drawConsole();
+    
+    Canvas canvas;
+    Animator animator;
+    ofVbo vbos[2];
+    ofBufferObject indices;
+    std::shared_ptr<const Topology> topology;
+    size_t front = 0;
+    
+    // Tiles of the canvas culled against the camera 'k', the nearest ones within CULL_VERTEX_BUDGET 'b'
+    TileCuller culler;
+    bool bCulling = true, bBudget = false;
+    void cullCanvas();
     
-    class Canvas : public ofMesh
-    {
-        public:
-        vector<glm::vec3> vertexes;
-        vector<ofColor> colors;
-        int width, height;
-        ofPolyRenderMode render;
-        struct Limits {
-            glm::vec3 far, near;
-        } limits;
-        
-        void clear() { colors.clear(); vertexes.clear(); ofMesh::clear(); }
-        
-    } canvas;
-
     void resetCamera();
     void updatePose();
-
+    void setPose(const CameraPose & pose);
+    
     class Camera : public ofEasyCam
     {
         public:
@@ -174,27 +164,105 @@ public:
         bool orbit;
         
     } camera;
-
+    
     ofVideoPlayer video, video_depth;
-    ofImage image, image_depth;
-
+    // Read once by openVideo(): the players belong to the decode (or export) thread while the pipeline runs
+    int video_width = 0, video_height = 0, video_frames = 0;
+    double video_duration = 0;
+    FramePipeline pipeline;
+    FramePipeline::Settings videoSettings();
+    bool openVideo();
+    bool decodeVideo(FramePipeline::Frame & frame);
+    // Still examples: mapped precomputed canvas, or the decoded pixels when it could not be written
+    struct ExampleSource {
+        CanvasFile file;
+        ofPixels image;
+        Buffer<uint16_t> depth;
+        const unsigned char * colors() const { return file.isOpen() ? file.image() : image.getData(); }
+    };
+    static bool exampleSources(Example example, string & image_name, string & depth_name);
+    static bool openSource(const string & image_name, const string & depth_name, ExampleSource & source);
+    
+    // Prepared still examples, the shown one and the one waiting for the cache worker.
+    // The shown canvas comes with the source and settings the worker prepared it from.
+    CanvasCache examples;
+    CanvasCache::Settings exampleSettings();
+    static bool prepareExample(int key, const CanvasCache::Settings & settings, Canvas & prepared, std::shared_ptr<const void> & source);
+    int shown_example = -1, pending_example = -1;
+    CanvasCache::Origin shown_origin;
+    const ExampleSource * shownSource() const { return (const ExampleSource *) shown_origin.source.get(); }
+    
+    // Gallery wall 'a': every example and the video in one scene, their resolutions within the GALLERY_* budgets
+    Gallery gallery;
+    bool bGallery = false;
+    int gallery_target = Gallery::ALL;          // painting the firings and projection keys act on
+    int gallery_video = -1;                     // painting fed by the video pipeline
+    struct GalleryMesh {
+        ofVbo vbos[2];
+        size_t front = 0, changes = 0;
+        std::shared_ptr<const Topology> topology;
+    };
+    vector<GalleryMesh> gallery_meshes;
+    // Index buffers by topology, shared by the meshes of the same size
+    std::map<std::shared_ptr<const Topology>, ofBufferObject> gallery_indices;
+    void openGallery();
+    void closeGallery();
+    void updateGallery(float intensity);
+    void uploadGallery();
+    void drawGallery();
+    bool galleryKeyPressed(int key);
+    
+    // Mesh export of the shown canvas, or of every frame of the video, written by a worker thread
+    MeshExporter exporter;
+    bool bQuantize = true, bVideoExport = false;
+    void exportMesh(MeshExporter::Format format);
+    void startVideo();
+    
+#ifdef PROFILER_ON
+    FrameProfiler profiler;
+    bool bGraph = false;
+    void drawProfile();
+    void dumpProfile();
+#endif
+    
+    // Scripted replay (--replay script) on a virtual clock of fixed steps
+    string replay_path;
+    ReplayScript script;
+    bool bReplay = false;
+    size_t replay_next = 0, replay_frame = 0;
+    float replay_intensity = 1;
+    SpectrumEnvelope replay_soundtrack;
+    double replay_soundtrack_start = -1;        // ms, -1 for a fixed intensity
+    double now() const;                         // ms, virtual while replaying
+    size_t frameNumber() const;
+    void updateReplay();
+    
+#ifdef CONTROL_ON
+    // Show control: OSC commands of a local controller (see core/Control.h), applied at the start of every frame
+    ControlServer control;
+    vector<ControlCommand> control_commands;
+    float control_intensity = -1;               // of the effects when not negative, in place of the spectrum
+    void updateControl();
+#endif
+    
     bool bConsole = true, bVideo = false, bLoaded = false, bDepth = false;
     
-    vector<Synapse> synapses;
-    float global_discharge_strengh;
-    float flattening = 0;
-    float noise_starttime = -1E9, firing_starttime = -1E9, flattening_starttime = -1E9, inclusion_starttime = -1E9;
-    bool bFlat = false, bInclusion = true, bNoise = false;
-    size_t nFirings;
-
     ofColor central_color, edge_color;
-
-    ofSoundPlayer soundtrack, sounddischarge, soundgrain;
-    vector<float> power;
-    float spectrum;
+    
+    ofSoundPlayer soundtrack, sounddischarge;
+    // Grains of the effects, mixed on the audio thread of their own output stream
+    GrainEngine grains;
+    ofSoundStream grain_stream;
+    void audioOut(ofSoundBuffer & buffer);
+    // Soundtrack spectrum: its precomputed envelope, else analyzed live
+    SpectrumEnvelope envelope;
+    AudioAnalyzer analyzer;
+    float spectrum = 0;                         // band energy averaged over SPECTRUM_DECAY s
+    size_t onsets = 0;
+    double track_position = 0;                  // s
     void setupAudio();
-    void playGrain();
-
+    void updateSpectrum();
+    
 #ifdef LEAP_MOTION_ON
     size_t hand_id, finger_id;
     ofxLeapMotion leap;